@@ -50,6 +50,8 @@ rm -rf $RPM_BUILD_ROOT
 %defattr(-,root,root,-)
 %{_bindir}/procenv
 %{_mandir}/man1/procenv.1.gz
+%{_libdir}/libprocenv.a
+%{_includedir}/libprocenv.h
 %doc NEWS ChangeLog TODO
 
 %changelog
@@ -0,0 +1,410 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2012-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ */
+
+#include "procenv.h"
+#include "libprocenv.h"
+
+#include <setjmp.h>
+#include <pthread.h>
+
+#define PROCENV_LIB_ERROR_SIZE 1024
+
+extern const char *program_name;
+
+/**
+ * struct procenv_ctx:
+ *
+ * @tree: element tree recorded by the last successful call to
+ *  procenv_collect(),
+ * @doc: output document,
+ * @output: location messages are written to,
+ * @format: output format,
+ * @error: description of the last error.
+ *
+ * The output state of the context is installed in the output layer
+ * for the duration of each call (see ctx_enter()).
+ **/
+struct procenv_ctx {
+	struct procenv_node  *tree;
+	pstring              *doc;
+	Output                output;
+	OutputFormat          format;
+	char                  error[PROCENV_LIB_ERROR_SIZE];
+};
+
+/**
+ * struct lib_saved_state:
+ *
+ * Output layer state replaced by ctx_enter().
+ **/
+struct lib_saved_state {
+	pstring       *doc;
+	Output         output;
+	OutputFormat   format;
+};
+
+/**
+ * lib_lock:
+ *
+ * Serialises all calls into the collectors and output layer, which
+ * operate on process-wide state.
+ *
+ * All the following variables are protected by this lock.
+ **/
+static pthread_mutex_t lib_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * lib_initialised:
+ *
+ * true once the process-wide details that the collectors depend upon
+ * have been gathered.
+ **/
+static bool lib_initialised = false;
+
+/**
+ * lib_env:
+ *
+ * Location to return to if die() or bug() is called, or NULL if no
+ * call is in progress.
+ **/
+static jmp_buf *lib_env = NULL;
+
+/**
+ * lib_error:
+ *
+ * Message passed to the most recent call to die() or bug().
+ **/
+static char lib_error[PROCENV_LIB_ERROR_SIZE];
+
+/**
+ * procenv_lib_fail:
+ *
+ * @prefix: "ERROR" or "BUG",
+ * @fmt: printf-style format and optional arguments.
+ *
+ * Library implementation of die() and bug(): record the message,
+ * release any resources held by the collector that failed and return
+ * control to the public API function in progress.
+ **/
+void
+procenv_lib_fail (const char *prefix, const char *fmt, ...)
+{
+	va_list  ap;
+	int      len = 0;
+
+	assert (prefix);
+	assert (fmt);
+
+	if (strcmp (prefix, "ERROR")) {
+		len = snprintf (lib_error, sizeof (lib_error), "%s: ", prefix);
+		if (len < 0 || (size_t)len >= sizeof (lib_error))
+			len = 0;
+	}
+
+	va_start (ap, fmt);
+	(void)vsnprintf (lib_error + len, sizeof (lib_error) - len, fmt, ap);
+	va_end (ap);
+
+	/* Not called via the public API */
+	if (! lib_env)
+		abort ();
+
+	/* Must be done before the stack is unwound since some of the
+	 * resources are on it.
+	 */
+	release_tracked ();
+
+	longjmp (*lib_env, 1);
+}
+
+static void
+set_ctx_error (procenv_ctx *ctx, const char *msg)
+{
+	assert (ctx);
+	assert (msg);
+
+	(void)snprintf (ctx->error, sizeof (ctx->error), "%s", msg);
+}
+
+/**
+ * ctx_enter:
+ *
+ * @ctx: context,
+ * @saved: storage for the state replaced.
+ *
+ * Install the output state of @ctx. Must be called with lib_lock held.
+ **/
+static void
+ctx_enter (procenv_ctx *ctx, struct lib_saved_state *saved)
+{
+	assert (ctx);
+	assert (saved);
+
+	saved->doc = doc;
+	saved->output = output;
+	saved->format = output_format;
+
+	doc = ctx->doc;
+	output = ctx->output;
+	output_format = ctx->format;
+}
+
+/**
+ * ctx_leave:
+ *
+ * @ctx: context,
+ * @saved: state saved by ctx_enter().
+ *
+ * Restore the output state replaced by ctx_enter(), freeing any
+ * document left partially rendered if an error occurred.
+ **/
+static void
+ctx_leave (procenv_ctx *ctx, const struct lib_saved_state *saved)
+{
+	assert (ctx);
+	assert (saved);
+
+	if (doc && doc != ctx->doc)
+		pstring_free (doc);
+
+	doc = saved->doc;
+	output = saved->output;
+	output_format = saved->format;
+}
+
+/**
+ * lib_init:
+ *
+ * Perform one-time initialisation. Must be called with lib_lock held
+ * and lib_env set.
+ **/
+static void
+lib_init (void)
+{
+	if (lib_initialised)
+		return;
+
+	/* The arguments of the calling process are not available, but
+	 * its name is required to display stat details.
+	 */
+#if defined (PROCENV_PLATFORM_BSD) || defined (PROCENV_PLATFORM_DARWIN)
+	program_name = getprogname ();
+#else
+	program_name = program_invocation_name;
+#endif
+
+	init ();
+
+	lib_initialised = true;
+}
+
+/**
+ * procenv_ctx_new:
+ *
+ * Returns: Newly-allocated context, or NULL on allocation failure.
+ **/
+procenv_ctx *
+procenv_ctx_new (void)
+{
+	procenv_ctx *ctx;
+
+	ctx = calloc (1, sizeof (procenv_ctx));
+	if (! ctx)
+		return NULL;
+
+	ctx->doc = pstring_new ();
+	if (! ctx->doc) {
+		free (ctx);
+		return NULL;
+	}
+
+	/* Warnings from the collectors go to stderr rather than
+	 * polluting the standard output of the calling process.
+	 */
+	ctx->output = OUTPUT_STDERR;
+	ctx->format = OUTPUT_FORMAT_TEXT;
+
+	return ctx;
+}
+
+/**
+ * procenv_ctx_free:
+ *
+ * @ctx: context to free.
+ **/
+void
+procenv_ctx_free (procenv_ctx *ctx)
+{
+	if (! ctx)
+		return;
+
+	free_tree (ctx->tree);
+	pstring_free (ctx->doc);
+	free (ctx);
+}
+
+/**
+ * procenv_ctx_error:
+ *
+ * @ctx: context.
+ *
+ * Returns: Description of the last error encountered using @ctx.
+ **/
+const char *
+procenv_ctx_error (const procenv_ctx *ctx)
+{
+	if (! ctx)
+		return "invalid context";
+
+	return ctx->error;
+}
+
+/**
+ * procenv_collect:
+ *
+ * @ctx: context,
+ * @sections: NULL-terminated array of section names, or NULL to
+ *  collect all sections.
+ *
+ * Gather details for the specified sections, replacing any details
+ * previously collected using @ctx.
+ *
+ * Returns: 0 on success, or -1 on error.
+ **/
+int
+procenv_collect (procenv_ctx *ctx, const char * const *sections)
+{
+	jmp_buf                 env;
+	struct lib_saved_state  saved;
+	const char * const     *name;
+	struct procenv_node    *tree;
+	int                     ret = -1;
+
+	if (! ctx) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ctx->error[0] = '\0';
+
+	pthread_mutex_lock (&lib_lock);
+
+	ctx_enter (ctx, &saved);
+
+	lib_env = &env;
+
+	if (setjmp (env)) {
+		record_abort ();
+		set_ctx_error (ctx, lib_error);
+		ret = -1;
+		goto out;
+	}
+
+	lib_init ();
+
+	record_start ();
+
+	if (sections) {
+		for (name = sections; *name; name++) {
+			if (! show_section (*name))
+				die ("unknown section: '%s'", *name);
+		}
+	} else {
+		dump ();
+	}
+
+	tree = record_stop ();
+
+	free_tree (ctx->tree);
+	ctx->tree = tree;
+
+	ret = 0;
+
+out:
+	lib_env = NULL;
+
+	ctx_leave (ctx, &saved);
+
+	pthread_mutex_unlock (&lib_lock);
+
+	return ret;
+}
+
+/**
+ * procenv_render:
+ *
+ * @ctx: context,
+ * @format: name of output format,
+ * @buf: newly-allocated rendered output, which the caller must free.
+ *
+ * Render the details collected using @ctx in @format.
+ *
+ * Returns: 0 on success, or -1 on error.
+ **/
+int
+procenv_render (procenv_ctx *ctx, const char *format, char **buf)
+{
+	jmp_buf                 env;
+	struct lib_saved_state  saved;
+	OutputFormat            new_format;
+	pstring                *rendered = NULL;
+	int                     ret = -1;
+
+	if (! ctx || ! format || ! buf) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ctx->error[0] = '\0';
+	*buf = NULL;
+
+	if (! ctx->tree) {
+		set_ctx_error (ctx, "no details collected");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (! get_output_format_by_name (format, &new_format)) {
+		set_ctx_error (ctx, "invalid output format");
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock (&lib_lock);
+
+	ctx->format = new_format;
+
+	ctx_enter (ctx, &saved);
+
+	lib_env = &env;
+
+	if (setjmp (env)) {
+		set_ctx_error (ctx, lib_error);
+		ret = -1;
+		goto out;
+	}
+
+	render_tree (ctx->tree, &rendered);
+
+	*buf = pstring_to_char (rendered);
+
+	pstring_free (rendered);
+
+	if (! *buf)
+		die ("failed to convert output");
+
+	ret = 0;
+
+out:
+	lib_env = NULL;
+
+	ctx_leave (ctx, &saved);
+
+	pthread_mutex_unlock (&lib_lock);
+
+	return ret;
+}
@@ -0,0 +1,63 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2012-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ */
+
+#ifndef _LIBPROCENV_H
+#define _LIBPROCENV_H
+
+/**
+ * In-process interface to procenv.
+ *
+ * Usage:
+ *
+ *     procenv_ctx *ctx = procenv_ctx_new ();
+ *     const char *sections[] = { "meta", "limits", NULL };
+ *     char *buf;
+ *
+ *     if (procenv_collect (ctx, sections) < 0
+ *         || procenv_render (ctx, "json", &buf) < 0) {
+ *         fprintf (stderr, "%s\n", procenv_ctx_error (ctx));
+ *     } else {
+ *         puts (buf);
+ *         free (buf);
+ *     }
+ *
+ *     procenv_ctx_free (ctx);
+ *
+ * Errors are reported via return values: the library never terminates
+ * the calling process, and any resources held by a collector when an
+ * error occurs are released. Each context has its own output state, so
+ * contexts are independent and may be used from different threads
+ * concurrently, although calls are serialised internally since the
+ * collectors inspect process-wide state.
+ *
+ * Section names are those shown in the output of procenv (for
+ * example "cpu", "file descriptors", "limits"). Output formats are
+ * those accepted by '--format' ("crumb", "json", "text", "xml").
+ *
+ * Values containing multi-byte characters are only rendered correctly
+ * if the calling process has set an appropriate locale.
+ **/
+
+/* The library is built with hidden visibility: only the functions
+ * below are exported.
+ */
+#if defined (__GNUC__)
+#define PROCENV_PUBLIC __attribute__ ((visibility ("default")))
+#else
+#define PROCENV_PUBLIC
+#endif
+
+typedef struct procenv_ctx procenv_ctx;
+
+PROCENV_PUBLIC procenv_ctx *procenv_ctx_new (void);
+PROCENV_PUBLIC void procenv_ctx_free (procenv_ctx *ctx);
+PROCENV_PUBLIC const char *procenv_ctx_error (const procenv_ctx *ctx);
+
+PROCENV_PUBLIC int procenv_collect (procenv_ctx *ctx, const char * const *sections);
+PROCENV_PUBLIC int procenv_render (procenv_ctx *ctx, const char *format, char **buf);
+
+#endif /* _LIBPROCENV_H */
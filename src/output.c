@@ -6,8 +6,11 @@
  */
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <syslog.h>
 #include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
 
 #include "pr_list.h"
 #include "string-util.h"
@@ -94,6 +97,7 @@ static struct procenv_map output_format_map[] = {
 	{ "crumb" , OUTPUT_FORMAT_CRUMB },
 	{ "json"  , OUTPUT_FORMAT_JSON  },
 	{ "xml"   , OUTPUT_FORMAT_XML   },
+	{ "openmetrics" , OUTPUT_FORMAT_OPENMETRICS },
 
 	{ NULL                , 0       }
 };
@@ -144,52 +148,1972 @@ static TranslateTable translate_table[] = {
 	},
 };
 
+/**
+ * ELEMENT_TYPE_COUNT, OUTPUT_FORMAT_COUNT:
+ *
+ * Number of element types (excluding ELEMENT_TYPE_NONE) and output
+ * formats.
+ **/
+#define ELEMENT_TYPE_COUNT  (ELEMENT_TYPE_OBJECT_CLOSE + 1)
+#define OUTPUT_FORMAT_COUNT (OUTPUT_FORMAT_OPENMETRICS + 1)
+
+/**
+ * TRANSITION_FROM:
+ *
+ * @type: previous element type.
+ *
+ * Index into transitions for @type (which may be ELEMENT_TYPE_NONE).
+ **/
+#define TRANSITION_FROM(type) ((type) + 1)
+
+/**
+ * struct procenv_transition:
+ *
+ * @valid: true if the transition is permitted,
+ * @separator: string to append to the output document (or NULL),
+ * @indent: change to the indent level (-1, 0 or 1), applied after
+ *  @separator has been appended,
+ * @add_indent: if true, append the (updated) indent.
+ *
+ * Layout to produce when changing from one element type to another.
+ **/
+struct procenv_transition {
+	bool            valid;
+	const wchar_t  *separator;
+	int             indent;
+	bool            add_indent;
+};
+
+#define TRANSITION_NOP                  { true, NULL,   0, false }
+#define TRANSITION_INDENT               { true, NULL,   0, true  }
+#define TRANSITION_NEWLINE              { true, L"\n",  0, true  }
+#define TRANSITION_NEWLINE_INC          { true, L"\n",  1, true  }
+#define TRANSITION_NEWLINE_DEC          { true, L"\n", -1, true  }
+#define TRANSITION_NEWLINE_DEC_NOINDENT { true, L"\n", -1, false }
+#define TRANSITION_COMMA_NEWLINE        { true, L",\n", 0, true  }
+
+#define TRANSITION_ROW_NOP \
+	{ \
+		TRANSITION_NOP, TRANSITION_NOP, TRANSITION_NOP, TRANSITION_NOP, \
+		TRANSITION_NOP, TRANSITION_NOP, TRANSITION_NOP \
+	}
+
+#define TRANSITION_ROW_INDENT \
+	{ \
+		TRANSITION_INDENT, TRANSITION_INDENT, TRANSITION_INDENT, \
+		TRANSITION_INDENT, TRANSITION_INDENT, TRANSITION_INDENT, \
+		TRANSITION_INDENT \
+	}
+
+/**
+ * transitions:
+ *
+ * Layout to produce for each output format when changing from the
+ * previous element type (first index) to the current element type
+ * (second index). Transitions not listed are invalid.
+ *
+ * Objects are only visible to the state machine for
+ * OUTPUT_FORMAT_JSON (see object_open()). OUTPUT_FORMAT_OPENMETRICS
+ * is rendered directly from the element tree.
+ **/
+static const struct procenv_transition
+transitions[OUTPUT_FORMAT_COUNT][ELEMENT_TYPE_COUNT + 1][ELEMENT_TYPE_COUNT] = {
+	[OUTPUT_FORMAT_TEXT] = {
+		[TRANSITION_FROM (ELEMENT_TYPE_NONE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_INDENT,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_INDENT,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_INDENT,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_INDENT,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_INDENT,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NOP,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NOP,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_ENTRY)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NOP,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NOP,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+		},
+	},
+
+	/* Breadcrumbs require no layout */
+	[OUTPUT_FORMAT_CRUMB] = {
+		TRANSITION_ROW_NOP, TRANSITION_ROW_NOP, TRANSITION_ROW_NOP,
+		TRANSITION_ROW_NOP, TRANSITION_ROW_NOP, TRANSITION_ROW_NOP,
+		TRANSITION_ROW_NOP, TRANSITION_ROW_NOP
+	},
+
+	[OUTPUT_FORMAT_JSON] = {
+		[TRANSITION_FROM (ELEMENT_TYPE_NONE)] = TRANSITION_ROW_INDENT,
+		[TRANSITION_FROM (ELEMENT_TYPE_ENTRY)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NOP,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NOP,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NOP,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NOP,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NEWLINE_INC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_OBJECT_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NOP,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_OBJECT_CLOSE)] = {
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_COMMA_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_COMMA_NEWLINE,
+		},
+	},
+
+	[OUTPUT_FORMAT_XML] = {
+		[TRANSITION_FROM (ELEMENT_TYPE_NONE)] = TRANSITION_ROW_INDENT,
+		[TRANSITION_FROM (ELEMENT_TYPE_ENTRY)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_SECTION_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_INDENT,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_CONTAINER_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NEWLINE_DEC,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_OBJECT_OPEN)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_SECTION_OPEN]    = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_CONTAINER_OPEN]  = TRANSITION_NEWLINE_INC,
+			[ELEMENT_TYPE_OBJECT_CLOSE]    = TRANSITION_NOP,
+		},
+		[TRANSITION_FROM (ELEMENT_TYPE_OBJECT_CLOSE)] = {
+			[ELEMENT_TYPE_ENTRY]           = TRANSITION_NEWLINE_DEC_NOINDENT,
+			[ELEMENT_TYPE_SECTION_CLOSE]   = TRANSITION_NOP,
+			[ELEMENT_TYPE_CONTAINER_CLOSE] = TRANSITION_NEWLINE_DEC_NOINDENT,
+			[ELEMENT_TYPE_OBJECT_OPEN]     = TRANSITION_NOP,
+		},
+	},
+};
+
 /**
  * last_element: Type of previous element handled.
  **/
-ElementType last_element = ELEMENT_TYPE_NONE;
+ElementType last_element = ELEMENT_TYPE_NONE;
+
+/**
+ * current_element: Type of element currently being handled.
+ **/
+ElementType current_element = ELEMENT_TYPE_NONE;
+
+/**
+ * crumb_list:
+ *
+ * List used to store breadcrumbs when OUTPUT_FORMAT_CRUMB being used.
+ **/
+static PRList *crumb_list = NULL;
+
+/**
+ * indent:
+ *
+ * Current output indent value.
+ **/
+static int indent = 0;
+
+/**
+ * indent_amount:
+ *
+ * Number of INDENT_CHARs to emit for an indent.
+ **/
+static int indent_amount = DEFAULT_INDENT_AMOUNT;
+
+/**
+ * indent_char, wide_indent_char:
+ *
+ * Character to use for indenting and wide-char equivalent.
+ **/
+const char *indent_char = DEFAULT_INDENT_CHAR;
+wchar_t  wide_indent_char;
+
+/**
+ * indent_buffer, indent_buffer_len, indent_buffer_char:
+ *
+ * String of @indent_buffer_len @indent_buffer_char characters (not
+ * nul-terminated) from which indents are copied.
+ **/
+static wchar_t *indent_buffer = NULL;
+static size_t indent_buffer_len = 0;
+static wchar_t indent_buffer_char = L'\0';
+
+/**
+ * crumb_separator:
+ *
+ * Separator used for text output format to separate a name from a
+ * value.
+ **/
+const char *crumb_separator = PROCENV_DEFAULT_CRUMB_SEPARATOR;
+
+/**
+ * struct procenv_node:
+ *
+ * An element recorded in the element tree.
+ *
+ * @type: type of element (an *_OPEN type for sections, containers
+ *  and objects),
+ * @name: name of element (not set for objects),
+ * @value: value of an entry,
+ * @value_func: if set, function to call to obtain the value of an
+ *  entry when rendering,
+ * @retain, @close_retain: @retain value specified when object was
+ *  opened and closed,
+ * @hash: content hash of node and all its children (only set
+ *  for canonical output),
+ * @index: position of node amongst its siblings when added,
+ * @key: for an object, its first child when added (only set for
+ *  canonical output),
+ * @parent: parent node,
+ * @children, @last_child: first and last child nodes,
+ * @next: next sibling node.
+ **/
+struct procenv_node {
+	ElementType           type;
+	char                 *name;
+	char                 *value;
+	const char         *(*value_func) (void);
+	int                   retain;
+	int                   close_retain;
+	uint64_t              hash;
+	size_t                index;
+
+	const struct procenv_node  *key;
+
+	struct procenv_node  *parent;
+	struct procenv_node  *children;
+	struct procenv_node  *last_child;
+	struct procenv_node  *next;
+};
+
+/**
+ * struct procenv_emit:
+ *
+ * An output format and location to render the element tree to.
+ **/
+struct procenv_emit {
+	OutputFormat  format;
+	Output        output;
+	char         *file;
+};
+
+/**
+ * recording:
+ *
+ * If true, elements are added to the element tree rather than being
+ * formatted immediately (such that they may be rendered multiple
+ * times).
+ **/
+static bool recording = false;
+
+/**
+ * tree_root, tree_current:
+ *
+ * Root of element tree and node new elements will be added to.
+ **/
+static struct procenv_node *tree_root = NULL;
+static struct procenv_node *tree_current = NULL;
+
+/**
+ * canonical:
+ *
+ * If true, all elements are sorted and each section is given a
+ * content hash before the element tree is rendered.
+ **/
+static bool canonical = false;
+
+/**
+ * emits, emit_count:
+ *
+ * Output formats and locations specified via --emit.
+ **/
+static struct procenv_emit *emits = NULL;
+static size_t emit_count = 0;
+
+/**
+ * emit_tree:
+ *
+ * Element tree rendered to each --emit target.
+ **/
+static struct procenv_node *emit_tree = NULL;
+
+/**
+ * queries, query_count:
+ *
+ * Paths specified via --query and number of such paths.
+ **/
+static char **queries = NULL;
+static size_t query_count = 0;
+
+/**
+ * query_path, query_path_lens, query_depth:
+ *
+ * When a query is active, path (using crumb_separator) of the
+ * current section, the lengths of @query_path at each depth and
+ * the number of currently open sections.
+ **/
+static char *query_path = NULL;
+static size_t *query_path_lens = NULL;
+static size_t query_depth = 0;
+
+/**
+ * query_skip_depth:
+ *
+ * If non-zero, the depth of the outermost open section that cannot
+ * contain any queried paths: all elements within it are discarded
+ * without being formatted.
+ **/
+static size_t query_skip_depth = 0;
+
+/**
+ * query_results, query_result_count:
+ *
+ * Encoded path/value pairs for each entry matching a query.
+ **/
+static pstring **query_results = NULL;
+static size_t query_result_count = 0;
+
+/**
+ * query_path_matches:
+ *
+ * @path: crumb path of a section or entry,
+ * @len: length of @path,
+ * @section: true if @path refers to a section.
+ *
+ * Returns: true if @path is selected by a query (the query specifies
+ * @path or one of its parent sections) or, if @section is true,
+ * @path may contain an element selected by a query.
+ **/
+static bool
+query_path_matches (const char *path, size_t len, bool section)
+{
+	size_t  i;
+	size_t  qlen;
+	size_t  sep_len;
+
+	assert (path);
+
+	sep_len = strlen (crumb_separator);
+
+	for (i = 0; i < query_count; i++) {
+		const char *query = queries[i];
+
+		qlen = strlen (query);
+
+		if (qlen == len && ! strncmp (query, path, len))
+			return true;
+
+		/* path is within the queried section */
+		if (len > qlen && ! strncmp (path, query, qlen)
+				&& ! strncmp (path + qlen, crumb_separator, sep_len))
+			return true;
+
+		/* path is a parent of the queried element */
+		if (section && qlen > len && ! strncmp (query, path, len)
+				&& ! strncmp (query + len, crumb_separator, sep_len))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+query_push (const char *name)
+{
+	size_t len;
+
+	assert (name);
+
+	query_depth++;
+
+	if (query_skip_depth)
+		return;
+
+	len = query_path ? strlen (query_path) : 0;
+
+	query_path_lens = realloc (query_path_lens,
+			query_depth * sizeof (size_t));
+	if (! query_path_lens)
+		die ("failed to allocate query path");
+
+	query_path_lens[query_depth-1] = len;
+
+	appendf (&query_path, "%s%s", len ? crumb_separator : "", name);
+
+	if (! query_path_matches (query_path, strlen (query_path), true))
+		query_skip_depth = query_depth;
+}
+
+static void
+query_pop (void)
+{
+	assert (query_depth);
+
+	if (query_skip_depth && query_depth > query_skip_depth) {
+		query_depth--;
+		return;
+	}
+
+	query_skip_depth = 0;
+
+	query_path[query_path_lens[query_depth-1]] = '\0';
+
+	query_depth--;
+}
+
+static bool
+query_entry_matches (const char *name)
+{
+	size_t  len;
+	bool    ret;
+
+	assert (name);
+
+	len = query_path ? strlen (query_path) : 0;
+
+	appendf (&query_path, "%s%s", len ? crumb_separator : "", name);
+
+	ret = query_path_matches (query_path, strlen (query_path), false);
+
+	query_path[len] = '\0';
+
+	return ret;
+}
+
+static void
+query_add_result (const char *name, const char *fmt, va_list ap)
+{
+	char     *path = NULL;
+	char     *value = NULL;
+	pstring  *encoded_path;
+	pstring  *encoded_value;
+
+	assert (name);
+	assert (fmt);
+
+	appendf (&path, "%s%s%s",
+			query_path ? query_path : "",
+			query_path && *query_path ? crumb_separator : "",
+			name);
+
+	encoded_path = char_to_pstring_lossy (path);
+	if (! encoded_path)
+		die ("failed to encode name");
+
+	free (path);
+
+	if (encode_string (&encoded_path) < 0)
+		die ("failed to encode name");
+
+	appendva (&value, fmt, ap);
+
+	encoded_value = char_to_pstring_lossy (value);
+	if (! encoded_value)
+		die ("failed to encode value");
+
+	free (value);
+
+	if (encode_string (&encoded_value) < 0)
+		die ("failed to encode value");
+
+	query_results = realloc (query_results,
+			(query_result_count + 1) * 2 * sizeof (pstring *));
+	if (! query_results)
+		die ("failed to allocate query results");
+
+	query_results[query_result_count * 2] = encoded_path;
+	query_results[(query_result_count * 2) + 1] = encoded_value;
+
+	query_result_count++;
+}
+
+/**
+ * add_query:
+ *
+ * @spec: comma-separated list of paths.
+ *
+ * Register paths to query. Each path comprises section and entry
+ * names separated by the crumb separator.
+ **/
+void
+add_query (const char *spec)
+{
+	char  *copy;
+	char  *path;
+	char  *saveptr = NULL;
+
+	assert (spec);
+
+	copy = strdup (spec);
+	if (! copy)
+		die ("failed to allocate query");
+
+	for (path = strtok_r (copy, ",", &saveptr);
+			path;
+			path = strtok_r (NULL, ",", &saveptr)) {
+		queries = realloc (queries, (query_count + 1) * sizeof (char *));
+		if (! queries)
+			die ("failed to allocate query");
+
+		queries[query_count] = strdup (path);
+		if (! queries[query_count])
+			die ("failed to allocate query");
+
+		query_count++;
+	}
+
+	free (copy);
+
+	if (! query_count)
+		die ("no paths specified for query");
+}
+
+size_t
+get_query_count (void)
+{
+	return query_count;
+}
+
+const char *
+get_query (size_t i)
+{
+	assert (i < query_count);
+
+	return queries[i];
+}
+
+/**
+ * query_section_wanted:
+ *
+ * @name: name of a top-level section.
+ *
+ * Returns: true if any query may select an element in @name.
+ **/
+bool
+query_section_wanted (const char *name)
+{
+	assert (name);
+
+	return query_path_matches (name, strlen (name), true);
+}
+
+/**
+ * show_query_results:
+ *
+ * @doc: document to write to.
+ *
+ * Write all entries that matched a query to @doc as a flat list of
+ * path/value pairs. It is an error for no entries to match.
+ **/
+void
+show_query_results (pstring **doc)
+{
+	size_t  i;
+	pstring *path;
+	pstring *value;
+
+	assert (doc);
+
+	/* The query named valid sections, but nothing within them */
+	if (! query_result_count)
+		die ("no entries match query");
+
+	switch (output_format) {
+
+	case OUTPUT_FORMAT_CRUMB: /* FALL */
+	case OUTPUT_FORMAT_TEXT:
+		for (i = 0; i < query_result_count; i++) {
+			path = query_results[i * 2];
+			value = query_results[(i * 2) + 1];
+
+			wappendf (doc, L"%ls=%ls\n", path->buf, value->buf);
+		}
+		break;
+
+	case OUTPUT_FORMAT_JSON:
+		wappend (doc, L"{");
+
+		for (i = 0; i < query_result_count; i++) {
+			path = query_results[i * 2];
+			value = query_results[(i * 2) + 1];
+
+			wappendf (doc, L"%s\n%s\"%ls\" : \"%ls\"",
+					i ? "," : "",
+					indent_char,
+					path->buf, value->buf);
+		}
+
+		wappend (doc, L"\n}\n");
+		break;
+
+	case OUTPUT_FORMAT_XML:
+		master_header (doc);
+
+		for (i = 0; i < query_result_count; i++) {
+			path = query_results[i * 2];
+			value = query_results[(i * 2) + 1];
+
+			wappendf (doc, L"%s<entry name=\"%ls\">%ls</entry>\n",
+					indent_char,
+					path->buf, value->buf);
+		}
+
+		dec_indent ();
+		wappendf (doc, L"</%s>\n", PACKAGE_NAME);
+		break;
+
+	default:
+		assert_not_reached ();
+		break;
+	}
+}
+
+static void
+free_queries (void)
+{
+	size_t i;
+
+	for (i = 0; i < query_count; i++)
+		free (queries[i]);
+
+	for (i = 0; i < query_result_count * 2; i++)
+		pstring_free (query_results[i]);
+
+	free (queries);
+	free (query_results);
+	free (query_path);
+	free (query_path_lens);
+
+	queries = NULL;
+	query_results = NULL;
+	query_path = NULL;
+	query_path_lens = NULL;
+	query_count = query_result_count = 0;
+}
+
+static struct procenv_node *
+tree_add_child (struct procenv_node *parent, ElementType type, const char *name)
+{
+	struct procenv_node *node;
+
+	assert (parent);
+
+	node = calloc (1, sizeof (struct procenv_node));
+	if (! node)
+		die ("failed to allocate element");
+
+	node->type = type;
+
+	if (name) {
+		node->name = strdup (name);
+		if (! node->name)
+			die ("failed to allocate element name");
+	}
+
+	node->parent = parent;
+
+	if (parent->last_child) {
+		node->index = parent->last_child->index + 1;
+		parent->last_child->next = node;
+	} else {
+		parent->children = node;
+	}
+
+	parent->last_child = node;
+
+	return node;
+}
+
+static struct procenv_node *
+tree_add (ElementType type, const char *name)
+{
+	assert (tree_current);
+
+	return tree_add_child (tree_current, type, name);
+}
+
+static void
+tree_open (ElementType type, const char *name, int retain)
+{
+	struct procenv_node *node;
+
+	node = tree_add (type, name);
+	node->retain = retain;
+
+	tree_current = node;
+}
+
+static void
+tree_close (ElementType type, int retain)
+{
+	assert (tree_current);
+
+	if (tree_current->type != type || ! tree_current->parent)
+		bug ("unbalanced element closure");
+
+	tree_current->close_retain = retain;
+
+	tree_current = tree_current->parent;
+}
+
+/**
+ * free_tree:
+ *
+ * @node: element tree (or subtree) to free.
+ **/
+void
+free_tree (struct procenv_node *node)
+{
+	struct procenv_node *child;
+	struct procenv_node *next;
+
+	if (! node)
+		return;
+
+	for (child = node->children; child; child = next) {
+		next = child->next;
+		free_tree (child);
+	}
+
+	free (node->name);
+	free (node->value);
+	free (node);
+}
+
+/**
+ * hash_bytes:
+ *
+ * @hash: hash to update,
+ * @data: data to add to @hash,
+ * @len: size of @data.
+ *
+ * Update a 64-bit FNV-1a hash.
+ *
+ * Returns: updated hash.
+ **/
+static uint64_t
+hash_bytes (uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char  *p = data;
+	size_t                i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= PROCENV_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+static uint64_t
+hash_string (uint64_t hash, const char *str)
+{
+	/* Include the terminator to separate adjacent strings */
+	return hash_bytes (hash, str ? str : "", str ? strlen (str) + 1 : 1);
+}
+
+/**
+ * unhashed_entries:
+ *
+ * Entries whose values differ between otherwise identical invocations
+ * (due to address space layout randomisation or memory usage) and
+ * which are therefore suppressed in canonical output, rather than
+ * being included in the content hash of the specified top-level
+ * section.
+ **/
+static const struct {
+	const char  *section;
+	const char  *entry;
+} unhashed_entries[] = {
+	{ "auxv"      , "AT_BASE" },
+	{ "auxv"      , "AT_ENTRY" },
+	{ "auxv"      , "AT_PHDR" },
+	{ "auxv"      , "AT_RANDOM" },
+	{ "auxv"      , "AT_SYSINFO_EHDR" },
+	{ "libraries" , "address" },
+	{ "libraries" , "resident pages" },
+	{ "misc"      , "clear child tid address" },
+
+	{ NULL, NULL }
+};
+
+static bool
+is_unhashed_entry (const char *section, const char *name)
+{
+	size_t i;
+
+	if (! section || ! name)
+		return false;
+
+	for (i = 0; unhashed_entries[i].section; i++) {
+		if (! strcmp (unhashed_entries[i].section, section)
+				&& ! strcmp (unhashed_entries[i].entry, name))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * natural_compar:
+ *
+ * @a: first string,
+ * @b: second string.
+ *
+ * Compare @a and @b, treating runs of digits as numbers such that
+ * for example "argv[2]" sorts before "argv[10]".
+ *
+ * Returns: strcmp(3)-style value.
+ **/
+static int
+natural_compar (const char *a, const char *b)
+{
+	const char  *start_a;
+	const char  *start_b;
+	size_t       len_a;
+	size_t       len_b;
+	int          ret;
+
+	a = a ? a : "";
+	b = b ? b : "";
+
+	while (*a && *b) {
+		if (! isdigit ((unsigned char)*a) || ! isdigit ((unsigned char)*b)) {
+			if (*a != *b)
+				return (unsigned char)*a < (unsigned char)*b ? -1 : 1;
+
+			a++;
+			b++;
+			continue;
+		}
+
+		/* Ignore leading zeros */
+		while (*a == '0' && isdigit ((unsigned char)a[1]))
+			a++;
+		while (*b == '0' && isdigit ((unsigned char)b[1]))
+			b++;
+
+		for (start_a = a; isdigit ((unsigned char)*a); a++)
+			;
+		for (start_b = b; isdigit ((unsigned char)*b); b++)
+			;
+
+		len_a = (size_t)(a - start_a);
+		len_b = (size_t)(b - start_b);
+
+		/* A longer number is larger */
+		if (len_a != len_b)
+			return len_a < len_b ? -1 : 1;
+
+		ret = strncmp (start_a, start_b, len_a);
+		if (ret)
+			return ret;
+	}
+
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+/**
+ * node_compar:
+ *
+ * Order nodes by name, or for objects (which have no name) by the
+ * name and value of their first element (which identifies them, for
+ * example a library path, mount point or argument index). Nodes that
+ * are otherwise equal retain the order they were added in, so the
+ * result never depends on volatile values.
+ **/
+static int
+node_compar (const void *a, const void *b)
+{
+	const struct procenv_node  *node_a = *(const struct procenv_node **)a;
+	const struct procenv_node  *node_b = *(const struct procenv_node **)b;
+	const struct procenv_node  *key_a;
+	const struct procenv_node  *key_b;
+	int                         ret;
+
+	ret = natural_compar (node_a->name, node_b->name);
+	if (ret)
+		return ret;
+
+	if (node_a->type != node_b->type)
+		return node_a->type < node_b->type ? -1 : 1;
+
+	key_a = node_a->key;
+	key_b = node_b->key;
+
+	if (key_a && key_b) {
+		ret = natural_compar (key_a->name, key_b->name);
+		if (ret)
+			return ret;
+
+		ret = natural_compar (key_a->value, key_b->value);
+		if (ret)
+			return ret;
+	}
+
+	return (node_a->index > node_b->index) - (node_a->index < node_b->index);
+}
+
+/**
+ * sort_children:
+ *
+ * @node: node whose children should be sorted.
+ *
+ * Sort the children of @node (see node_compar()).
+ **/
+static void
+sort_children (struct procenv_node *node)
+{
+	struct procenv_node   *child;
+	struct procenv_node  **children;
+	size_t                 count = 0;
+	size_t                 i;
+
+	assert (node);
+
+	for (child = node->children; child; child = child->next)
+		count++;
+
+	if (count < 2)
+		return;
+
+	children = calloc (count, sizeof (struct procenv_node *));
+	if (! children)
+		die ("failed to allocate elements");
+
+	for (child = node->children, i = 0; child; child = child->next)
+		children[i++] = child;
+
+	qsort (children, count, sizeof (struct procenv_node *), node_compar);
+
+	for (i = 0; i < count - 1; i++)
+		children[i]->next = children[i+1];
+
+	children[count-1]->next = NULL;
+
+	node->children = children[0];
+	node->last_child = children[count-1];
+
+	free (children);
+}
+
+/**
+ * canonicalise_node:
+ *
+ * @node: element tree (or subtree),
+ * @section: name of top-level section @node belongs to.
+ *
+ * Recursively sort the children of @node and calculate the content
+ * hash of @node.
+ *
+ * The value of an entry whose value is only known at render time is
+ * not included in the hash since it depends on the output format. The
+ * values of unhashed_entries are replaced with SUPPRESSED_STR so that
+ * the output, and not just the hash, is stable.
+ **/
+static void
+canonicalise_node (struct procenv_node *node, const char *section)
+{
+	struct procenv_node  *child;
+	uint64_t              hash = PROCENV_HASH_OFFSET;
+	unsigned char         type;
+
+	assert (node);
+
+	for (child = node->children; child; child = child->next)
+		canonicalise_node (child, section);
+
+	if (! node->value_func && is_unhashed_entry (section, node->name)) {
+		free (node->value);
+
+		node->value = strdup (SUPPRESSED_STR);
+		if (! node->value)
+			die ("failed to allocate value");
+	}
+
+	/* Objects are identified by their first element, so record
+	 * it before the elements are reordered.
+	 */
+	if (node->type == ELEMENT_TYPE_OBJECT_OPEN)
+		node->key = node->children;
+
+	sort_children (node);
+
+	type = (unsigned char)node->type;
+
+	hash = hash_bytes (hash, &type, sizeof (type));
+	hash = hash_string (hash, node->name);
+
+	if (! node->value_func)
+		hash = hash_string (hash, node->value);
+
+	for (child = node->children; child; child = child->next)
+		hash = hash_bytes (hash, &child->hash, sizeof (child->hash));
+
+	node->hash = hash;
+}
+
+/**
+ * canonicalise_tree:
+ *
+ * @tree: element tree.
+ *
+ * Sort all elements in @tree and add the content hash of each
+ * section to the meta section (which is not itself hashed since it
+ * contains details of the invocation).
+ **/
+static void
+canonicalise_tree (struct procenv_node *tree)
+{
+	struct procenv_node  *child;
+	struct procenv_node  *meta = NULL;
+	struct procenv_node  *hashes;
+	struct procenv_node  *node;
+
+	assert (tree);
+
+	for (child = tree->children; child; child = child->next) {
+		if (child->type != ELEMENT_TYPE_SECTION_OPEN)
+			continue;
+
+		if (child->name && ! strcmp (child->name, "meta")) {
+			meta = child;
+			continue;
+		}
+
+		canonicalise_node (child, child->name);
+	}
+
+	if (! meta)
+		meta = tree_add_child (tree, ELEMENT_TYPE_SECTION_OPEN, "meta");
+
+	hashes = tree_add_child (meta, ELEMENT_TYPE_SECTION_OPEN, "hashes");
+
+	for (child = tree->children; child; child = child->next) {
+		if (child == meta || child->type != ELEMENT_TYPE_SECTION_OPEN)
+			continue;
+
+		node = tree_add_child (hashes, ELEMENT_TYPE_ENTRY, child->name);
+
+		appendf (&node->value, "%016" PRIx64, child->hash);
+	}
+
+	canonicalise_node (meta, meta->name);
+
+	sort_children (tree);
+}
+
+/**
+ * set_canonical:
+ *
+ * Sort all output elements and display a content hash for each
+ * section. Since elements can only be sorted once all are known,
+ * they are recorded rather than being formatted immediately.
+ **/
+void
+set_canonical (void)
+{
+	canonical = true;
+
+	record_start ();
+}
+
+/**
+ * record_start:
+ *
+ * Start adding elements to the element tree rather than formatting
+ * them immediately.
+ **/
+void
+record_start (void)
+{
+	if (! tree_root) {
+		tree_root = calloc (1, sizeof (struct procenv_node));
+		if (! tree_root)
+			die ("failed to allocate element tree");
+
+		tree_root->type = ELEMENT_TYPE_NONE;
+		tree_current = tree_root;
+	}
+
+	recording = true;
+}
+
+/**
+ * is_recording:
+ *
+ * Returns: true if elements are being recorded rather than formatted.
+ **/
+bool
+is_recording (void)
+{
+	return recording;
+}
+
+/**
+ * record_stop:
+ *
+ * Stop recording elements.
+ *
+ * Returns: Newly-allocated element tree containing all elements
+ * added since record_start() was called, which the caller must
+ * free with free_tree().
+ **/
+struct procenv_node *
+record_stop (void)
+{
+	struct procenv_node *tree;
+
+	assert (tree_root);
+
+	if (tree_current != tree_root)
+		bug ("unclosed element");
+
+	tree = tree_root;
+	tree_root = tree_current = NULL;
+
+	recording = false;
+
+	if (canonical)
+		canonicalise_tree (tree);
+
+	return tree;
+}
+
+/**
+ * record_abort:
+ *
+ * Stop recording elements and discard those recorded so far.
+ **/
+void
+record_abort (void)
+{
+	free_tree (tree_root);
+	tree_root = tree_current = NULL;
+
+	recording = false;
+}
+
+/**
+ * entry_func:
+ *
+ * @name: name of entry,
+ * @func: function returning the value of the entry.
+ *
+ * Add an entry whose value depends on the output format being
+ * rendered, so must be determined at render time.
+ **/
+void
+entry_func (const char *name, const char *(*func) (void))
+{
+	struct procenv_node *node;
+
+	assert (name);
+	assert (func);
+
+	if (recording && ! query_count) {
+		node = tree_add (ELEMENT_TYPE_ENTRY, name);
+		node->value_func = func;
+		return;
+	}
+
+	entry (name, "%s", func ());
+}
+
+/**
+ * add_emit:
+ *
+ * @spec: "format:output[:file]" specification.
+ *
+ * Register an additional output format and location that the element
+ * tree should be rendered to. Once called, all elements will be
+ * recorded rather than formatted immediately.
+ **/
+void
+add_emit (const char *spec)
+{
+	struct procenv_emit  *emit;
+	struct procenv_map   *p;
+	char                 *copy;
+	char                 *format;
+	char                 *location;
+	char                 *file;
+
+	assert (spec);
+
+	copy = strdup (spec);
+	if (! copy)
+		die ("failed to allocate emit");
+
+	format = copy;
+
+	location = strchr (format, ':');
+	if (! location)
+		die ("invalid emit value: '%s'", spec);
+
+	*location++ = '\0';
+
+	file = strchr (location, ':');
+	if (file)
+		*file++ = '\0';
+
+	emits = realloc (emits, (emit_count + 1) * sizeof (struct procenv_emit));
+	if (! emits)
+		die ("failed to allocate emit");
+
+	emit = &emits[emit_count];
+	memset (emit, '\0', sizeof (struct procenv_emit));
+
+	if (! get_output_format_by_name (format, &emit->format))
+		die ("invalid output format value: '%s'", format);
+
+	for (p = output_map; p->name; p++) {
+		if (! strcmp (location, p->name))
+			break;
+	}
+
+	if (! p->name)
+		die ("invalid output value: '%s'", location);
+
+	emit->output = p->num;
+
+	if (emit->output == OUTPUT_FILE) {
+		if (! file || ! *file)
+			die ("must specify file for emit: '%s'", spec);
+
+		emit->file = strdup (file);
+		if (! emit->file)
+			die ("failed to allocate emit");
+	} else if (file) {
+		die ("file only valid for file output: '%s'", spec);
+	}
+
+	emit_count++;
+
+	free (copy);
+
+	record_start ();
+}
+
+size_t
+get_emit_count (void)
+{
+	return emit_count;
+}
+
+static void
+render_node (const struct procenv_node *node)
+{
+	const struct procenv_node *child;
+
+	assert (node);
+
+	for (child = node->children; child; child = child->next) {
+		switch (child->type) {
+
+		case ELEMENT_TYPE_SECTION_OPEN:
+			section_open (child->name);
+			render_node (child);
+			section_close ();
+			break;
+
+		case ELEMENT_TYPE_CONTAINER_OPEN:
+			container_open (child->name);
+			render_node (child);
+			container_close ();
+			break;
+
+		case ELEMENT_TYPE_OBJECT_OPEN:
+			object_open (child->retain);
+			render_node (child);
+			object_close (child->close_retain);
+			break;
+
+		case ELEMENT_TYPE_ENTRY:
+			entry (child->name, "%s",
+					child->value_func
+					? child->value_func ()
+					: (child->value ? child->value : ""));
+			break;
+
+		default:
+			assert_not_reached ();
+			break;
+		}
+	}
+}
+
+/**
+ * struct procenv_metric:
+ *
+ * @name: OpenMetrics metric family name,
+ * @path: crumb path of entry below its section (or NULL if the entry
+ *  belongs directly to its section),
+ * @value: numeric value of entry,
+ * @index: order entry was encountered in.
+ **/
+struct procenv_metric {
+	char        *name;
+	char        *path;
+	const char  *value;
+	size_t       index;
+};
+
+/**
+ * is_metric_value:
+ *
+ * @value: string to consider.
+ *
+ * Returns: true if @value is a decimal number, else false.
+ **/
+static bool
+is_metric_value (const char *value)
+{
+	const char  *p = value;
+	bool         digits = false;
+
+	assert (value);
+
+	if (*p == '-' || *p == '+')
+		p++;
+
+	for (; isdigit ((unsigned char)*p); p++)
+		digits = true;
+
+	if (*p == '.') {
+		for (p++; isdigit ((unsigned char)*p); p++)
+			digits = true;
+	}
+
+	if (! digits)
+		return false;
+
+	if (*p == 'e' || *p == 'E') {
+		p++;
+
+		if (*p == '-' || *p == '+')
+			p++;
+
+		if (! isdigit ((unsigned char)*p))
+			return false;
+
+		while (isdigit ((unsigned char)*p))
+			p++;
+	}
+
+	return ! *p;
+}
+
+/**
+ * append_metric_name:
+ *
+ * @str: string to append to,
+ * @name: element name.
+ *
+ * Append @name to @str, converted to the character set allowed in
+ * OpenMetrics metric names (by lower-casing and replacing all other
+ * characters with a single underscore).
+ **/
+static void
+append_metric_name (char **str, const char *name)
+{
+	const char  *p;
+	char        *converted;
+	char        *q;
+
+	assert (str);
+	assert (name);
+
+	converted = calloc (strlen (name) + 1, sizeof (char));
+	if (! converted)
+		die ("failed to allocate metric name");
+
+	for (p = name, q = converted; *p; p++) {
+		if (isalnum ((unsigned char)*p))
+			*q++ = tolower ((unsigned char)*p);
+		else if (q > converted && q[-1] != '_')
+			*q++ = '_';
+	}
+
+	if (q > converted && q[-1] == '_')
+		q--;
+
+	*q = '\0';
+
+	appendf (str, "_%s", converted);
+
+	free (converted);
+}
+
+static void
+append_metric_label_value (char **str, const char *value)
+{
+	const char *p;
+
+	assert (str);
+	assert (value);
+
+	for (p = value; *p; p++) {
+		switch (*p) {
+		case '\\':
+			append (str, "\\\\");
+			break;
+
+		case '"':
+			append (str, "\\\"");
+			break;
+
+		case '\n':
+			append (str, "\\n");
+			break;
+
+		default:
+			appendf (str, "%c", *p);
+			break;
+		}
+	}
+}
+
+/* Entries whose value identifies an object comprising several entries
+ * (such as a network address).
+ */
+static const char *metric_object_keys[] = {
+	"name",
+	"address",
+	NULL
+};
+
+/**
+ * metric_object_key:
+ *
+ * @node: object node.
+ *
+ * Determine a key for @node that, unlike its position within its
+ * container, does not vary between runs. An object whose first element
+ * is a section or container (such as a library or thread) or that only
+ * contains a single entry (such as an auxiliary vector entry) is
+ * identified by the name of that element; otherwise, the value of the
+ * first entry in metric_object_keys is used.
+ *
+ * Returns: key, or NULL if @node has no natural key.
+ **/
+static const char *
+metric_object_key (const struct procenv_node *node)
+{
+	const struct procenv_node  *child;
+	const char                **key;
+
+	assert (node);
+
+	child = node->children;
+	if (! child || child->type == ELEMENT_TYPE_OBJECT_OPEN)
+		return NULL;
+
+	if (child->type != ELEMENT_TYPE_ENTRY || ! child->next)
+		return child->name;
+
+	for (key = metric_object_keys; *key; key++) {
+		for (child = node->children; child; child = child->next) {
+			if (child->type == ELEMENT_TYPE_ENTRY && ! strcmp (child->name, *key))
+				return child->value_func ? child->value_func () : child->value;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * collect_metrics:
+ *
+ * @node: element tree node,
+ * @section: name of top-level section @node belongs to,
+ * @path: crumb path of @node below @section,
+ * @metrics: array of metrics to add to,
+ * @count: number of entries in @metrics.
+ *
+ * Add all entries below @node with numeric values to @metrics.
+ **/
+static void
+collect_metrics (const struct procenv_node *node, const char *section,
+		const char *path, struct procenv_metric **metrics, size_t *count)
+{
+	const struct procenv_node  *child;
+	struct procenv_metric      *metric;
+	const char                 *value;
+	const char                 *key;
+	char                       *child_path;
+	size_t                      objects = 0;
+
+	assert (node);
+	assert (metrics);
+	assert (count);
+
+	for (child = node->children; child; child = child->next) {
+		child_path = NULL;
+
+		switch (child->type) {
+
+		case ELEMENT_TYPE_SECTION_OPEN:
+		case ELEMENT_TYPE_CONTAINER_OPEN:
+			if (! section) {
+				collect_metrics (child, child->name, NULL, metrics, count);
+				break;
+			}
+
+			if (path)
+				appendf (&child_path, "%s%s", path, crumb_separator);
+			append (&child_path, child->name);
+
+			collect_metrics (child, section, child_path, metrics, count);
+			break;
+
+		case ELEMENT_TYPE_OBJECT_OPEN:
+			if (path)
+				appendf (&child_path, "%s%s", path, crumb_separator);
+
+			/* Distinguish the objects of a container by their
+			 * position only if they have no natural key.
+			 */
+			key = metric_object_key (child);
+			if (key)
+				append (&child_path, key);
+			else
+				appendf (&child_path, "%lu", (unsigned long int)objects);
+
+			objects++;
+
+			collect_metrics (child, section, child_path, metrics, count);
+			break;
+
+		case ELEMENT_TYPE_ENTRY:
+			value = child->value_func ? child->value_func () : child->value;
+
+			if (! section || ! value || ! is_metric_value (value))
+				break;
+
+			*metrics = realloc (*metrics, (*count + 1) * sizeof (struct procenv_metric));
+			if (! *metrics)
+				die ("failed to allocate metrics");
+
+			metric = &(*metrics)[*count];
+			memset (metric, '\0', sizeof (struct procenv_metric));
+
+			append (&metric->name, "procenv");
+			append_metric_name (&metric->name, section);
+			append_metric_name (&metric->name, child->name);
+
+			if (path) {
+				metric->path = strdup (path);
+				if (! metric->path)
+					die ("failed to allocate metric path");
+			}
+
+			metric->value = value;
+			metric->index = (*count)++;
+			break;
+
+		default:
+			assert_not_reached ();
+			break;
+		}
+
+		free (child_path);
+	}
+}
+
+/**
+ * metric_path_compar:
+ *
+ * @m1: first metric,
+ * @m2: second metric.
+ *
+ * Compare the paths of @m1 and @m2, where a metric with no path sorts
+ * before all those with a path.
+ *
+ * Returns: strcmp(3)-style value.
+ **/
+static int
+metric_path_compar (const struct procenv_metric *m1,
+		const struct procenv_metric *m2)
+{
+	assert (m1);
+	assert (m2);
+
+	if (! m1->path || ! m2->path)
+		return (m1->path != NULL) - (m2->path != NULL);
+
+	return strcmp (m1->path, m2->path);
+}
 
 /**
- * current_element: Type of element currently being handled.
+ * metric_compar_labels:
+ *
+ * @m1: first metric,
+ * @m2: second metric.
+ *
+ * Returns: zero if @m1 and @m2 are in the same family and have the
+ * same path.
  **/
-ElementType current_element = ELEMENT_TYPE_NONE;
+static int
+metric_compar_labels (const struct procenv_metric *m1,
+		const struct procenv_metric *m2)
+{
+	int ret;
+
+	ret = strcmp (m1->name, m2->name);
+	if (ret)
+		return ret;
+
+	return metric_path_compar (m1, m2);
+}
+
+static int
+metric_compar (const void *a, const void *b)
+{
+	const struct procenv_metric  *m1 = a;
+	const struct procenv_metric  *m2 = b;
+	int                           ret;
+
+	/* Group samples with the same labels together */
+	ret = metric_compar_labels (m1, m2);
+	if (ret)
+		return ret;
+
+	/* Preserve order within each group */
+	return (m1->index > m2->index) - (m1->index < m2->index);
+}
 
 /**
- * crumb_list:
+ * render_openmetrics:
  *
- * List used to store breadcrumbs when OUTPUT_FORMAT_CRUMB being used.
+ * @trees: array of element trees,
+ * @count: number of entries in @trees,
+ * @out: string to render into.
+ *
+ * Render all numeric entries in @trees as OpenMetrics gauges, named
+ * after their section and entry names and labelled with their path
+ * within their section. Objects within the path are identified by
+ * their natural key where they have one (see metric_object_key()).
+ *
+ * Each sample in a family must be unique, but paths are not (for
+ * example, stacked mounts share a mount point and device), so only
+ * samples that would otherwise be identical are distinguished by an
+ * "index" label giving the order they were encountered in.
  **/
-static PRList *crumb_list = NULL;
+static void
+render_openmetrics (struct procenv_node * const *trees, size_t count,
+		pstring **out)
+{
+	struct procenv_metric  *metrics = NULL;
+	struct procenv_metric  *metric;
+	size_t                  metric_count = 0;
+	size_t                  group = 0;
+	size_t                  group_size = 0;
+	char                   *str = NULL;
+	size_t                  i;
+
+	assert (trees);
+	assert (out);
+
+	for (i = 0; i < count; i++)
+		collect_metrics (trees[i], NULL, NULL, &metrics, &metric_count);
+
+	if (metric_count)
+		qsort (metrics, metric_count, sizeof (struct procenv_metric), metric_compar);
+
+	/* Ensure the string is allocated even if there are no metrics */
+	append (&str, "");
+
+	for (i = 0; i < metric_count; i++) {
+		metric = &metrics[i];
+
+		if (! i || strcmp (metrics[i-1].name, metric->name))
+			appendf (&str, "# TYPE %s gauge\n", metric->name);
+
+		/* Start of a new set of samples sharing the same labels */
+		if (! i || metric_compar_labels (&metrics[i-1], metric)) {
+			group = i;
+
+			for (group_size = 1;
+					i + group_size < metric_count
+					&& ! metric_compar_labels (&metrics[i + group_size], metric);
+					group_size++)
+				; /* NOP */
+		}
+
+		append (&str, metric->name);
+
+		if (metric->path || group_size > 1) {
+			append (&str, "{");
+
+			if (metric->path) {
+				append (&str, "path=\"");
+				append_metric_label_value (&str, metric->path);
+				append (&str, "\"");
+			}
+
+			if (group_size > 1)
+				appendf (&str, "%sindex=\"%lu\"",
+						metric->path ? "," : "",
+						(unsigned long int)(i - group));
+
+			append (&str, "}");
+		}
+
+		appendf (&str, " %s\n", metric->value);
+	}
+
+	append (&str, "# EOF\n");
+
+	/* Label values may contain arbitrary bytes */
+	*out = char_to_pstring_lossy (str);
+	if (! *out)
+		die ("failed to convert metrics");
+
+	free (str);
+
+	for (i = 0; i < metric_count; i++) {
+		free (metrics[i].name);
+		free (metrics[i].path);
+	}
+
+	free (metrics);
+}
 
 /**
- * indent:
+ * render_trees:
  *
- * Current output indent value.
+ * @trees: array of element trees,
+ * @count: number of entries in @trees,
+ * @out: string to render into.
+ *
+ * Render @trees as a single document in the current output format,
+ * returning the result in a newly-allocated string, without modifying
+ * the @doc global.
  **/
-static int indent = 0;
+void
+render_trees (struct procenv_node * const *trees, size_t count, pstring **out)
+{
+	pstring  *saved;
+	size_t    i;
+
+	assert (trees);
+	assert (out);
+
+	if (output_format == OUTPUT_FORMAT_OPENMETRICS) {
+		render_openmetrics (trees, count, out);
+		return;
+	}
+
+	saved = doc;
+
+	doc = pstring_new ();
+	if (! doc)
+		die ("failed to allocate string");
+
+	reset_indent ();
+	last_element = current_element = ELEMENT_TYPE_NONE;
+
+	master_header (&doc);
+
+	for (i = 0; i < count; i++) {
+		assert (trees[i]);
+		render_node (trees[i]);
+	}
+
+	master_footer (&doc);
+
+	pstring_chomp (doc);
+
+	if (output_format != OUTPUT_FORMAT_XML && output_format != OUTPUT_FORMAT_JSON)
+		pstring_compress (&doc, wide_indent_char);
+
+	*out = doc;
+	doc = saved;
+}
 
 /**
- * indent_amount:
+ * render_tree:
  *
- * Number of INDENT_CHARs to emit for an indent.
+ * @tree: element tree,
+ * @out: string to render into.
+ *
+ * Render @tree in the current output format (see render_trees()).
  **/
-static int indent_amount = DEFAULT_INDENT_AMOUNT;
+void
+render_tree (struct procenv_node *tree, pstring **out)
+{
+	render_trees (&tree, 1, out);
+}
 
 /**
- * indent_char, wide_indent_char:
+ * render_emits:
  *
- * Character to use for indenting and wide-char equivalent.
+ * Render the element tree to each output format and location
+ * specified via --emit.
  **/
-const char *indent_char = DEFAULT_INDENT_CHAR;
-wchar_t  wide_indent_char;
+void
+render_emits (void)
+{
+	pstring  *rendered;
+	size_t    i;
+
+	emit_tree = record_stop ();
+
+	for (i = 0; i < emit_count; i++) {
+		struct procenv_emit *emit = &emits[i];
+
+		output_format = emit->format;
+		output = emit->output;
+		output_file = emit->file;
+		output_fd = -1;
+
+		output_init ();
+
+		render_tree (emit_tree, &rendered);
+
+		show_document (rendered);
+
+		pstring_free (rendered);
+
+		if (output_fd != -1) {
+			close (output_fd);
+			output_fd = -1;
+		}
+	}
+}
 
 /**
- * crumb_separator:
+ * show_recorded:
  *
- * Separator used for text output format to separate a name from a
- * value.
+ * Render and display the elements recorded since an output format
+ * that can only be produced once all details are known was selected.
  **/
-const char *crumb_separator = PROCENV_DEFAULT_CRUMB_SEPARATOR;
+void
+show_recorded (void)
+{
+	struct procenv_node  *tree;
+	pstring              *rendered;
+
+	tree = record_stop ();
+
+	render_tree (tree, &rendered);
+
+	show_document (rendered);
+
+	pstring_free (rendered);
+	free_tree (tree);
+}
+
+static void
+free_emits (void)
+{
+	size_t i;
+
+	for (i = 0; i < emit_count; i++)
+		free (emits[i].file);
+
+	free (emits);
+	emits = NULL;
+	emit_count = 0;
+
+	free_tree (emit_tree);
+	emit_tree = NULL;
+
+	record_abort ();
+}
 
 void
 header (const char *name)
@@ -219,6 +2143,9 @@ master_footer (pstring **doc)
 {
 	common_assert ();
 
+	if (recording)
+		return;
+
 	switch (output_format) {
 
 	case OUTPUT_FORMAT_CRUMB: /* FALL */
@@ -263,6 +2190,14 @@ object_open (int retain)
 {
 	common_assert ();
 
+	if (query_count)
+		return;
+
+	if (recording) {
+		tree_open (ELEMENT_TYPE_OBJECT_OPEN, NULL, retain);
+		return;
+	}
+
 	if (output_format == OUTPUT_FORMAT_JSON) {
 		if (retain) {
 			format_element ();
@@ -318,6 +2253,14 @@ object_close (int retain)
 {
 	common_assert ();
 
+	if (query_count)
+		return;
+
+	if (recording) {
+		tree_close (ELEMENT_TYPE_OBJECT_OPEN, retain);
+		return;
+	}
+
 	if (output_format == OUTPUT_FORMAT_JSON) {
 		if (retain) {
 			format_element ();
@@ -362,7 +2305,7 @@ name_to_wide_name(const char *name)
 {
 	pstring *encoded_name = NULL;
 
-	encoded_name = char_to_pstring (name);
+	encoded_name = char_to_pstring_lossy (name);
 	if (! encoded_name)
 		die ("failed to convert string to pstring");
 
@@ -387,6 +2330,16 @@ section_open (const char *name)
 
 	pstring *encoded_name = NULL;
 
+	if (query_count) {
+		query_push (name);
+		return;
+	}
+
+	if (recording) {
+		tree_open (ELEMENT_TYPE_SECTION_OPEN, name, false);
+		return;
+	}
+
 	encoded_name = name_to_wide_name(name);
 
 	change_element (ELEMENT_TYPE_SECTION_OPEN);
@@ -422,6 +2375,16 @@ section_close (void)
 {
 	common_assert ();
 
+	if (query_count) {
+		query_pop ();
+		return;
+	}
+
+	if (recording) {
+		tree_close (ELEMENT_TYPE_SECTION_OPEN, false);
+		return;
+	}
+
 	change_element (ELEMENT_TYPE_SECTION_CLOSE);
 
 	switch (output_format) {
@@ -465,6 +2428,16 @@ container_open (const char *name)
 
 	pstring *encoded_name = NULL;
 
+	if (query_count) {
+		query_push (name);
+		return;
+	}
+
+	if (recording) {
+		tree_open (ELEMENT_TYPE_CONTAINER_OPEN, name, false);
+		return;
+	}
+
 	encoded_name = name_to_wide_name(name);
 
 	change_element (ELEMENT_TYPE_CONTAINER_OPEN);
@@ -505,6 +2478,16 @@ container_close (void)
 {
 	common_assert ();
 
+	if (query_count) {
+		query_pop ();
+		return;
+	}
+
+	if (recording) {
+		tree_close (ELEMENT_TYPE_CONTAINER_OPEN, false);
+		return;
+	}
+
 	change_element (ELEMENT_TYPE_CONTAINER_CLOSE);
 
 	switch (output_format) {
@@ -586,6 +2569,7 @@ entry (const char *name, const char *fmt, ...)
 {
 	pstring  *encoded_name = NULL;
 	pstring  *encoded_value = NULL;
+	char     *value = NULL;
 	va_list   ap;
 
 	assert (name);
@@ -593,9 +2577,39 @@ entry (const char *name, const char *fmt, ...)
 
 	common_assert ();
 
+	if (query_count) {
+		if (query_skip_depth)
+			return;
+
+		if (! query_entry_matches (name))
+			return;
+
+		va_start (ap, fmt);
+		query_add_result (name, fmt, ap);
+		va_end (ap);
+
+		return;
+	}
+
+	if (recording) {
+		struct procenv_node *node;
+
+		node = tree_add (ELEMENT_TYPE_ENTRY, name);
+
+		va_start (ap, fmt);
+		appendva (&node->value, fmt, ap);
+		va_end (ap);
+
+		return;
+	}
+
 	change_element (ELEMENT_TYPE_ENTRY);
 
-	encoded_name = char_to_pstring (name);
+	/* Names and values may originate outside procenv (for example
+	 * environment variables), so must not be assumed to be valid in
+	 * the current locale.
+	 */
+	encoded_name = char_to_pstring_lossy (name);
 	if (! encoded_name)
 		die ("failed to encode name");
 
@@ -610,9 +2624,15 @@ entry (const char *name, const char *fmt, ...)
 
 	/* expand format */
 	va_start (ap, fmt);
-	wmappendva (&encoded_value, fmt, ap);
+	appendva (&value, fmt, ap);
 	va_end (ap);
 
+	encoded_value = char_to_pstring_lossy (value);
+	if (! encoded_value)
+		die ("failed to encode value");
+
+	free (value);
+
 	if (encode_string (&encoded_value) < 0)
 		die ("failed to encode value");
 
@@ -685,7 +2705,108 @@ _show_output_pstring (const pstring *pstr)
 
 	str = pstring_to_char (pstr);
 
-	_show_output (str);
+	_show_output (str);
+
+	free (str);
+}
+
+/**
+ * write_file_atomically:
+ *
+ * @str: string to write.
+ *
+ * Replace output_file with a file containing @str such that other
+ * processes never observe a partially-written file.
+ **/
+static void
+write_file_atomically (const char *str)
+{
+	char     *tmp = NULL;
+	size_t    len;
+	ssize_t   ret;
+	int       fd;
+
+	assert (str);
+	assert (output_file);
+
+	/* Must be in the same directory for rename(2) to be atomic */
+	appendf (&tmp, "%s.XXXXXX", output_file);
+
+	fd = mkstemp (tmp);
+	if (fd < 0) {
+		fprintf (stderr, "ERROR: failed to create temporary file '%s': %s\n",
+				tmp, strerror (errno));
+		exit (EXIT_FAILURE);
+	}
+
+	if (fchmod (fd, (S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH)) < 0)
+		goto error;
+
+	for (len = strlen (str); len; len -= (size_t)ret, str += ret) {
+		ret = write (fd, str, len);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				ret = 0;
+				continue;
+			}
+			goto error;
+		}
+	}
+
+	if (fsync (fd) < 0 || close (fd) < 0) {
+		fd = -1;
+		goto error;
+	}
+
+	if (rename (tmp, output_file) < 0) {
+		fd = -1;
+		goto error;
+	}
+
+	free (tmp);
+
+	return;
+
+error:
+	fprintf (stderr, "ERROR: failed to write to file '%s': %s\n",
+			output_file, strerror (errno));
+
+	if (fd != -1)
+		close (fd);
+
+	(void)unlink (tmp);
+
+	exit (EXIT_FAILURE);
+}
+
+/**
+ * show_document:
+ *
+ * @pstr: complete rendered document.
+ *
+ * Display @pstr (see _show_output_pstring()), replacing the output
+ * file atomically for the openmetrics format since it is intended to
+ * be read by a concurrently-running scraper.
+ **/
+void
+show_document (const pstring *pstr)
+{
+	char *str;
+
+	assert (pstr);
+
+	if (output != OUTPUT_FILE
+			|| output_file_append
+			|| output_format != OUTPUT_FORMAT_OPENMETRICS) {
+		_show_output_pstring (pstr);
+		return;
+	}
+
+	str = pstring_to_char (pstr);
+	if (! str)
+		die ("failed to convert output");
+
+	write_file_atomically (str);
 
 	free (str);
 }
@@ -846,553 +2967,95 @@ inc_indent (void)
 {
 	assert (indent >= 0);
 
-	indent += indent_amount;
-}
-
-/**
- * dec_indent:
- *
- * Decrease indent.
- **/
-void
-dec_indent (void)
-{
-	assert (indent >= 0);
-
-	indent -= indent_amount;
-
-	assert (indent >= 0);
-}
-
-/**
- * add_indent:
- *
- * Insert the current indent to the output document.
- **/
-void
-add_indent (pstring **doc)
-{
-	common_assert ();
-
-	if (! indent)
-		return;
-
-	if (! strcmp (indent_char, DEFAULT_INDENT_CHAR)) {
-		wappendf (doc, L"%*s", indent, indent_char);
-	} else {
-		pstring *buffer = NULL;
-
-		// Expand the buffer to the appropriate
-		// length by filling it with spaces and a random
-		// character.
-		wappendf (&buffer, L"%*lc", indent, wide_indent_char);
-
-
-		/* Now, replace the spaces and the random character with
-		 * the chosen character. This convoluted approach is
-		 * necessary as printf-type functions don't allow the
-		 * padding character to be specified.
-		 */
-		wmemset (buffer->buf, wide_indent_char, wcslen (buffer->buf));
-
-		pappend (doc, buffer);
-		pstring_free (buffer);
-	}
-}
-
-/**
- * master_header:
- *
- * @doc: document to write footer to.
- *
- * Main header which is displayed once.
- **/
-void
-master_header (pstring **doc)
-{
-	common_assert ();
-
-	switch (output_format) {
-
-	case OUTPUT_FORMAT_CRUMB: /* FALL */
-	case OUTPUT_FORMAT_TEXT:
-		/* NOP */
-		break;
-
-	case OUTPUT_FORMAT_JSON:
-		object_open (false);
-		break;
-
-	case OUTPUT_FORMAT_XML:
-		wappend (doc, L"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-		wappendf (doc, L"<%s version=\"%s\" package_string=\"%s\" "
-				"mode=\"%s%s\" format_version=\"%d\">\n",
-				PACKAGE_NAME, PACKAGE_VERSION, PACKAGE_STRING,
-				user.euid ? _(NON_STR) "-" : "",
-				PRIVILEGED_STR,
-				PROCENV_FORMAT_VERSION);
-
-		inc_indent ();
-
-		break;
-
-	default:
-		assert_not_reached ();
-		break;
-	}
-}
-
-void
-add_breadcrumb (const char *name)
-{
-	assert (name);
-
-	if (! crumb_list)
-		crumb_list = pr_list_new (NULL);
-
-	assert (crumb_list);
-
-	pr_list_prepend_str (crumb_list, name);
-}
-
-void
-remove_breadcrumb (void)
-{
-	PRList  *entry;
-
-	assert (crumb_list);
-
-	entry = pr_list_remove (crumb_list->prev);
-	assert (entry);
-
-	free ((char *)entry->data);
-	free (entry);
-}
-
-static void
-clear_breadcrumbs (void)
-{
-	assert (crumb_list);
-
-	while (crumb_list->prev != crumb_list)
-		remove_breadcrumb ();
-}
-
-static void
-free_breadcrumbs (void)
-{
-	if (output_format == OUTPUT_FORMAT_CRUMB && crumb_list) {
-		clear_breadcrumbs ();
-		free (crumb_list);
-	}
-}
-
-/**
- * change_element:
- *
- * Handle changing to a new element type. Depending on the output
- * format, this may require separators and newlines to be emitted to
- * produce well-formatted output.
- **/
-void
-change_element (ElementType new)
-{
-	common_assert ();
-
-	last_element = current_element;
-
-	current_element = new;
-
-	format_element ();
-}
-
-void
-format_element (void)
-{
-	switch (output_format) {
-
-	case OUTPUT_FORMAT_TEXT:
-		format_text_element ();
-		break;
-
-	case OUTPUT_FORMAT_CRUMB:
-		/* NOP */
-		break;
-
-	case OUTPUT_FORMAT_JSON:
-		format_json_element ();
-		break;
-
-	case OUTPUT_FORMAT_XML:
-		format_xml_element ();
-		break;
-
-	default:
-		assert_not_reached ();
-		break;
-	}
-}
-
-void
-format_text_element (void)
-{
-	common_assert ();
-	switch (last_element) {
-
-	case ELEMENT_TYPE_ENTRY:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_SECTION_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				/* NOP */
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_SECTION_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_CONTAINER_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				/* NOP */
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_CONTAINER_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_NONE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	default:
-		assert_not_reached ();
-		break;
-	}
-}
-
-void
-format_json_element (void)
-{
-	common_assert ();
-
-	switch (last_element) {
-
-	case ELEMENT_TYPE_ENTRY:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L",\n");
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
-
-	case ELEMENT_TYPE_SECTION_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+	indent += indent_amount;
+}
 
-			case ELEMENT_TYPE_SECTION_CLOSE:
-			case ELEMENT_TYPE_OBJECT_OPEN:
-				/* NOP */
-				break;
+/**
+ * dec_indent:
+ *
+ * Decrease indent.
+ **/
+void
+dec_indent (void)
+{
+	assert (indent >= 0);
 
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				assert_not_reached ();
-				break;
+	indent -= indent_amount;
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	assert (indent >= 0);
+}
 
-	case ELEMENT_TYPE_SECTION_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L",\n");
-				add_indent (&doc);
-				break;
+/**
+ * add_indent:
+ *
+ * Insert the current indent to the output document.
+ **/
+void
+add_indent (pstring **doc)
+{
+	wchar_t  c;
+	wchar_t *p;
 
-			case ELEMENT_TYPE_OBJECT_OPEN:
-				/* NOP */
-				break;
+	common_assert ();
 
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
+	if (! indent)
+		return;
 
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
+	c = strcmp (indent_char, DEFAULT_INDENT_CHAR) ? wide_indent_char : L' ';
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	/* Avoid formatting the indent for every element */
+	if ((size_t)indent > indent_buffer_len || c != indent_buffer_char) {
+		p = realloc (indent_buffer, indent * sizeof (wchar_t));
+		if (! p)
+			die ("failed to allocate indent");
 
-	case ELEMENT_TYPE_CONTAINER_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+		indent_buffer = p;
+		indent_buffer_len = indent;
+		indent_buffer_char = c;
 
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				assert_not_reached ();
-				break;
+		wmemset (indent_buffer, c, indent_buffer_len);
+	}
 
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				/* NOP */
-				break;
+	wappendn (doc, indent_buffer, indent);
+}
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+/**
+ * master_header:
+ *
+ * @doc: document to write footer to.
+ *
+ * Main header which is displayed once.
+ **/
+void
+master_header (pstring **doc)
+{
+	common_assert ();
 
-	case ELEMENT_TYPE_CONTAINER_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L",\n");
-				add_indent (&doc);
-				break;
+	if (recording)
+		return;
 
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
+	switch (output_format) {
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
+	case OUTPUT_FORMAT_CRUMB: /* FALL */
+	case OUTPUT_FORMAT_TEXT:
+		/* NOP */
 		break;
 
-	case ELEMENT_TYPE_OBJECT_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				/* NOP */
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
+	case OUTPUT_FORMAT_JSON:
+		object_open (false);
 		break;
 
-	case ELEMENT_TYPE_OBJECT_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_OBJECT_OPEN:
-			case ELEMENT_TYPE_SECTION_OPEN:
-				wappend (&doc, L",\n");
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	case OUTPUT_FORMAT_XML:
+		wappend (doc, L"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+		wappendf (doc, L"<%s version=\"%s\" package_string=\"%s\" "
+				"mode=\"%s%s\" format_version=\"%d\">\n",
+				PACKAGE_NAME, PACKAGE_VERSION, PACKAGE_STRING,
+				user.euid ? _(NON_STR) "-" : "",
+				PRIVILEGED_STR,
+				PROCENV_FORMAT_VERSION);
 
-	case ELEMENT_TYPE_NONE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				add_indent (&doc);
-				break;
+		inc_indent ();
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
 		break;
 
 	default:
@@ -1402,222 +3065,120 @@ format_json_element (void)
 }
 
 void
-format_xml_element (void)
+add_breadcrumb (const char *name)
 {
-	common_assert ();
-
-	switch (last_element) {
-
-	case ELEMENT_TYPE_ENTRY:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
-
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
-
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	pstring  *wide_name;
+	char     *valid_name;
 
-	case ELEMENT_TYPE_SECTION_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+	assert (name);
 
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
+	if (! crumb_list)
+		crumb_list = pr_list_new (NULL);
 
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				assert_not_reached ();
-				break;
+	assert (crumb_list);
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	/* Breadcrumbs are formatted into the wide output document using
+	 * "%s", which fails unless they are valid in the current locale.
+	 */
+	wide_name = char_to_pstring_lossy (name);
+	if (! wide_name)
+		die ("failed to encode name");
 
-	case ELEMENT_TYPE_SECTION_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
+	valid_name = pstring_to_char (wide_name);
 
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
+	pr_list_prepend_str (crumb_list, valid_name ? valid_name : "");
 
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
+	free (valid_name);
+	pstring_free (wide_name);
+}
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+void
+remove_breadcrumb (void)
+{
+	PRList  *entry;
 
-	case ELEMENT_TYPE_CONTAINER_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+	assert (crumb_list);
 
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				assert_not_reached ();
-				break;
+	entry = pr_list_remove (crumb_list->prev);
+	assert (entry);
 
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
+	free ((char *)entry->data);
+	free (entry);
+}
 
-			case ELEMENT_TYPE_OBJECT_OPEN:
-				add_indent (&doc);
-				break;
+static void
+clear_breadcrumbs (void)
+{
+	assert (crumb_list);
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	while (crumb_list->prev != crumb_list)
+		remove_breadcrumb ();
+}
 
-	case ELEMENT_TYPE_CONTAINER_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				add_indent (&doc);
-				break;
+static void
+free_breadcrumbs (void)
+{
+	if (crumb_list) {
+		clear_breadcrumbs ();
+		free (crumb_list);
+	}
+}
 
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				add_indent (&doc);
-				break;
+/**
+ * change_element:
+ *
+ * Handle changing to a new element type. Depending on the output
+ * format, this may require separators and newlines to be emitted to
+ * produce well-formatted output.
+ **/
+void
+change_element (ElementType new)
+{
+	common_assert ();
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	last_element = current_element;
 
-	case ELEMENT_TYPE_OBJECT_OPEN:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+	current_element = new;
 
-			case ELEMENT_TYPE_CONTAINER_OPEN:
-				wappend (&doc, L"\n");
-				inc_indent ();
-				add_indent (&doc);
-				break;
+	format_element ();
+}
 
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				/* NOP */
-				break;
+/**
+ * format_element:
+ *
+ * Produce the layout required between the previous and current
+ * elements for the current output format, as specified by
+ * transitions.
+ **/
+void
+format_element (void)
+{
+	const struct procenv_transition *transition;
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	common_assert ();
 
-	case ELEMENT_TYPE_OBJECT_CLOSE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_CLOSE:
-				/* NOP */
-				break;
+	if ((int)output_format < 0 || output_format >= OUTPUT_FORMAT_COUNT
+			|| last_element < ELEMENT_TYPE_NONE
+			|| last_element >= ELEMENT_TYPE_COUNT
+			|| current_element < 0
+			|| current_element >= ELEMENT_TYPE_COUNT)
+		assert_not_reached ();
 
-			case ELEMENT_TYPE_CONTAINER_CLOSE:
-			case ELEMENT_TYPE_ENTRY:
-				wappend (&doc, L"\n");
-				dec_indent ();
-				break;
+	transition = &transitions[output_format][TRANSITION_FROM (last_element)][current_element];
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	if (! transition->valid)
+		assert_not_reached ();
 
-	case ELEMENT_TYPE_NONE:
-		{
-			switch (current_element) {
-			case ELEMENT_TYPE_ENTRY: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_OPEN: /* FALL */
-			case ELEMENT_TYPE_SECTION_CLOSE: /* FALL */
-			case ELEMENT_TYPE_CONTAINER_CLOSE: /* FALL */
-			case ELEMENT_TYPE_OBJECT_OPEN: /* FALL */
-			case ELEMENT_TYPE_OBJECT_CLOSE:
-				add_indent (&doc);
-				break;
+	if (transition->separator)
+		wappend (&doc, transition->separator);
 
-			default:
-				assert_not_reached ();
-				break;
-			}
-		}
-		break;
+	if (transition->indent > 0)
+		inc_indent ();
+	else if (transition->indent < 0)
+		dec_indent ();
 
-	default:
-		assert_not_reached ();
-		break;
-	}
+	if (transition->add_indent)
+		add_indent (&doc);
 }
 
 void
@@ -1642,20 +3203,45 @@ set_output_value_raw (Output o)
 	output = o;
 }
 
-void
-set_output_format (const char *name)
+/**
+ * get_output_format_by_name:
+ *
+ * @name: name of output format,
+ * @format: output format corresponding to @name.
+ *
+ * Returns: true if @name is a valid output format, else false.
+ **/
+bool
+get_output_format_by_name (const char *name, OutputFormat *format)
 {
 	struct procenv_map *p;
 
 	assert (name);
+	assert (format);
 
 	for (p = output_format_map; p && p->name; p++) {
 		if (! strcmp (name, p->name)) {
-			output_format = p->num;
-			return;
+			*format = p->num;
+			return true;
 		}
 	}
-	die ("invalid output format value: '%s'", name);
+
+	return false;
+}
+
+void
+set_output_format (const char *name)
+{
+	assert (name);
+
+	if (! get_output_format_by_name (name, &output_format))
+		die ("invalid output format value: '%s'", name);
+
+	/* Metrics are grouped by name, so can only be rendered once all
+	 * details have been collected.
+	 */
+	if (output_format == OUTPUT_FORMAT_OPENMETRICS)
+		record_start ();
 }
 
 const char *
@@ -1703,6 +3289,12 @@ output_finalise (void)
 		close (output_fd);
 
 	free_breadcrumbs ();
+	free_queries ();
+	free_emits ();
+
+	free (indent_buffer);
+	indent_buffer = NULL;
+	indent_buffer_len = 0;
 
 	if (output == OUTPUT_SYSLOG)
 		closelog ();
@@ -1964,16 +3556,18 @@ encode_string (pstring **pstr)
 
 		/* Calculate expanded size of string by removing
 		 * count of non-printable byte and adding back the
-		 * number of bytes required to encode them in expanded
-		 * form.
+		 * maximum number of bytes required to encode them in
+		 * expanded form (characters outside the Basic
+		 * Multilingual Plane require a UTF-16 surrogate pair for
+		 * JSON and up to 6 digits for XML).
 		 */
 		switch (output_format) {
 		case OUTPUT_FORMAT_XML:
-			new_size = (len - non_printables) + (non_printables * wcslen (L"&#x..;"));
+			new_size = (len - non_printables) + (non_printables * wcslen (L"&#x......;"));
 			break;
 
 		case OUTPUT_FORMAT_JSON:
-			new_size = (len - non_printables) + (non_printables * wcslen (L"\\u...."));
+			new_size = (len - non_printables) + (non_printables * wcslen (L"\\u....\\u...."));
 			break;
 		default:
 			break;
@@ -2000,12 +3594,26 @@ encode_string (pstring **pstr)
 				*q = *p;
 				q++;
 				new->len++;
+			} else if (output_format == OUTPUT_FORMAT_JSON
+					&& (unsigned long)*p > 0xFFFF) {
+				unsigned long c = (unsigned long)*p - 0x10000;
+
+				ret = swprintf (q,
+						new_size - (q - new->buf),
+						L"\\u%4.4lx\\u%4.4lx",
+						0xD800 + (c >> 10),
+						0xDC00 + (c & 0x3FF));
+				if (ret < 0)
+					goto error;
+				q += ret;
 			} else {
 				ret = swprintf (q,
-						new_size,
+						new_size - (q - new->buf),
 						output_format == OUTPUT_FORMAT_JSON
 						? json_format : xml_format,
 						*p);
+				if (ret < 0)
+					goto error;
 				q += ret;
 			}
 		}
@@ -2018,4 +3626,8 @@ encode_string (pstring **pstr)
 	}
 
 	return ret;
+
+error:
+	pstring_free (new);
+	return -1;
 }
@@ -8,6 +8,8 @@
 #ifndef _PROCENV_OUTPUT_H
 #define _PROCENV_OUTPUT_H
 
+#include <stdbool.h>
+
 #include "types.h"
 #include "pstring.h"
 
@@ -38,6 +40,19 @@
 	_message ("WARNING",  __VA_ARGS__); \
 }
 
+#if defined (PROCENV_LIBRARY)
+
+/* When built as a library, errors are returned to the caller of the
+ * public API (see libprocenv.c) rather than terminating the process.
+ */
+void procenv_lib_fail (const char *prefix, const char *fmt, ...)
+	__attribute__ ((noreturn, format (printf, 2, 3)));
+
+#define bug(...) procenv_lib_fail ("BUG", __VA_ARGS__)
+#define die(...) procenv_lib_fail ("ERROR", __VA_ARGS__)
+
+#else
+
 #ifdef DEBUG
 /* for when running under GDB */
 #define die_finalise() raise (SIGUSR1)
@@ -51,8 +66,6 @@
 	exit (EXIT_FAILURE); \
 }
 
-#define POINTER_SIZE (sizeof (void *))
-
 #define die(...) \
 { \
 	output = OUTPUT_STDERR; \
@@ -61,6 +74,19 @@
 	die_finalise (); \
 }
 
+#endif /* PROCENV_LIBRARY */
+
+#define POINTER_SIZE (sizeof (void *))
+
+/**
+ * PROCENV_HASH_OFFSET, PROCENV_HASH_PRIME:
+ *
+ * Parameters of the 64-bit FNV-1a hash used to calculate section
+ * content hashes for canonical output.
+ **/
+#define PROCENV_HASH_OFFSET 0xcbf29ce484222325ULL
+#define PROCENV_HASH_PRIME  0x100000001b3ULL
+
 #define common_assert() \
 	assert (doc); \
 	assert (get_indent_amount() >= 0)
@@ -83,7 +109,8 @@ typedef enum {
 	OUTPUT_FORMAT_TEXT,
 	OUTPUT_FORMAT_CRUMB,
 	OUTPUT_FORMAT_JSON,
-	OUTPUT_FORMAT_XML
+	OUTPUT_FORMAT_XML,
+	OUTPUT_FORMAT_OPENMETRICS
 } OutputFormat;
 
 typedef enum element_type {
@@ -97,6 +124,9 @@ typedef enum element_type {
 	ELEMENT_TYPE_NONE = -1
 } ElementType;
 
+/* Opaque element tree (see output.c) */
+struct procenv_node;
+
 /********************************************************************/
 
 extern Output        output;
@@ -129,6 +159,7 @@ void entry (const char *name, const char *fmt, ...);
 void _show (const char *prefix, int indent, const char *fmt, ...);
 void _show_output (const char *str);
 void _show_output_pstring (const pstring *pstr);
+void show_document (const pstring *pstr);
 
 void inc_indent (void);
 void dec_indent (void);
@@ -153,16 +184,35 @@ void set_output_file_append (void);
 void change_element (ElementType new);
 void format_element (void);
 
-void format_text_element (void);
-void format_json_element (void);
-void format_xml_element (void);
 
 void set_output_value (const char *name);
 void set_output_value_raw (Output o);
 void set_output_format (const char *name);
+bool get_output_format_by_name (const char *name, OutputFormat *format);
 const char *get_output_format_name (void);
 
 const char *get_text_separator (void);
 void set_text_separator (const char *s);
 
+void add_query (const char *spec);
+size_t get_query_count (void);
+const char *get_query (size_t i);
+bool query_section_wanted (const char *name);
+void show_query_results (pstring **doc);
+
+void add_emit (const char *spec);
+size_t get_emit_count (void);
+void render_emits (void);
+void entry_func (const char *name, const char *(*func) (void));
+
+void record_start (void);
+bool is_recording (void);
+struct procenv_node *record_stop (void);
+void record_abort (void);
+void render_tree (struct procenv_node *tree, pstring **out);
+void render_trees (struct procenv_node * const *trees, size_t count, pstring **out);
+void free_tree (struct procenv_node *tree);
+void show_recorded (void);
+void set_canonical (void);
+
 #endif /* _PROCENV_OUTPUT_H */
@@ -86,14 +86,21 @@ typedef struct statfs procenv_mnt_type;
 #include <selinux/selinux.h>
 #endif
 
-#if defined (HAVE_SYS_CAPABILITY_H)
-#include <sys/capability.h>
-#endif
-
 #if defined (__GLIBC__)
 #include <sys/sysmacros.h>
 #endif
 
+#if defined (PROCENV_PLATFORM_LINUX)
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <sys/timex.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#endif
+
 /* Network family for entries containing link-level interface
  * details. These entries will be cached to allow MAC addresses
  * to be extracted from them when displaying the corresponding
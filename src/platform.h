@@ -37,7 +37,8 @@ extern struct utsname uts;
 typedef enum {
 	SHOW_ALL,
 	SHOW_MOUNTS,
-	SHOW_PATHCONF
+	SHOW_PATHCONF,
+	SHOW_HUGETLBFS
 } ShowMountType;
 
 #include <procenv.h>
@@ -124,9 +125,11 @@ struct procenv_ops
 	int (*get_mtu) (const struct ifaddrs *ifaddr);
 	bool (*get_time) (struct timespec *ts);
 
+	void (*show_auxv) (void);
 	void (*show_capabilities) (void);
 	void (*show_cgroups) (void);
 	void (*show_clocks) (void);
+	void (*show_clock_probe) (void);
 	void (*show_confstrs) (void);
 	void (*show_cpu_affinities) (void);
 	void (*show_cpu) (void);
@@ -134,21 +137,27 @@ struct procenv_ops
 					unsigned short *flags);
 	void (*show_fd_capabilities) (int fd);
 	void (*show_fds) (void);
+	void (*show_hugepages) (void);
+	void (*show_instruction_set) (void);
 	void (*show_io_priorities) (void);
 	void (*show_mounts) (ShowMountType what);
 	void (*show_msg_queues) (void);
 	void (*show_namespaces) (void);
+	bool (*show_network_interfaces) (void);
+	void (*show_nic) (void);
 	void (*show_oom) (void);
 	void (*show_prctl) (void);
 	void (*show_rlimits) (void);
 	void (*show_security_module) (void);
 	void (*show_semaphores) (void);
 	void (*show_shared_mem) (void);
+	void (*show_thread_scheduling) (void);
 	void (*show_timezone) (void);
 	void (*show_libs) (void);
 
 	void (*handle_memory) (void);
 	void (*handle_numa_memory) (void);
+	void (*handle_process_memory) (void);
 	void (*handle_proc_branch) (void);
 	void (*handle_scheduler_type) (void);
 
@@ -451,7 +451,9 @@ show_libs_darwin(void)
 		if (! strcmp(name, path)) {
 			const struct mach_header *header = _dyld_get_image_header(i);
 
+			container_open ("list");
 			handle_load_cmds(header);
+			container_close ();
 			break;
 		}
 	}
@@ -78,95 +78,157 @@
 #define LINUX_KERNEL_MMR(major, minor, revision) \
     (linux_kernel_version (major, minor, revision))
 
-/**
- * show_capability:
- * @caps: cap_t,
- * @cap: capability.
- *
- * Display specified capability, or NOT_DEFINED_STR if value is
- * unknown.
- **/
-#ifdef PR_CAPBSET_READ
-#define show_capability(caps, cap) \
-	_show_capability (caps, cap, #cap)
-
-#define _show_capability(caps, cap, name) \
-{ \
-	int bound; \
-	int effective; \
-	int inheritable; \
-	int permitted; \
-	int ambient; \
-	\
-	bound = cap_get_bound (cap); \
-	\
-	ambient = get_ambient_capability (cap); \
-	effective = get_capability_by_flag_type (caps, CAP_EFFECTIVE, cap); \
-	inheritable = get_capability_by_flag_type (caps, CAP_INHERITABLE, cap); \
-	permitted = get_capability_by_flag_type (caps, CAP_PERMITTED, cap); \
-	\
-	section_open (name); \
-	\
-	entry ("number", "%d", cap); \
-	\
-	entry ("supported", "%s", \
-			CAP_IS_SUPPORTED (cap) \
-			? YES_STR : NO_STR); \
-	\
-	entry ("in bounding set", "%s", \
-			bound < 0 \
-			? UNKNOWN_STR \
-			: bound \
-			? YES_STR \
-			: NO_STR); \
-	\
-	entry ("ambient", "%s", \
-			ambient < 0 \
-			? NOT_DEFINED_STR \
-			: permitted == CAP_SET \
-			? YES_STR \
-			: NO_STR); \
-	\
-	entry ("effective", "%s", \
-			effective < 0 \
-			? NOT_DEFINED_STR \
-			: effective == CAP_SET \
-			? YES_STR \
-			: NO_STR); \
-	\
-	entry ("inheritable", "%s", \
-			inheritable < 0 \
-			? NOT_DEFINED_STR \
-			: inheritable == CAP_SET \
-			? YES_STR \
-			: NO_STR); \
-	\
-	entry ("permitted", "%s", \
-			permitted < 0 \
-			? NOT_DEFINED_STR \
-			: permitted == CAP_SET \
-			? YES_STR \
-			: NO_STR); \
-	\
-	section_close (); \
-}
-#else
-#define show_capability(caps, cap)
-#endif
+/* Path to file containing the highest capability number supported by
+ * the running kernel (Linux 3.2+).
+ */
+#define PROCENV_CAP_LAST_CAP_PATH "/proc/sys/kernel/cap_last_cap"
+
+/* Capability sets of a process (bit N set for capability N) */
+struct procenv_capsets {
+	uint64_t  effective;
+	uint64_t  permitted;
+	uint64_t  inheritable;
+	uint64_t  bounding;
+	uint64_t  ambient;
+
+	/* The bounding and ambient sets are only available via
+	 * /proc/<pid>/status (Linux 2.6.26+ and 4.3+ respectively).
+	 */
+	bool      have_bounding;
+	bool      have_ambient;
+};
+
+#if defined (__i386__) || defined (__x86_64__)
+
+#include <cpuid.h>
+
+#define PROCENV_HAVE_CPUID
+
+/* Leaves (and sub-leaves) of cpuid(1) queried for feature flags.
+ * Each is read exactly once and cached.
+ */
+typedef enum {
+	CPUID_LEAF_1,
+	CPUID_LEAF_7_0,
+	CPUID_LEAF_7_1,
+	CPUID_LEAF_EXT_1,
+	CPUID_LEAF_EXT_7,
+
+	CPUID_LEAF_COUNT
+} CPUIDLeaf;
+
+typedef enum {
+	CPUID_EAX,
+	CPUID_EBX,
+	CPUID_ECX,
+	CPUID_EDX,
+
+	CPUID_REG_COUNT
+} CPUIDRegister;
+
+/* XCR0 bits that the OS must set to allow use of AVX (XMM+YMM
+ * state) and AVX-512 (additionally opmask+ZMM state).
+ */
+#define PROCENV_XCR0_AVX             0x06
+#define PROCENV_XCR0_AVX512          0xe6
+
+struct procenv_cpuid_feature {
+	const char     *name;
+	CPUIDLeaf       leaf;
+	CPUIDRegister   reg;
+	unsigned int    bit;
+};
+
+#define mk_cpuid_entry(name, leaf, reg, bit) \
+	{ name, CPUID_LEAF_ ## leaf, CPUID_ ## reg, bit }
 
-#if defined (HAVE_SYS_CAPABILITY_H)
+#endif /* __i386__ || __x86_64__ */
 
-#ifndef CAP_IS_SUPPORTED
+/* Userspace view of the kernel's struct sched_attr (see
+ * sched_setattr(2)). Defined here since the glibc wrapper and
+ * type are very recent additions.
+ */
+struct procenv_sched_attr {
+	uint32_t size;
+
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+
+	/* SCHED_OTHER, SCHED_BATCH */
+	int32_t  sched_nice;
+
+	/* SCHED_FIFO, SCHED_RR */
+	uint32_t sched_priority;
 
-static int cap_get_bound (cap_value_t cap)
-    __attribute__((unused));
+	/* SCHED_DEADLINE (nanoseconds) */
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
 
-#define CAP_IS_SUPPORTED(cap) (cap_get_bound (cap) >= 0)
-#define PROCENV_NEED_LOCAL_CAP_GET_BOUND
+	/* Utilization clamps (Linux 5.3+) */
+	uint32_t sched_util_min;
+	uint32_t sched_util_max;
+};
+
+/* Size of the original structure, before the utilization clamps
+ * were added.
+ */
+#define PROCENV_SCHED_ATTR_SIZE_VER0       48
+
+#define PROCENV_SCHED_FLAG_RESET_ON_FORK   0x01
+#define PROCENV_SCHED_FLAG_RECLAIM         0x02
+#define PROCENV_SCHED_FLAG_DL_OVERRUN      0x04
+#define PROCENV_SCHED_FLAG_UTIL_CLAMP_MIN  0x20
+#define PROCENV_SCHED_FLAG_UTIL_CLAMP_MAX  0x40
+
+/* Network interface details obtained via RTM_GETLINK */
+struct procenv_netlink_link {
+	int            index;
+	unsigned int   flags;
+	unsigned short type;
+	char           name[IFNAMSIZ];
+	unsigned char  mac[32];
+	size_t         mac_len;
+	unsigned int   mtu;
+	char           qdisc[IFNAMSIZ];
+	unsigned int   txqlen;
+	bool           have_txqlen;
+	unsigned char  operstate;
+
+	/* IFLA_STATS64 counters */
+	struct rtnl_link_stats64  stats;
+	bool                      have_stats;
+};
 
-#endif /* CAP_IS_SUPPORTED */
+/* Network interface address obtained via RTM_GETADDR */
+struct procenv_netlink_addr {
+	/* order in which kernel returned the address */
+	size_t         seq;
 
-#endif /* HAVE_SYS_CAPABILITY_H */
+	int            index;
+	int            family;
+	unsigned int   prefix_len;
+	unsigned int   scope;
+
+	/* large enough for an IPv6 address */
+	unsigned char  address[16];
+	unsigned char  local[16];
+	unsigned char  broadcast[16];
+
+	bool           have_address;
+	bool           have_local;
+	bool           have_broadcast;
+};
+
+struct procenv_netlink {
+	struct procenv_netlink_link  *links;
+	size_t                        link_count;
+	size_t                        link_size;
+
+	struct procenv_netlink_addr  *addrs;
+	size_t                        addr_count;
+	size_t                        addr_size;
+};
 
 /* semctl(2) states that POSIX.1-2001 requires the caller define this! */
 union semun {
@@ -178,12 +240,11 @@ union semun {
 
 static bool linux_kernel_version (int major, int minor, int revision);
 
-#if defined (HAVE_SYS_CAPABILITY_H)
-static int get_capability_by_flag_type (cap_t cap_p, cap_flag_t type, cap_value_t cap)
-    __attribute__((unused));
-static int get_ambient_capability(cap_value_t cap)
-    __attribute__((unused));
-
-#endif /* HAVE_SYS_CAPABILITY_H */
+#if defined (PROCENV_HAVE_CPUID)
+static void get_cpuid_leaves (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		char *vendor);
+static bool cpuid_has_feature (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		const char *name);
+#endif /* PROCENV_HAVE_CPUID */
 
 #endif /* _PROCENV_PLATFORM_LINUX_H */
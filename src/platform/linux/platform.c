@@ -18,6 +18,10 @@ static struct procenv_map scheduler_map[] = {
 	mk_map_entry (SCHED_IDLE),
 #endif
 
+#ifdef SCHED_DEADLINE
+	mk_map_entry (SCHED_DEADLINE),
+#endif
+
 	{ NULL, 0 }
 };
 
@@ -227,7 +231,7 @@ pid_to_name (pid_t pid)
 
 	sprintf (path, "/proc/%d/cmdline", (int)pid);
 
-	f = fopen (path, "r");
+	f = fopen_tracked (path, "r");
 	if (! f)
 		goto out;
 
@@ -242,7 +246,7 @@ pid_to_name (pid_t pid)
 
 out:
 	if (f)
-		fclose (f);
+		fclose_tracked (f);
 
 	return name;
 }
@@ -256,147 +260,302 @@ get_user_misc_linux (struct procenv_user *user,
     get_canonical_generic_linux (ROOT_PATH, misc->root, sizeof (misc->root));
 }
 
-static void
-show_capabilities_linux (void)
+/* Names of capabilities indexed by number. The numbers form part of
+ * the kernel ABI so are specified explicitly to allow names to be
+ * displayed even when procenv is built against older headers.
+ */
+static const char *capability_names_linux[] = {
+	[0]  = "CAP_CHOWN",
+	[1]  = "CAP_DAC_OVERRIDE",
+	[2]  = "CAP_DAC_READ_SEARCH",
+	[3]  = "CAP_FOWNER",
+	[4]  = "CAP_FSETID",
+	[5]  = "CAP_KILL",
+	[6]  = "CAP_SETGID",
+	[7]  = "CAP_SETUID",
+	[8]  = "CAP_SETPCAP",
+	[9]  = "CAP_LINUX_IMMUTABLE",
+	[10] = "CAP_NET_BIND_SERVICE",
+	[11] = "CAP_NET_BROADCAST",
+	[12] = "CAP_NET_ADMIN",
+	[13] = "CAP_NET_RAW",
+	[14] = "CAP_IPC_LOCK",
+	[15] = "CAP_IPC_OWNER",
+	[16] = "CAP_SYS_MODULE",
+	[17] = "CAP_SYS_RAWIO",
+	[18] = "CAP_SYS_CHROOT",
+	[19] = "CAP_SYS_PTRACE",
+	[20] = "CAP_SYS_PACCT",
+	[21] = "CAP_SYS_ADMIN",
+	[22] = "CAP_SYS_BOOT",
+	[23] = "CAP_SYS_NICE",
+	[24] = "CAP_SYS_RESOURCE",
+	[25] = "CAP_SYS_TIME",
+	[26] = "CAP_SYS_TTY_CONFIG",
+	[27] = "CAP_MKNOD",
+	[28] = "CAP_LEASE",
+	[29] = "CAP_AUDIT_WRITE",
+	[30] = "CAP_AUDIT_CONTROL",
+	[31] = "CAP_SETFCAP",
+	[32] = "CAP_MAC_OVERRIDE",
+	[33] = "CAP_MAC_ADMIN",
+	[34] = "CAP_SYSLOG",
+	[35] = "CAP_WAKE_ALARM",
+	[36] = "CAP_BLOCK_SUSPEND",
+	[37] = "CAP_AUDIT_READ",
+	[38] = "CAP_PERFMON",
+	[39] = "CAP_BPF",
+	[40] = "CAP_CHECKPOINT_RESTORE",
+};
+
+#define PROCENV_CAPABILITY_NAMES \
+	(int)(sizeof (capability_names_linux) / sizeof (capability_names_linux[0]))
+
+/**
+ * get_cap_last_cap_linux:
+ *
+ * Returns: highest capability number supported by the running
+ * kernel, or -1 if unknown.
+ **/
+static int
+get_cap_last_cap_linux (void)
 {
-#if defined (HAVE_SYS_CAPABILITY_H)
-	int    last_known;
-	cap_t  caps;
+	struct procenv_field  field;
+	char                  buffer[32];
+	unsigned long         value;
+	int                   cap = 0;
 
-	/* Most recently-added capability that procenv knew about at
-	 * compile time.
-	 */
-	last_known = CAP_LAST_CAP;
+	if (read_file (PROCENV_CAP_LAST_CAP_PATH, buffer, sizeof (buffer)) > 0) {
+		field.ptr = buffer;
+		field.len = strlen (buffer);
+
+		if (field_to_ulong (&field, &value) && value < 64)
+			return (int)value;
+	}
+
+#if defined (PR_CAPBSET_READ)
+	/* Older kernel, so probe the bounding set */
+	while (cap < 64 && prctl (PR_CAPBSET_READ, cap, 0, 0, 0) >= 0)
+		cap++;
 #endif
 
-#if defined (HAVE_SYS_CAPABILITY_H)
-	caps = cap_get_proc ();
+	return cap - 1;
+}
 
-	entry ("count (CAP_LAST_CAP+1)", "%d", CAP_LAST_CAP+1);
+/**
+ * get_capset_field_linux:
+ *
+ * @field: hexadecimal capability set value from /proc/<pid>/status,
+ * @set: [output] capability set.
+ *
+ * Returns: true on success, else false.
+ **/
+static bool
+get_capset_field_linux (const struct procenv_field *field, uint64_t *set)
+{
+	char  *end = NULL;
 
-	if (! caps)
-		goto out;
+	assert (field);
+	assert (set);
 
-	section_open ("known");
+	if (! field->ptr || ! field->len)
+		return false;
 
-	show_capability (caps, CAP_CHOWN);
-	show_capability (caps, CAP_DAC_OVERRIDE);
-	show_capability (caps, CAP_DAC_READ_SEARCH);
-	show_capability (caps, CAP_FOWNER);
-	show_capability (caps, CAP_FSETID);
-	show_capability (caps, CAP_KILL);
-	show_capability (caps, CAP_SETGID);
-	show_capability (caps, CAP_SETUID);
-	show_capability (caps, CAP_SETPCAP);
-	show_capability (caps, CAP_LINUX_IMMUTABLE);
-	show_capability (caps, CAP_NET_BIND_SERVICE);
-	show_capability (caps, CAP_NET_BROADCAST);
-	show_capability (caps, CAP_NET_ADMIN);
-	show_capability (caps, CAP_NET_RAW);
-	show_capability (caps, CAP_IPC_LOCK);
-	show_capability (caps, CAP_IPC_OWNER);
-	show_capability (caps, CAP_SYS_MODULE);
-	show_capability (caps, CAP_SYS_RAWIO);
-	show_capability (caps, CAP_SYS_CHROOT);
-	show_capability (caps, CAP_SYS_PTRACE);
-	show_capability (caps, CAP_SYS_PACCT);
-	show_capability (caps, CAP_SYS_ADMIN);
-	show_capability (caps, CAP_SYS_BOOT);
-	show_capability (caps, CAP_SYS_NICE);
-	show_capability (caps, CAP_SYS_RESOURCE);
-	show_capability (caps, CAP_SYS_TIME);
-	show_capability (caps, CAP_SYS_TTY_CONFIG);
-
-	if (LINUX_KERNEL_MM (2, 4)) {
-		show_capability (caps, CAP_MKNOD);
-		show_capability (caps, CAP_LEASE);
-	}
+	/* the value is followed by a newline or nul in the buffer */
+	errno = 0;
+	*set = (uint64_t)strtoull (field->ptr, &end, 16);
 
-	if (LINUX_KERNEL_MMR (2, 6, 11)) {
-		show_capability (caps, CAP_AUDIT_WRITE);
-		show_capability (caps, CAP_AUDIT_CONTROL);
-	}
-	if (LINUX_KERNEL_MMR (2, 6, 24))
-		show_capability (caps, CAP_SETFCAP);
-	if (LINUX_KERNEL_MMR (2, 6, 25)) {
-		show_capability (caps, CAP_MAC_OVERRIDE);
-		show_capability (caps, CAP_MAC_ADMIN);
-	}
+	return ! errno && end == field->ptr + field->len;
+}
+
+/**
+ * get_capsets_linux:
+ *
+ * @pid: process to query,
+ * @sets: [output] capability sets of @pid.
+ *
+ * Determine all capability sets of @pid using a single capget(2)
+ * call and a single read of /proc/<pid>/status (which is also
+ * used for the effective, permitted and inheritable sets if
+ * capget(2) fails). libcap is not required.
+ *
+ * Returns: true if at least the effective, permitted and inheritable
+ * sets were determined, else false.
+ **/
+static bool
+get_capsets_linux (pid_t pid, struct procenv_capsets *sets)
+{
+	struct procenv_kv_table  table;
+	struct procenv_field     values[5];
+	char                     buffer[PROCENV_PROC_FILE_BUFFER];
+	char                     path[PATH_MAX];
+	bool                     have_sets = false;
 
-#ifdef CAP_SYSLOG
-	if (LINUX_KERNEL_MMR (2, 6, 37))
-		show_capability (caps, CAP_SYSLOG);
-#endif /* CAP_SYSLOG */
+	assert (sets);
 
-#ifdef CAP_WAKE_ALARM
-	if (LINUX_KERNEL_MM (3, 0))
-		show_capability (caps, CAP_WAKE_ALARM);
-#endif /* CAP_WAKE_ALARM */
+	memset (sets, '\0', sizeof (*sets));
 
-#ifdef CAP_BLOCK_SUSPEND
-	if (LINUX_KERNEL_MM (3, 5))
-		show_capability (caps, CAP_BLOCK_SUSPEND);
-#endif /* CAP_BLOCK_SUSPEND */
+	sprintf (path, "/proc/%d/status", (int)pid);
 
-#ifdef CAP_AUDIT_READ
-	if (LINUX_KERNEL_MM (3, 16)) {
-		show_capability (caps, CAP_AUDIT_READ);
-	}
-#endif /* CAP_AUDIT_READ */
+	if (read_file (path, buffer, sizeof (buffer)) >= 0) {
+		kv_table_init (&table);
+		(void)kv_table_add (&table, "CapEff");
+		(void)kv_table_add (&table, "CapPrm");
+		(void)kv_table_add (&table, "CapInh");
+		(void)kv_table_add (&table, "CapBnd");
+		(void)kv_table_add (&table, "CapAmb");
+		kv_table_build (&table);
 
-#ifdef CAP_PERFMON
-	if (LINUX_KERNEL_MM (5, 8)) {
-		show_capability (caps, CAP_PERFMON);
-	}
-#endif /* CAP_PERFMON */
+		(void)kv_parse (&table, buffer, ':', values);
 
-#ifdef CAP_BPF
-	if (LINUX_KERNEL_MM (5, 8)) {
-		show_capability (caps, CAP_BPF);
+		have_sets = get_capset_field_linux (&values[0], &sets->effective)
+			&& get_capset_field_linux (&values[1], &sets->permitted)
+			&& get_capset_field_linux (&values[2], &sets->inheritable);
+
+		sets->have_bounding = get_capset_field_linux (&values[3], &sets->bounding);
+		sets->have_ambient = get_capset_field_linux (&values[4], &sets->ambient);
 	}
-#endif /* CAP_BPF */
 
-#ifdef CAP_CHECKPOINT_RESTORE
-	if (LINUX_KERNEL_MM (5, 9)) {
-		show_capability (caps, CAP_CHECKPOINT_RESTORE);
+#if defined (_LINUX_CAPABILITY_VERSION_3) && defined (SYS_capget)
+	{
+		struct __user_cap_header_struct  header;
+		struct __user_cap_data_struct    data[_LINUX_CAPABILITY_U32S_3];
+
+		memset (&header, '\0', sizeof (header));
+		memset (data, '\0', sizeof (data));
+
+		header.version = _LINUX_CAPABILITY_VERSION_3;
+		header.pid = pid;
+
+		if (! syscall (SYS_capget, &header, data)) {
+			sets->effective = data[0].effective
+				| ((uint64_t)data[1].effective << 32);
+			sets->permitted = data[0].permitted
+				| ((uint64_t)data[1].permitted << 32);
+			sets->inheritable = data[0].inheritable
+				| ((uint64_t)data[1].inheritable << 32);
+
+			have_sets = true;
+		}
 	}
-#endif /* CAP_CHECKPOINT_RESTORE */
+#endif
+
+	return have_sets;
+}
+
+/**
+ * show_capability_linux:
+ *
+ * @sets: capability sets,
+ * @cap: capability number,
+ * @name: name of @cap,
+ * @last_cap: highest capability supported by the running kernel.
+ *
+ * Display details of capability @cap.
+ **/
+static void
+show_capability_linux (const struct procenv_capsets *sets,
+		int cap, const char *name, int last_cap)
+{
+	uint64_t  bit;
+
+	assert (sets);
+	assert (name);
+
+	bit = (uint64_t)1 << cap;
+
+	section_open (name);
+
+	entry ("number", "%d", cap);
+
+	entry ("supported", "%s",
+			last_cap < 0 ? UNKNOWN_STR
+			: cap <= last_cap ? YES_STR
+			: NO_STR);
+
+	entry ("in bounding set", "%s",
+			! sets->have_bounding ? UNKNOWN_STR
+			: sets->bounding & bit ? YES_STR
+			: NO_STR);
+
+	entry ("ambient", "%s",
+			! sets->have_ambient ? NOT_DEFINED_STR
+			: sets->ambient & bit ? YES_STR
+			: NO_STR);
+
+	entry ("effective", "%s", sets->effective & bit ? YES_STR : NO_STR);
+	entry ("inheritable", "%s", sets->inheritable & bit ? YES_STR : NO_STR);
+	entry ("permitted", "%s", sets->permitted & bit ? YES_STR : NO_STR);
 
 	section_close ();
+}
 
-	/* It's possible that procenv is running on a system which has
-	 * more capabilities that the system it was built on (for
-	 * example, it might be running in a chroot with a newer kernel
-	 * than the chroot environment). So display any unknown
-	 * capabilities. We don't have their names, but it's useful to
-	 * see that there are additional capabilities in available in
-	 * the environment.
-	 */
-	section_open ("unknown");
+/**
+ * show_capset_linux:
+ *
+ * @name: name of capability set,
+ * @set: capability set,
+ * @valid: true if @set is known.
+ **/
+static void
+show_capset_linux (const char *name, uint64_t set, bool valid)
+{
+	if (valid)
+		entry (name, "0x%016" PRIx64, set);
+	else
+		entry (name, "%s", UNKNOWN_STR);
+}
 
-#if defined (PR_CAPBSET_READ)
-	for (int i = 1+last_known; ; i++) {
-		int   ret;
-		char *name = NULL;
+static void
+show_capabilities_linux (void)
+{
+	struct procenv_capsets  sets;
+	int                     last_cap;
+	int                     cap;
+	char                    name[32];
 
-		ret = cap_get_bound (i);
-		if (ret < 0)
-			break;
+	last_cap = get_cap_last_cap_linux ();
 
-		/* Found an "unknown" */
+	if (last_cap < 0)
+		entry ("count", "%s", UNKNOWN_STR);
+	else
+		entry ("count", "%d", last_cap + 1);
 
-		appendf (&name, "CAP_LAST_CAP+%d", i);
+	if (! get_capsets_linux (getpid (), &sets))
+		goto keep;
 
-		_show_capability (caps, i, name);
+	section_open ("sets");
 
-		free (name);
-	}
-#endif
+	show_capset_linux ("effective", sets.effective, true);
+	show_capset_linux ("permitted", sets.permitted, true);
+	show_capset_linux ("inheritable", sets.inheritable, true);
+	show_capset_linux ("bounding", sets.bounding, sets.have_bounding);
+	show_capset_linux ("ambient", sets.ambient, sets.have_ambient);
+
+	section_close ();
+
+	section_open ("known");
+
+	for (cap = 0; cap < PROCENV_CAPABILITY_NAMES; cap++)
+		show_capability_linux (&sets, cap, capability_names_linux[cap], last_cap);
 
-	cap_free (caps);
+	section_close ();
+
+	/* It's possible that procenv is running on a kernel which has
+	 * more capabilities than procenv knows about. We don't have
+	 * their names, but it's useful to see that there are additional
+	 * capabilities available in the environment.
+	 */
+	section_open ("unknown");
+
+	for (cap = PROCENV_CAPABILITY_NAMES; cap <= last_cap; cap++) {
+		sprintf (name, "CAP_%d", cap);
+		show_capability_linux (&sets, cap, name, last_cap);
+	}
 
 	section_close ();
 
+keep:
 #ifdef PR_GET_KEEPCAPS
 	if (LINUX_KERNEL_MMR (2, 2, 18)) {
 		int   ret;
@@ -408,7 +567,6 @@ show_capabilities_linux (void)
 	}
 #endif
 
-
 #if defined (PR_GET_SECUREBITS) && defined (HAVE_LINUX_SECUREBITS_H)
 	if (LINUX_KERNEL_MMR (2, 6, 26)) {
 		int ret;
@@ -438,11 +596,6 @@ show_capabilities_linux (void)
 		}
 	}
 #endif
-
-out:
-    /* compiler appeasement */
-    return;
-#endif
 }
 
 static void
@@ -454,7 +607,7 @@ show_cgroups_linux (void)
 	char          buffer[PROCENV_BUFFER];
 	size_t        len;
 
-	f = fopen (file, "r");
+	f = fopen_tracked (file, "r");
 
 	if (! f)
 		goto out;
@@ -473,6 +626,8 @@ show_cgroups_linux (void)
 		if (! buf)
 			die ("failed to allocate storage");
 
+		track_memory (buf, free);
+
 		hierarchy = strsep (&b, delim);
 		if (! hierarchy)
 			goto next;
@@ -502,10 +657,10 @@ show_cgroups_linux (void)
 		container_close ();
 
 next:
-		free (buf);
+		free_tracked (buf);
 	}
 
-	fclose (f);
+	fclose_tracked (f);
 
 out:
 
@@ -524,7 +679,7 @@ show_fds_linux (void)
 	char            link[MAXPATHLEN];
 	ssize_t         len;
 
-	dir = opendir (prefix_path);
+	dir = opendir_tracked (prefix_path);
 	if (! dir)
 		return;
 
@@ -611,7 +766,13 @@ show_fds_linux (void)
 		object_close (false);
 	}
 
-	closedir (dir);
+	closedir_tracked (dir);
+}
+
+static void
+release_pool (void *pool)
+{
+	pr_list_pool_free (pool);
 }
 
 static void
@@ -629,17 +790,21 @@ show_namespaces_linux (void)
 	char            link[MAXPATHLEN];
 	ssize_t         len;
 	PRList         *list = NULL;
+	PRListPool     *pool = NULL;
 
-	dir = opendir (prefix_path);
+	dir = opendir_tracked (prefix_path);
 	if (! dir)
 		goto end;
 
-	list = pr_list_new (NULL);
+	pool = pr_list_pool_new ();
+	assert (pool);
+
+	track_memory (pool, release_pool);
+
+	list = pr_list_pool_new_entry (pool, NULL);
 	assert (list);
 
 	while ((ent=readdir (dir)) != NULL) {
-		PRList *entry;
-
 		if (! strcmp (ent->d_name, ".") || ! strcmp (ent->d_name, ".."))
 			continue;
 
@@ -656,41 +821,35 @@ show_namespaces_linux (void)
 		memset (path, '\0', sizeof (path));
 		sprintf (path, "%s %s", ent->d_name, link);
 
-		entry = pr_list_new (strdup (path));
-		assert (entry);
-
-		assert (pr_list_prepend_str_sorted (list, entry));
+		if (! pr_list_pool_prepend_str (pool, list, path))
+			die ("failed to allocate namespace entry");
 	}
 
-	closedir (dir);
+	closedir_tracked (dir);
 
-	PR_LIST_FOREACH_SAFE (list, iter) {
+	pr_list_sort_str (list);
+
+	PR_LIST_FOREACH (list, iter) {
 		char *tmp;
 		char *name;
 		char *value;
 
-		pr_list_remove (iter);
-
 		tmp = iter->data;
 
 		name = strsep (&tmp, " ");
 		if (! name)
-			goto give_up;
+			continue;
 
 		value = tmp;
 		if (! value)
-			goto give_up;
+			continue;
 
 		object_open (false);
 		entry (name, "%s", value);
 		object_close (false);
-
-give_up:
-		free ((char *)iter->data);
-		free(iter);
 	}
 
-	free_if_set (list);
+	free_tracked (pool);
 
 end:
     /* compiler appeasement */
@@ -715,7 +874,7 @@ show_oom_linux (void)
 		if (ret < 0)
 			continue;
 
-		f = fopen (path, "r");
+		f = fopen_tracked (path, "r");
 		if (! f)
 			continue;
 
@@ -727,7 +886,7 @@ show_oom_linux (void)
 			entry (*file, "%s", buffer);
 		}
 
-		fclose (f);
+		fclose_tracked (f);
 	}
 
 	if (! seen)
@@ -740,47 +899,21 @@ show_oom_linux (void)
 static int
 procenv_getcpu (void)
 {
-	int          cpu = -1;
-	FILE        *f;
-	char       **fields;
-	const char  *field;
-	char         buffer[PROCENV_BUFFER];
-	size_t       len;
-	size_t       count;
-
-	f = fopen ("/proc/self/stat", "r");
-	if (! f)
-		goto out;
-
-	if (! fgets (buffer, sizeof (buffer), f))
-		goto out;
-
-	fclose (f);
-
-	len = strlen (buffer);
-	buffer[len-1] = '\0';
+	struct procenv_field  fields[PROCENV_STAT_FIELD_PROCESSOR];
+	char                  buffer[PROCENV_BUFFER];
+	unsigned long         cpu;
 
-	count = split_fields (buffer, ' ', true, &fields);
-
-	if (! count)
+	if (read_file ("/proc/self/stat", buffer, sizeof (buffer)) < 0)
 		return -1;
 
-	if (count != 42)
-		goto cleanup;
-
-	field = fields[41];
-	assert (field);
-
-	cpu = atoi (field);
-
-cleanup:
+	if (split_proc_stat (buffer, fields, PROCENV_STAT_FIELD_PROCESSOR)
+			< PROCENV_STAT_FIELD_PROCESSOR)
+		return -1;
 
-	for (len = 0; len < count; len++)
-		free (fields[len]);
-	free (fields);
+	if (! field_to_ulong (&fields[PROCENV_STAT_FIELD_PROCESSOR-1], &cpu))
+		return -1;
 
-out:
-	return cpu;
+	return (int)cpu;
 }
 
 #endif
@@ -1322,15 +1455,22 @@ show_prctl_linux (void)
 static void
 handle_proc_branch_linux (void)
 {
-	char    buffer[PROCENV_BUFFER];
-	char    path[PATH_MAX];
-	char    name[16];
-	char    pid[16];
-	char    ppid[16];
-	size_t  len;
-	char   *p;
-	FILE   *f;
-	char   *str = NULL;
+	struct procenv_kv_table  table;
+	struct procenv_field     values[2];
+	char                     buffer[PROCENV_PROC_FILE_BUFFER];
+	char                     path[PATH_MAX];
+	char                     name[16];
+	char                     pid[16];
+	char                     ppid[16];
+	size_t                   name_key;
+	size_t                   ppid_key;
+	size_t                   len;
+	char                    *str = NULL;
+
+	kv_table_init (&table);
+	name_key = kv_table_add (&table, "Name");
+	ppid_key = kv_table_add (&table, "PPid");
+	kv_table_build (&table);
 
 	sprintf (pid, "%d", (int)getpid ());
 
@@ -1338,31 +1478,23 @@ handle_proc_branch_linux (void)
 	while (true) {
 		sprintf (path, "/proc/%s/status", pid);
 
-		f = fopen (path, "r");
-		if (! f) {
+		if (read_file (path, buffer, sizeof (buffer)) < 0
+				|| kv_parse (&table, buffer, ':', values) != table.count) {
 			appendf (&str, "%s", UNKNOWN_STR);
 			goto out;
 		}
 
-		while (fgets (buffer, sizeof (buffer), f)) {
-			len = strlen (buffer);
-			buffer[len-1] = '\0';
-
-			if ((p=strstr (buffer, "Name:")) == buffer) {
-				p += 1+strlen ("Name:"); /* jump over tab char */
-				sprintf (name, "%.*s", PROCENV_TASK_COMM_NAME_LEN, p);
-			}
+		len = values[name_key].len;
+		if (len > PROCENV_TASK_COMM_NAME_LEN)
+			len = PROCENV_TASK_COMM_NAME_LEN;
 
-			if ((p=strstr (buffer, "PPid:")) == buffer) {
-				p += 1+strlen ("PPid:"); /* jump over tab char */
-				sprintf (ppid, "%.*s", PROCENV_TASK_COMM_NAME_LEN, p);
+		sprintf (name, "%.*s", (int)len, values[name_key].ptr);
 
-				/* got all we need now */
-				break;
-			}
-		}
+		len = values[ppid_key].len;
+		if (len > sizeof (ppid) - 1)
+			len = sizeof (ppid) - 1;
 
-		fclose (f);
+		sprintf (ppid, "%.*s", (int)len, values[ppid_key].ptr);
 
 		/* ultimate parent == PID 1 == '/sbin/init' */
 		if (! strcmp (pid, "1")) {
@@ -1814,6 +1946,14 @@ get_numa_policy (int policy)
 
 	return NULL;
 }
+
+#if LIBNUMA_API_VERSION == 2
+static void
+release_nodemask (void *mask)
+{
+	numa_free_nodemask (mask);
+}
+#endif
 #endif /* HAVE_NUMA_H */
 
 static void
@@ -1883,6 +2023,8 @@ handle_numa_memory_linux (void)
 	if (! allowed)
 		die ("failed to query NUMA allowed list");
 
+	track_memory (allowed, release_nodemask);
+
 	allowed_size = allowed->size;
 
 #else
@@ -1935,7 +2077,7 @@ handle_numa_memory_linux (void)
 	entry ("allowed list", "%s", allowed_list);
 
 #if LIBNUMA_API_VERSION == 2
-	numa_free_nodemask (allowed);
+	free_tracked (allowed);
 #endif
 
 	free (allowed_list);
@@ -1945,307 +2087,4162 @@ out:
 	footer ();
 }
 
+#define PROCENV_THP_PATH          "/sys/kernel/mm/transparent_hugepage"
+#define PROCENV_HUGETLB_PATH      "/sys/kernel/mm/hugepages"
+
+/* Maximum number of distinct huge page sizes considered */
+#define PROCENV_MAX_HUGEPAGE_SIZES 64
+
 /**
- * linux_kernel_version:
+ * read_sysfs_value:
  *
- * @major: major kernel version number,
- * @minor: minor kernel version number,
- * @revision: kernel revision version,
+ * @path: full path to file,
+ * @buffer: buffer to write value to,
+ * @len: size of @buffer.
  *
- * @minor and @revision may be -1 to denote that those version
- * elements are not important to the caller. Once a parameter
- * has been specified as -1, subsequent parameters are ignored
- * (treated as -1 too).
+ * Read the first line of the specified single-value file,
+ * removing any trailing whitespace (including the newline).
  *
- * Returns: true if running Linux kernel is at least at version
- * specified by (@major, @minor, @revision), else false.
+ * Returns: true on success, else false.
  **/
 static bool
-linux_kernel_version (int major, int minor, int revision)
+read_sysfs_value (const char *path, char *buffer, size_t len)
 {
-	int  actual_version    = 0x000000;
-	int  requested_version = 0x000000;
-	int  actual_major      = -1;
-	int  actual_minor      = -1;
-	int  actual_revision   = -1;
-	int  ret;
-
-	assert (uts.release);
-	assert (sizeof (int) >= 4);
+	FILE   *f;
+	size_t  bytes;
 
-	/* We need something to work with */
-	assert (major > 0);
+	assert (path);
+	assert (buffer);
+	assert (len);
 
-	ret = sscanf (uts.release, "%d.%d.%d",
-			&actual_major, &actual_minor,
-			&actual_revision);
+	f = fopen (path, "r");
+	if (! f)
+		return false;
 
-	/* We need something to compare against */
-	assert (ret && actual_major != -1);
+	if (! fgets (buffer, (int)len, f)) {
+		fclose (f);
+		return false;
+	}
 
-	requested_version |= (0xFF0000 & (major << 16));
+	fclose (f);
 
-	if (minor != -1) {
-		requested_version |= (0x00FF00 & (minor << 8));
+	/* Some files such as available_clocksource have a trailing space */
+	bytes = strlen (buffer);
+	while (bytes && isspace ((unsigned char)buffer[bytes-1]))
+		buffer[--bytes] = '\0';
 
-		if (revision != -1)
-			requested_version |= (0x0000FF & revision);
-	}
+	return true;
+}
 
-	if (actual_revision != -1) {
-		actual_version |= (0x0000FF & actual_revision);
-	}
+/**
+ * get_sysfs_choice:
+ *
+ * @buffer: value of a sysfs "choice" file such as
+ * "always [madvise] never".
+ *
+ * Returns: the currently selected choice (modifying @buffer), or
+ * @buffer unchanged if no choice is bracketed.
+ **/
+static char *
+get_sysfs_choice (char *buffer)
+{
+	char *start;
+	char *end;
 
-	if (actual_minor != -1)
-		actual_version |= (0x00FF00 & (actual_minor << 8));
+	assert (buffer);
 
-	if (actual_major != -1)
-		actual_version |= (0xFF0000 & (actual_major << 16));
+	start = strchr (buffer, '[');
+	if (! start)
+		return buffer;
 
+	end = strchr (++start, ']');
+	if (! end)
+		return buffer;
 
-	if (actual_version >= requested_version)
-		return true;
+	*end = '\0';
 
-	return false;
+	return start;
 }
 
-#if defined (HAVE_SYS_CAPABILITY_H)
-static int
-get_capability_by_flag_type (cap_t cap_p, cap_flag_t type, cap_value_t cap)
+/**
+ * show_sysfs_values:
+ *
+ * @dir: directory,
+ * @files: NULL-terminated array of files in @dir to display,
+ * @choice: if true, display only the selected value.
+ *
+ * Display an entry for each readable file in @files.
+ **/
+static void
+show_sysfs_values (const char *dir, const char **files, bool choice)
 {
-    int               ret;
-    cap_flag_value_t  result;
+	char          path[PATH_MAX];
+	char          buffer[PROCENV_BUFFER];
+	const char  **file;
 
-    assert (cap_p);
+	assert (dir);
+	assert (files);
 
-    ret = cap_get_flag (cap_p, cap, type, &result);
+	for (file = files; *file; file++) {
+		sprintf (path, "%s/%s", dir, *file);
 
-    return ret < 0 ? ret : result;
+		if (! read_sysfs_value (path, buffer, sizeof (buffer)))
+			continue;
+
+		entry (*file, "%s", choice ? get_sysfs_choice (buffer) : buffer);
+	}
 }
 
 static int
-get_ambient_capability (cap_value_t cap)
+ulong_compar (const void *a, const void *b)
 {
-	if (!LINUX_KERNEL_MMR (4, 3, 0)) {
-		return false;
-	}
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
 
-	return prctl (PR_CAP_AMBIENT, PR_CAP_AMBIENT_IS_SET, cap) == 1;
+	return (x > y) - (x < y);
 }
 
-#endif /* HAVE_SYS_CAPABILITY_H */
-
-#if defined (HAVE_SYS_CAPABILITY_H)
-#ifdef PROCENV_NEED_LOCAL_CAP_GET_BOUND
-
-static int
-cap_get_bound (cap_value_t cap)
+/**
+ * get_hugepage_sizes:
+ *
+ * @dir: directory containing "hugepages-<size>kB" sub-directories,
+ * @sizes: array to fill with sizes (in kB),
+ * @max: number of elements in @sizes.
+ *
+ * Returns: number of sizes found, sorted in ascending order.
+ **/
+static size_t
+get_hugepage_sizes (const char *dir, unsigned long *sizes, size_t max)
 {
-#if defined (PR_CAPBSET_READ)
-	return prctl (PR_CAPBSET_READ, cap);
-#else
-	return -1;
-#endif
-}
+	DIR            *d;
+	struct dirent  *ent;
+	size_t          count = 0;
+	unsigned long   size;
 
-#endif /* PROCENV_NEED_LOCAL_CAP_GET_BOUND */
-#endif /* HAVE_SYS_CAPABILITY_H */
+	d = opendir (dir);
+	if (! d)
+		return 0;
 
-static const char *
-get_scheduler_name (int sched)
-{
-	struct procenv_map *p;
+	while ((ent = readdir (d)) != NULL && count < max) {
+		if (sscanf (ent->d_name, "hugepages-%lukB", &size) != 1)
+			continue;
 
-	for (p = scheduler_map; p && p->name; p++) {
-		if (p->num == sched)
-			return p->name;
+		sizes[count++] = size;
 	}
 
-	return NULL;
+	closedir (d);
+
+	qsort (sizes, count, sizeof (unsigned long), ulong_compar);
+
+	return count;
 }
 
 static void
-get_tty_locked_status_linux (struct termios *lock_status)
+show_thp_linux (void)
 {
-	assert (lock_status);
-	assert (user.tty_fd != -1);
+	char            path[PATH_MAX];
+	char            name[32];
+	unsigned long   sizes[PROCENV_MAX_HUGEPAGE_SIZES];
+	size_t          count;
+	size_t          i;
+	int             rc;
+
+	const char *choices[] = { "defrag", "enabled", "shmem_enabled", NULL };
+	const char *values[] = { "hpage_pmd_size", "use_zero_page", NULL };
+	const char *khugepaged_values[] = {
+		"alloc_sleep_millisecs",
+		"full_scans",
+		"max_ptes_none",
+		"max_ptes_shared",
+		"max_ptes_swap",
+		"pages_collapsed",
+		"pages_to_scan",
+		"scan_sleep_millisecs",
+		NULL
+	};
+	const char *khugepaged_choices[] = { "defrag", NULL };
+	const char *size_choices[] = { "enabled", "shmem_enabled", NULL };
+
+	section_open ("transparent");
 
-	if (ioctl (user.tty_fd, TIOCGLCKTRMIOS, lock_status) < 0) {
-		/* Set to unlocked */
-		memset (lock_status, '\0', sizeof (struct termios));
+#ifdef PR_GET_THP_DISABLE
+	rc = prctl (PR_GET_THP_DISABLE, 0, 0, 0, 0);
+	entry ("disabled for process", "%s",
+			rc < 0 ? UNKNOWN_STR : rc ? YES_STR : NO_STR);
+#else
+	(void)rc;
+	entry ("disabled for process", "%s", UNKNOWN_STR);
+#endif
+
+	show_sysfs_values (PROCENV_THP_PATH, choices, true);
+	show_sysfs_values (PROCENV_THP_PATH, values, false);
+
+	section_open ("khugepaged");
+
+	sprintf (path, "%s/%s", PROCENV_THP_PATH, "khugepaged");
+	show_sysfs_values (path, khugepaged_choices, true);
+	show_sysfs_values (path, khugepaged_values, false);
+
+	section_close ();
+
+	/* Per-size ("multi-size THP") settings (Linux 6.8+) */
+	section_open ("sizes");
+
+	count = get_hugepage_sizes (PROCENV_THP_PATH, sizes,
+			PROCENV_MAX_HUGEPAGE_SIZES);
+
+	for (i = 0; i < count; i++) {
+		sprintf (name, "%lukB", sizes[i]);
+		sprintf (path, "%s/hugepages-%lukB", PROCENV_THP_PATH, sizes[i]);
+
+		section_open (name);
+		show_sysfs_values (path, size_choices, true);
+		section_close ();
 	}
+
+	section_close ();
+
+	section_close ();
 }
 
 static void
-handle_scheduler_type_linux (void)
+show_hugetlb_linux (void)
 {
-	int sched;
+	struct procenv_kv_table  table;
+	struct procenv_field     value;
+	char                     path[PATH_MAX];
+	char                     name[32];
+	char                     buffer[PROCENV_PROC_FILE_BUFFER];
+	unsigned long            sizes[PROCENV_MAX_HUGEPAGE_SIZES];
+	unsigned long            default_size = 0;
+	size_t                   count;
+	size_t                   i;
+
+	const char *vm_values[] = {
+		"nr_hugepages",
+		"nr_hugepages_mempolicy",
+		"nr_overcommit_hugepages",
+		NULL
+	};
+	const char *size_values[] = {
+		"free_hugepages",
+		"nr_hugepages",
+		"nr_overcommit_hugepages",
+		"resv_hugepages",
+		"surplus_hugepages",
+		NULL
+	};
+
+	section_open ("hugetlb");
+
+	kv_table_init (&table);
+	(void)kv_table_add (&table, "Hugepagesize");
+	kv_table_build (&table);
+
+	if (read_file ("/proc/meminfo", buffer, sizeof (buffer)) >= 0
+			&& kv_parse (&table, buffer, ':', &value)
+			&& ! field_to_ulong (&value, &default_size))
+		default_size = 0;
+
+	if (default_size)
+		entry ("default size", "%lukB", default_size);
+	else
+		entry ("default size", "%s", UNKNOWN_STR);
 
-	sched = sched_getscheduler (0);
+	show_sysfs_values ("/proc/sys/vm", vm_values, false);
 
-	entry ("type", "%s",
-			sched < 0 ? UNKNOWN_STR :
-			get_scheduler_name (sched));
+	section_open ("sizes");
+
+	count = get_hugepage_sizes (PROCENV_HUGETLB_PATH, sizes,
+			PROCENV_MAX_HUGEPAGE_SIZES);
+
+	for (i = 0; i < count; i++) {
+		sprintf (name, "%lukB", sizes[i]);
+		sprintf (path, "%s/hugepages-%lukB", PROCENV_HUGETLB_PATH, sizes[i]);
+
+		section_open (name);
+		show_sysfs_values (path, size_values, false);
+		section_close ();
+	}
+
+	section_close ();
+
+	container_open ("mounts");
+	show_mounts_generic_linux (SHOW_HUGETLBFS);
+	container_close ();
+
+	section_close ();
 }
 
+/**
+ * show_hugepages_linux:
+ *
+ * Display transparent huge page and hugetlb(fs) configuration.
+ **/
 static void
-show_extended_if_flags_linux (const char *interface, unsigned short *flags)
+show_hugepages_linux (void)
 {
-	int                        sock;
-	struct ifreq               ifr;
-	const struct procenv_map  *p;
+	show_hugetlb_linux ();
+	show_thp_linux ();
+}
 
-	assert (interface);
-	assert (flags);
+/* Fields of /proc/self/smaps_rollup to display (values in kB) */
+static struct {
+	const char *key;
+	const char *name;
+} smaps_rollup_fields_linux[] = {
+	{ "Rss"           , "rss" },
+	{ "Pss"           , "pss" },
+	{ "Shared_Clean"  , "shared clean" },
+	{ "Shared_Dirty"  , "shared dirty" },
+	{ "Private_Clean" , "private clean" },
+	{ "Private_Dirty" , "private dirty" },
+	{ "Anonymous"     , "anonymous" },
+	{ "AnonHugePages" , "anonymous huge pages" },
+	{ "Swap"          , "swap" },
+	{ "SwapPss"       , "swap pss" },
+	{ "Locked"        , "locked" },
+
+	{ NULL, NULL }
+};
 
-	/* We need to create a socket to query an interfaces mac
-	 * address. Don't ask me why...
-	 */
-	sock = socket (AF_INET, SOCK_DGRAM, IPPROTO_IP);
+/* Types of memory mapping summarised from /proc/self/maps */
+typedef enum {
+	VMA_TYPE_ANONYMOUS,
+	VMA_TYPE_FILE,
+	VMA_TYPE_HEAP,
+	VMA_TYPE_STACK,
+	VMA_TYPE_SPECIAL,
+	VMA_TYPE_OTHER,
+
+	VMA_TYPE_COUNT
+} VMAType;
+
+static const char *vma_type_names[VMA_TYPE_COUNT] = {
+	"anonymous",
+	"file",
+	"heap",
+	"stack",
+	"special",
+	"other",
+};
 
-	if (sock < 0)
-		return;
+static VMAType
+get_vma_type (const char *path)
+{
+	assert (path);
 
-	memset (&ifr, 0, sizeof (struct ifreq));
-	strncpy (ifr.ifr_name, interface, IFNAMSIZ-1);
+	if (! *path || *path == '\n')
+		return VMA_TYPE_ANONYMOUS;
 
-	if (ioctl (sock, SIOCGIFPFLAGS, &ifr) < 0)
+	if (*path == '/')
+		return VMA_TYPE_FILE;
+
+	if (! strncmp (path, "[heap]", 6))
+		return VMA_TYPE_HEAP;
+
+	/* older kernels also show "[stack:<tid>]" */
+	if (! strncmp (path, "[stack", 6))
+		return VMA_TYPE_STACK;
+
+	/* [vdso], [vvar], [vsyscall], [uprobes], etc */
+	if (*path == '[')
+		return VMA_TYPE_SPECIAL;
+
+	return VMA_TYPE_OTHER;
+}
+
+/**
+ * show_smaps_rollup_linux:
+ *
+ * Display the memory usage totals for the process from
+ * /proc/self/smaps_rollup.
+ **/
+static void
+show_smaps_rollup_linux (void)
+{
+	struct procenv_kv_table  table;
+	struct procenv_field     values[PROCENV_KV_MAX_KEYS];
+	char                     buffer[PROCENV_PROC_FILE_BUFFER];
+	unsigned long            kb;
+	size_t                   i;
+
+	section_open ("usage");
+
+	/* Linux 4.14+ */
+	if (read_file ("/proc/self/smaps_rollup", buffer, sizeof (buffer)) < 0)
 		goto out;
 
-	*flags = ifr.ifr_flags;
+	kv_table_init (&table);
 
-	for (p = if_extended_flag_map_linux; p && p->name; p++) {
-		if (*flags & p->num) {
-			object_open (false);
-			entry (p->name, "0x%x", p->num);
-			object_close (false);
-		}
+	for (i = 0; smaps_rollup_fields_linux[i].key; i++)
+		(void)kv_table_add (&table, smaps_rollup_fields_linux[i].key);
+
+	kv_table_build (&table);
+
+	(void)kv_parse (&table, buffer, ':', values);
+
+	for (i = 0; i < table.count; i++) {
+		if (field_to_ulong (&values[i], &kb))
+			mk_mem_section (smaps_rollup_fields_linux[i].name, kb * 1024);
 	}
+
 out:
-	close (sock);
+	section_close ();
 }
 
-static PROCENV_CPU_SET_TYPE *
-get_cpuset_linux (void)
+/**
+ * show_mappings_linux:
+ *
+ * Summarise the memory mappings (VMAs) of the process by type using
+ * a single pass over /proc/self/maps and compare the total against
+ * the maximum number of mappings the kernel allows a process.
+ **/
+static void
+show_mappings_linux (void)
 {
-	int ret = 0;
-
-#if ! defined (CPU_ALLOC)
-	/* RHEL 5 */
-	static PROCENV_CPU_SET_TYPE  cpu_set_real;
-#else
-	long   max;
-#endif
+	FILE           *f;
+	char            buffer[PROCENV_BUFFER];
+	unsigned long   start;
+	unsigned long   end;
+	char            perms[5];
+	int             offset;
+	bool            line_start = true;
+	size_t          len;
+	unsigned long   total = 0;
+	unsigned long   virtual_size = 0;
+	unsigned long   writable = 0;
+	unsigned long   executable = 0;
+	unsigned long   shared = 0;
+	unsigned long   counts[VMA_TYPE_COUNT] = { 0 };
+	long            max = -1;
+	int             i;
+
+	section_open ("mappings");
+
+	f = fopen ("/proc/self/maps", "r");
+	if (! f)
+		goto out;
 
-	size_t size;
-	PROCENV_CPU_SET_TYPE *cs = NULL;
+	while (fgets (buffer, sizeof (buffer), f)) {
+		len = strlen (buffer);
 
-#if defined (CPU_ALLOC)
+		/* Only the start of each line is of interest, so skip
+		 * the remainder of any overly-long (path) line.
+		 */
+		if (! line_start) {
+			line_start = len && buffer[len-1] == '\n';
+			continue;
+		}
 
-	max = get_sysconf (_SC_NPROCESSORS_ONLN);
-	if (max < 0)
-		return NULL;
+		line_start = len && buffer[len-1] == '\n';
 
-	cs = CPU_ALLOC (max);
-	if (! cs)
-		return NULL;
+		offset = 0;
+		if (sscanf (buffer, "%lx-%lx %4s %*s %*s %*s %n",
+					&start, &end, perms, &offset) < 3 || ! offset)
+			continue;
 
-	size = CPU_ALLOC_SIZE (max);
-	CPU_ZERO_S (size, cs);
+		total++;
+		virtual_size += end - start;
 
-#else /* ! CPU_ALLOC */
+		if (perms[1] == 'w')
+			writable++;
+		if (perms[2] == 'x')
+			executable++;
+		if (perms[3] == 's')
+			shared++;
 
-	size = sizeof (PROCENV_CPU_SET_TYPE);
+		counts[get_vma_type (buffer + offset)]++;
+	}
 
-	CPU_ZERO (&cpu_set_real);
-	cs = &cpu_set_real;
+	fclose (f);
 
-#endif /* CPU_ALLOC */
+	f = fopen ("/proc/sys/vm/max_map_count", "r");
+	if (f) {
+		if (fscanf (f, "%ld", &max) != 1)
+			max = -1;
+		fclose (f);
+	}
 
-	/* We could use sched_getaffinity(2) rather than
-	 * sched_getaffinity() on Linux (2.5.8+) but
-	 * pthread_getaffinity_np() provides the same information...
-	 * Except it is missing on kFreeBSD systems (!) so we have to
-	 * use sched_getaffinity() there. :(
-	 */
-#if ! defined (CPU_ALLOC)
-	ret = sched_getaffinity (0, size, cs);
-#else
+	entry ("count", "%lu", total);
 
-	/* On a hyperthreaded system, "size" as above may not actually
-	 * be big enough, and we get EINVAL (hwloc has a similar
-	 * workaround).
-	 */
-	{
-		int mult = 0;
-		while ((ret = pthread_getaffinity_np (pthread_self (), size, cs))
-				== EINVAL) {
-			CPU_FREE (cs);
-			/* Bail out at an arbitrary value.  */
-			if (mult > 128) break;
-			mult += 2;
-			cs = CPU_ALLOC (mult * max);
-			size = CPU_ALLOC_SIZE (mult * max);
-			CPU_ZERO_S (size, cs);
-		}
+	if (max > 0) {
+		entry ("max", "%ld", max);
+		entry ("used", "%.2f%%", (100.0 * total) / max);
+	} else {
+		entry ("max", "%s", UNKNOWN_STR);
+		entry ("used", "%s", UNKNOWN_STR);
 	}
-#endif
-	if (ret)
-		goto err;
 
-	return cs;
-err:
-#if defined (CPU_ALLOC)
-	CPU_FREE (cs);
-#endif
-	return NULL;
-}
+	mk_mem_section ("virtual size", virtual_size);
 
-static void
-free_cpuset_linux (PROCENV_CPU_SET_TYPE *cs)
-{
-#if defined (CPU_ALLOC)
-	CPU_FREE (cs);
-#endif
+	section_open ("types");
+
+	for (i = 0; i < VMA_TYPE_COUNT; i++)
+		entry (vma_type_names[i], "%lu", counts[i]);
+
+	section_close ();
+
+	section_open ("permissions");
+
+	entry ("writable", "%lu", writable);
+	entry ("executable", "%lu", executable);
+	entry ("shared", "%lu", shared);
+
+	section_close ();
+
+out:
+	section_close ();
 }
 
+/* Keys of /proc/meminfo used to calculate derived values */
+enum {
+	MEMINFO_MEM_TOTAL,
+	MEMINFO_MEM_AVAILABLE,
+	MEMINFO_BUFFERS,
+	MEMINFO_CACHED,
+	MEMINFO_DIRTY,
+	MEMINFO_WRITEBACK,
+	MEMINFO_SRECLAIMABLE,
+	MEMINFO_SUNRECLAIM,
+	MEMINFO_COMMIT_LIMIT,
+	MEMINFO_COMMITTED_AS,
+
+	MEMINFO_KEY_COUNT
+};
+
+static const char *meminfo_keys_linux[MEMINFO_KEY_COUNT] = {
+	[MEMINFO_MEM_TOTAL]     = "MemTotal",
+	[MEMINFO_MEM_AVAILABLE] = "MemAvailable",
+	[MEMINFO_BUFFERS]       = "Buffers",
+	[MEMINFO_CACHED]        = "Cached",
+	[MEMINFO_DIRTY]         = "Dirty",
+	[MEMINFO_WRITEBACK]     = "Writeback",
+	[MEMINFO_SRECLAIMABLE]  = "SReclaimable",
+	[MEMINFO_SUNRECLAIM]    = "SUnreclaim",
+	[MEMINFO_COMMIT_LIMIT]  = "CommitLimit",
+	[MEMINFO_COMMITTED_AS]  = "Committed_AS",
+};
+
+/* Counters of /proc/vmstat to display */
+enum {
+	VMSTAT_PGFAULT,
+	VMSTAT_PGMAJFAULT,
+	VMSTAT_PGSCAN_KSWAPD,
+	VMSTAT_PGSCAN_DIRECT,
+	VMSTAT_PGSTEAL_KSWAPD,
+	VMSTAT_PGSTEAL_DIRECT,
+	VMSTAT_PSWPIN,
+	VMSTAT_PSWPOUT,
+	VMSTAT_COMPACT_STALL,
+	VMSTAT_COMPACT_FAIL,
+	VMSTAT_COMPACT_SUCCESS,
+	VMSTAT_THP_FAULT_ALLOC,
+	VMSTAT_THP_FAULT_FALLBACK,
+	VMSTAT_OOM_KILL,
+
+	VMSTAT_KEY_COUNT
+};
+
+static const char *vmstat_keys_linux[VMSTAT_KEY_COUNT] = {
+	[VMSTAT_PGFAULT]            = "pgfault",
+	[VMSTAT_PGMAJFAULT]         = "pgmajfault",
+	[VMSTAT_PGSCAN_KSWAPD]      = "pgscan_kswapd",
+	[VMSTAT_PGSCAN_DIRECT]      = "pgscan_direct",
+	[VMSTAT_PGSTEAL_KSWAPD]     = "pgsteal_kswapd",
+	[VMSTAT_PGSTEAL_DIRECT]     = "pgsteal_direct",
+	[VMSTAT_PSWPIN]             = "pswpin",
+	[VMSTAT_PSWPOUT]            = "pswpout",
+	[VMSTAT_COMPACT_STALL]      = "compact_stall",
+	[VMSTAT_COMPACT_FAIL]       = "compact_fail",
+	[VMSTAT_COMPACT_SUCCESS]    = "compact_success",
+	[VMSTAT_THP_FAULT_ALLOC]    = "thp_fault_alloc",
+	[VMSTAT_THP_FAULT_FALLBACK] = "thp_fault_fallback",
+	[VMSTAT_OOM_KILL]           = "oom_kill",
+};
+
+/**
+ * get_proc_values_linux:
+ *
+ * @path: full path to "key value" file,
+ * @separator: character separating keys from values,
+ * @keys: keys to find,
+ * @count: number of elements in @keys,
+ * @values: [output] value of each key in @keys,
+ * @found: [output] true for each key in @keys that was found,
+ * @buffer: buffer to read file into,
+ * @len: size of @buffer.
+ *
+ * Read @path and find the numeric value of each of @keys using a
+ * single read.
+ *
+ * Returns: true on success, else false.
+ **/
 static bool
-cpuset_has_cpu_linux (const PROCENV_CPU_SET_TYPE *cs,
-		PROCENV_CPU_TYPE cpu)
+get_proc_values_linux (const char *path, char separator,
+		const char **keys, size_t count,
+		unsigned long *values, bool *found,
+		char *buffer, size_t len)
 {
-	return CPU_ISSET (cpu, cs);
+	struct procenv_kv_table  table;
+	struct procenv_field     fields[PROCENV_KV_MAX_KEYS];
+	size_t                   i;
+
+	assert (path);
+	assert (keys);
+	assert (count <= PROCENV_KV_MAX_KEYS);
+	assert (values);
+	assert (found);
+	assert (buffer);
+
+	if (read_file (path, buffer, len) < 0)
+		return false;
+
+	kv_table_init (&table);
+
+	for (i = 0; i < count; i++)
+		(void)kv_table_add (&table, keys[i]);
+
+	kv_table_build (&table);
+
+	(void)kv_parse (&table, buffer, separator, fields);
+
+	for (i = 0; i < count; i++)
+		found[i] = field_to_ulong (&fields[i], &values[i]);
+
+	return true;
 }
 
-static bool
-in_vm_linux (void)
+/**
+ * show_meminfo_linux:
+ *
+ * Display every value in /proc/meminfo, followed by values derived
+ * from them.
+ **/
+static void
+show_meminfo_linux (void)
 {
-	bool result = false;
-	const char *cpuinfo = "/proc/cpuinfo";
-	FILE *f = NULL;
-	char buffer[PROCENV_BUFFER];
+	struct procenv_field  fields[3];
+	char                  buffer[PROCENV_PROC_FILE_BUFFER];
+	char                  name[64];
+	unsigned long         kb[MEMINFO_KEY_COUNT];
+	bool                  found[MEMINFO_KEY_COUNT];
+	unsigned long         value;
+	unsigned long         headroom;
+	const char           *line;
+	const char           *next;
+	size_t                len;
+
+	if (! get_proc_values_linux ("/proc/meminfo", ':',
+				meminfo_keys_linux, MEMINFO_KEY_COUNT,
+				kb, found, buffer, sizeof (buffer)))
+		return;
 
-	f = fopen (cpuinfo, "r");
-	if (! f) {
-		return false;
-	}
+	section_open ("meminfo");
 
-	while (fgets (buffer, sizeof (buffer), f)) {
-		if (strstr (buffer, "flags") != buffer) {
+	for (line = buffer; *line; line = next) {
+		next = strchrnul (line, '\n');
+		if (*next)
+			next++;
+
+		/* "key: value [kB]" */
+		if (split_fields (line, ' ', true, fields, 3) < 2)
 			continue;
-		}
 
-		if (strstr (buffer, "hypervisor") != NULL) {
-			result = true;
-		}
+		len = fields[0].len;
+		if (! len || fields[0].ptr[len-1] != ':')
+			continue;
 
-		/* only test the first CPU */
-		goto out;
+		len--;
+		if (len > sizeof (name) - 1)
+			len = sizeof (name) - 1;
+
+		sprintf (name, "%.*s", (int)len, fields[0].ptr);
+
+		if (! field_to_ulong (&fields[1], &value))
+			continue;
+
+		if (fields[2].len == 2 && ! memcmp (fields[2].ptr, "kB", 2))
+			mk_mem_section (name, value * 1024)
+		else
+			entry (name, "%lu", value);
 	}
 
-out:
-	fclose (f);
+	section_close ();
+
+	section_open ("derived");
+
+	if (found[MEMINFO_MEM_AVAILABLE]) {
+		mk_mem_section ("available", kb[MEMINFO_MEM_AVAILABLE] * 1024);
+
+		if (found[MEMINFO_MEM_TOTAL] && kb[MEMINFO_MEM_TOTAL])
+			entry ("available percent", "%.2f",
+					(double)kb[MEMINFO_MEM_AVAILABLE] * 100
+					/ (double)kb[MEMINFO_MEM_TOTAL]);
+		else
+			entry ("available percent", "%s", UNKNOWN_STR);
+	} else {
+		entry ("available", "%s", UNKNOWN_STR);
+		entry ("available percent", "%s", UNKNOWN_STR);
+	}
+
+	if (found[MEMINFO_CACHED] && found[MEMINFO_BUFFERS])
+		mk_mem_section ("page cache",
+				(kb[MEMINFO_CACHED] + kb[MEMINFO_BUFFERS]) * 1024)
+	else
+		entry ("page cache", "%s", UNKNOWN_STR);
+
+	if (found[MEMINFO_DIRTY] && found[MEMINFO_WRITEBACK])
+		mk_mem_section ("dirty and writeback",
+				(kb[MEMINFO_DIRTY] + kb[MEMINFO_WRITEBACK]) * 1024)
+	else
+		entry ("dirty and writeback", "%s", UNKNOWN_STR);
+
+	if (found[MEMINFO_SRECLAIMABLE] && found[MEMINFO_SUNRECLAIM])
+		mk_mem_section ("slab",
+				(kb[MEMINFO_SRECLAIMABLE] + kb[MEMINFO_SUNRECLAIM]) * 1024)
+	else
+		entry ("slab", "%s", UNKNOWN_STR);
+
+	/* How much more memory can be committed before allocations
+	 * fail when vm.overcommit_memory is 2 (zero if the limit has
+	 * already been exceeded).
+	 */
+	if (found[MEMINFO_COMMIT_LIMIT] && found[MEMINFO_COMMITTED_AS]
+			&& kb[MEMINFO_COMMIT_LIMIT]) {
+		headroom = kb[MEMINFO_COMMIT_LIMIT] > kb[MEMINFO_COMMITTED_AS]
+			? kb[MEMINFO_COMMIT_LIMIT] - kb[MEMINFO_COMMITTED_AS]
+			: 0;
+
+		mk_mem_section ("commit headroom", headroom * 1024);
+
+		entry ("commit percent", "%.2f",
+				(double)kb[MEMINFO_COMMITTED_AS] * 100
+				/ (double)kb[MEMINFO_COMMIT_LIMIT]);
+	} else {
+		entry ("commit headroom", "%s", UNKNOWN_STR);
+		entry ("commit percent", "%s", UNKNOWN_STR);
+	}
+
+	section_close ();
+}
+
+/**
+ * show_vmstat_linux:
+ *
+ * Display key reclaim, fault, compaction and OOM counters from
+ * /proc/vmstat. If @rate_window is set, /proc/vmstat is read twice
+ * and the per-second rate of each counter is also displayed.
+ **/
+static void
+show_vmstat_linux (void)
+{
+	char             buffer[PROCENV_PROC_FILE_BUFFER];
+	unsigned long    values[VMSTAT_KEY_COUNT];
+	unsigned long    prev[VMSTAT_KEY_COUNT];
+	bool             found[VMSTAT_KEY_COUNT];
+	bool             prev_found[VMSTAT_KEY_COUNT];
+	struct timespec  start;
+	struct timespec  end;
+	struct timespec  delay;
+	double           elapsed = 0;
+	unsigned long    scanned;
+	unsigned long    stolen;
+	char            *rate_name = NULL;
+	size_t           i;
+
+	memset (prev_found, '\0', sizeof (prev_found));
+
+	if (rate_window) {
+		if (! get_proc_values_linux ("/proc/vmstat", ' ',
+					vmstat_keys_linux, VMSTAT_KEY_COUNT,
+					prev, prev_found, buffer, sizeof (buffer)))
+			return;
+
+		if (clock_gettime (CLOCK_MONOTONIC, &start) < 0)
+			return;
+
+		delay.tv_sec = (time_t)(rate_window / 1000);
+		delay.tv_nsec = (long)((rate_window % 1000) * 1000000);
+
+		while (nanosleep (&delay, &delay) < 0 && errno == EINTR)
+			;
+	}
+
+	if (! get_proc_values_linux ("/proc/vmstat", ' ',
+				vmstat_keys_linux, VMSTAT_KEY_COUNT,
+				values, found, buffer, sizeof (buffer)))
+		return;
+
+	if (rate_window) {
+		if (clock_gettime (CLOCK_MONOTONIC, &end) < 0)
+			return;
+
+		elapsed = (double)(end.tv_sec - start.tv_sec)
+			+ ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+	}
+
+	section_open ("vmstat");
+
+	for (i = 0; i < VMSTAT_KEY_COUNT; i++) {
+		if (found[i])
+			entry (vmstat_keys_linux[i], "%lu", values[i]);
+		else
+			entry (vmstat_keys_linux[i], "%s", UNKNOWN_STR);
+
+		if (! rate_window)
+			continue;
+
+		appendf (&rate_name, "%s per second", vmstat_keys_linux[i]);
+
+		if (! found[i] || ! prev_found[i] || elapsed <= 0
+				|| values[i] < prev[i])
+			entry (rate_name, "%s", UNKNOWN_STR);
+		else
+			entry (rate_name, "%.2f",
+					(double)(values[i] - prev[i]) / elapsed);
+
+		free (rate_name);
+		rate_name = NULL;
+	}
+
+	if (rate_window)
+		entry ("rate window", "%lums", rate_window);
+
+	/* Proportion of pages scanned for reclaim that were reclaimed */
+	if (found[VMSTAT_PGSCAN_KSWAPD] && found[VMSTAT_PGSCAN_DIRECT]
+			&& found[VMSTAT_PGSTEAL_KSWAPD] && found[VMSTAT_PGSTEAL_DIRECT]) {
+		scanned = values[VMSTAT_PGSCAN_KSWAPD] + values[VMSTAT_PGSCAN_DIRECT];
+		stolen = values[VMSTAT_PGSTEAL_KSWAPD] + values[VMSTAT_PGSTEAL_DIRECT];
+
+		if (scanned)
+			entry ("reclaim efficiency percent", "%.2f",
+					(double)stolen * 100 / (double)scanned);
+		else
+			entry ("reclaim efficiency percent", "%s", NA_STR);
+	} else {
+		entry ("reclaim efficiency percent", "%s", UNKNOWN_STR);
+	}
+
+	section_close ();
+}
+
+/**
+ * show_memory_linux:
+ *
+ * Display system memory details.
+ **/
+static void
+show_memory_linux (void)
+{
+	show_memory_generic ();
+	show_meminfo_linux ();
+	show_vmstat_linux ();
+}
+
+static void
+handle_process_memory_linux (void)
+{
+	header ("process");
+
+	show_smaps_rollup_linux ();
+	show_mappings_linux ();
+
+	footer ();
+}
+
+/**
+ * linux_kernel_version:
+ *
+ * @major: major kernel version number,
+ * @minor: minor kernel version number,
+ * @revision: kernel revision version,
+ *
+ * @minor and @revision may be -1 to denote that those version
+ * elements are not important to the caller. Once a parameter
+ * has been specified as -1, subsequent parameters are ignored
+ * (treated as -1 too).
+ *
+ * Returns: true if running Linux kernel is at least at version
+ * specified by (@major, @minor, @revision), else false.
+ **/
+static bool
+linux_kernel_version (int major, int minor, int revision)
+{
+	int  actual_version    = 0x000000;
+	int  requested_version = 0x000000;
+	int  actual_major      = -1;
+	int  actual_minor      = -1;
+	int  actual_revision   = -1;
+	int  ret;
+
+	assert (uts.release);
+	assert (sizeof (int) >= 4);
+
+	/* We need something to work with */
+	assert (major > 0);
+
+	ret = sscanf (uts.release, "%d.%d.%d",
+			&actual_major, &actual_minor,
+			&actual_revision);
+
+	/* We need something to compare against */
+	assert (ret && actual_major != -1);
+
+	requested_version |= (0xFF0000 & (major << 16));
+
+	if (minor != -1) {
+		requested_version |= (0x00FF00 & (minor << 8));
+
+		if (revision != -1)
+			requested_version |= (0x0000FF & revision);
+	}
+
+	if (actual_revision != -1) {
+		actual_version |= (0x0000FF & actual_revision);
+	}
+
+	if (actual_minor != -1)
+		actual_version |= (0x00FF00 & (actual_minor << 8));
+
+	if (actual_major != -1)
+		actual_version |= (0xFF0000 & (actual_major << 16));
+
+
+	if (actual_version >= requested_version)
+		return true;
+
+	return false;
+}
+
+static const char *
+get_scheduler_name (int sched)
+{
+	struct procenv_map *p;
+
+	for (p = scheduler_map; p && p->name; p++) {
+		if (p->num == sched)
+			return p->name;
+	}
+
+	return NULL;
+}
+
+static void
+get_tty_locked_status_linux (struct termios *lock_status)
+{
+	assert (lock_status);
+	assert (user.tty_fd != -1);
+
+	if (ioctl (user.tty_fd, TIOCGLCKTRMIOS, lock_status) < 0) {
+		/* Set to unlocked */
+		memset (lock_status, '\0', sizeof (struct termios));
+	}
+}
+
+#define PROCENV_CLOCKSOURCE_PATH \
+	"/sys/devices/system/clocksource/clocksource0"
+
+/* Sufficient for the "flags" line of /proc/cpuinfo on current CPUs */
+#define PROCENV_CPU_FLAGS_BUFFER  8192
+
+/**
+ * get_cpu_flags_linux:
+ *
+ * Obtain the "flags" line for the first CPU in /proc/cpuinfo. The
+ * file is only read on the first call.
+ *
+ * Returns: flags line, or NULL if unavailable.
+ **/
+static const char *
+get_cpu_flags_linux (void)
+{
+	static char   buffer[PROCENV_CPU_FLAGS_BUFFER];
+	static bool   flags_read = false;
+	static bool   found = false;
+	FILE         *f;
+
+	if (flags_read)
+		return found ? buffer : NULL;
+
+	flags_read = true;
+
+	f = fopen ("/proc/cpuinfo", "r");
+	if (! f)
+		return NULL;
+
+	while (fgets (buffer, (int)sizeof (buffer), f)) {
+		if (strstr (buffer, "flags") == buffer) {
+			/* only consider the first CPU */
+			found = true;
+			break;
+		}
+	}
+
+	fclose (f);
+
+	return found ? buffer : NULL;
+}
+
+/**
+ * cpu_flag_set:
+ *
+ * @flags: "flags" line from /proc/cpuinfo,
+ * @flag: name of flag to look for.
+ *
+ * Returns: true if @flag is present in @flags.
+ **/
+static bool
+cpu_flag_set (const char *flags, const char *flag)
+{
+	const char *p;
+	size_t      len;
+
+	assert (flags);
+	assert (flag);
+
+	len = strlen (flag);
+
+	for (p = strstr (flags, flag); p; p = strstr (p + 1, flag)) {
+		if (p != flags && p[-1] != ' ')
+			continue;
+
+		if (p[len] == ' ' || p[len] == '\n' || p[len] == '\0')
+			return true;
+	}
+
+	return false;
+}
+
+static struct procenv_map adjtimex_state_map_linux[] = {
+	mk_map_entry (TIME_OK),
+	mk_map_entry (TIME_INS),
+	mk_map_entry (TIME_DEL),
+	mk_map_entry (TIME_OOP),
+	mk_map_entry (TIME_WAIT),
+	mk_map_entry (TIME_ERROR),
+
+	{ NULL, 0 }
+};
+
+/**
+ * show_clock_probe_linux:
+ *
+ * Display the kernel clocksource details, the TSC reliability flags
+ * and the clock synchronisation status.
+ **/
+static void
+show_clock_probe_linux (void)
+{
+	char                       buffer[PROCENV_BUFFER];
+	const struct procenv_map  *p;
+	const char                *state_name = UNKNOWN_STR;
+	struct timex               tx;
+	int                        state;
+
+	section_open ("clocksource");
+
+	entry ("current", "%s",
+			read_sysfs_value (PROCENV_CLOCKSOURCE_PATH "/current_clocksource",
+				buffer, sizeof (buffer))
+			? buffer : UNKNOWN_STR);
+
+	entry ("available", "%s",
+			read_sysfs_value (PROCENV_CLOCKSOURCE_PATH "/available_clocksource",
+				buffer, sizeof (buffer))
+			? buffer : UNKNOWN_STR);
+
+#if defined (PROCENV_HAVE_CPUID)
+	{
+		unsigned int   regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT];
+		char           vendor[13];
+		const char    *flags;
+
+		section_open ("tsc");
+
+		/* Whether the TSC is invariant is a CPU feature, so ask
+		 * the CPU directly.
+		 */
+		get_cpuid_leaves (regs, vendor);
+		entry ("invariant tsc", "%s",
+				cpuid_has_feature (regs, "invariant_tsc") ? YES_STR : NO_STR);
+
+		/* The kernel sets these flags itself, sometimes even
+		 * where the TSC is not invariant.
+		 */
+		flags = get_cpu_flags_linux ();
+
+		entry ("constant_tsc", "%s", ! flags ? UNKNOWN_STR
+				: cpu_flag_set (flags, "constant_tsc") ? YES_STR : NO_STR);
+		entry ("nonstop_tsc", "%s", ! flags ? UNKNOWN_STR
+				: cpu_flag_set (flags, "nonstop_tsc") ? YES_STR : NO_STR);
+		entry ("tsc_known_freq", "%s", ! flags ? UNKNOWN_STR
+				: cpu_flag_set (flags, "tsc_known_freq") ? YES_STR : NO_STR);
+		entry ("tsc_reliable", "%s", ! flags ? UNKNOWN_STR
+				: cpu_flag_set (flags, "tsc_reliable") ? YES_STR : NO_STR);
+
+		section_close ();
+	}
+#endif
+
+	section_close ();
+
+	section_open ("synchronisation");
+
+	/* A zero mode is a read-only query */
+	memset (&tx, '\0', sizeof (tx));
+
+	state = adjtimex (&tx);
+	if (state < 0) {
+		entry ("state", "%s", UNKNOWN_STR);
+		goto out;
+	}
+
+	for (p = adjtimex_state_map_linux; p->name; p++) {
+		if (p->num == (unsigned int)state) {
+			state_name = p->name;
+			break;
+		}
+	}
+
+	entry ("state", "%s", state_name);
+	entry ("synchronised", "%s", tx.status & STA_UNSYNC ? NO_STR : YES_STR);
+	entry ("status", "0x%x", tx.status);
+
+	entry ("offset", "%ld %s", (long int)tx.offset,
+			tx.status & STA_NANO ? "ns" : "us");
+
+	/* frequency is in units of 2^-16 ppm */
+	entry ("frequency", "%.3f ppm", (double)tx.freq / 65536.0);
+
+	entry ("maximum error", "%ld us", (long int)tx.maxerror);
+	entry ("estimated error", "%ld us", (long int)tx.esterror);
+	entry ("tick", "%ld us", (long int)tx.tick);
+
+out:
+	section_close ();
+}
+
+static struct procenv_map sched_flag_map_linux[] = {
+	{ "SCHED_FLAG_RESET_ON_FORK", PROCENV_SCHED_FLAG_RESET_ON_FORK },
+	{ "SCHED_FLAG_RECLAIM", PROCENV_SCHED_FLAG_RECLAIM },
+	{ "SCHED_FLAG_DL_OVERRUN", PROCENV_SCHED_FLAG_DL_OVERRUN },
+	{ "SCHED_FLAG_UTIL_CLAMP_MIN", PROCENV_SCHED_FLAG_UTIL_CLAMP_MIN },
+	{ "SCHED_FLAG_UTIL_CLAMP_MAX", PROCENV_SCHED_FLAG_UTIL_CLAMP_MAX },
+
+	{ NULL, 0 }
+};
+
+static int
+procenv_sched_getattr (pid_t tid, struct procenv_sched_attr *attr)
+{
+	assert (attr);
+
+	memset (attr, '\0', sizeof (struct procenv_sched_attr));
+
+#if defined (SYS_sched_getattr)
+	return (int)syscall (SYS_sched_getattr, tid, attr,
+			sizeof (struct procenv_sched_attr), 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/**
+ * show_sched_attr_linux:
+ *
+ * @tid: thread to query (0 for the calling thread).
+ *
+ * Display the full scheduling attributes of the specified thread
+ * as returned by sched_getattr(2).
+ **/
+static void
+show_sched_attr_linux (pid_t tid)
+{
+	struct procenv_sched_attr   attr;
+	const struct procenv_map   *p;
+	const char                 *name;
+
+	section_open ("attributes");
+
+	if (procenv_sched_getattr (tid, &attr) < 0) {
+		entry ("policy", "%s", UNKNOWN_STR);
+		goto out;
+	}
+
+	name = get_scheduler_name ((int)attr.sched_policy);
+
+	entry ("policy", "%s", name ? name : UNKNOWN_STR);
+	entry ("nice", "%d", attr.sched_nice);
+	entry ("priority", "%u", attr.sched_priority);
+
+	entry ("runtime", "%" PRIu64 " ns", attr.sched_runtime);
+	entry ("deadline", "%" PRIu64 " ns", attr.sched_deadline);
+	entry ("period", "%" PRIu64 " ns", attr.sched_period);
+
+	if (attr.size > PROCENV_SCHED_ATTR_SIZE_VER0) {
+		entry ("utilization min", "%u", attr.sched_util_min);
+		entry ("utilization max", "%u", attr.sched_util_max);
+	} else {
+		entry ("utilization min", "%s", NA_STR);
+		entry ("utilization max", "%s", NA_STR);
+	}
+
+	section_open ("flags");
+
+	for (p = sched_flag_map_linux; p->name; p++) {
+		entry (p->name, "%s",
+				attr.sched_flags & p->num ? YES_STR : NO_STR);
+	}
+
+	section_close ();
+
+out:
+	section_close ();
+}
+
+/**
+ * show_autogroup_linux:
+ *
+ * Display the autogroup the process belongs to, which affects
+ * CFS scheduling fairness between sessions.
+ **/
+static void
+show_autogroup_linux (void)
+{
+	FILE          *f;
+	unsigned long  id;
+	int            nice;
+	int            ret = 0;
+
+	section_open ("autogroup");
+
+	f = fopen ("/proc/self/autogroup", "r");
+	if (f) {
+		ret = fscanf (f, "/autogroup-%lu nice %d", &id, &nice);
+		fclose (f);
+	}
+
+	if (ret == 2) {
+		entry ("id", "%lu", id);
+		entry ("nice", "%d", nice);
+	} else {
+		entry ("id", "%s", UNKNOWN_STR);
+		entry ("nice", "%s", UNKNOWN_STR);
+	}
+
+	section_close ();
+}
+
+/* Values read from /proc/<pid>/task/<tid>/status */
+enum {
+	TASK_STATUS_NAME,
+	TASK_STATUS_CPUS_ALLOWED_LIST,
+	TASK_STATUS_SIG_PND,
+	TASK_STATUS_SHD_PND,
+	TASK_STATUS_SIG_BLK,
+	TASK_STATUS_SIG_IGN,
+	TASK_STATUS_VOLUNTARY_CTXT_SWITCHES,
+	TASK_STATUS_NONVOLUNTARY_CTXT_SWITCHES,
+
+	TASK_STATUS_KEY_COUNT
+};
+
+static const char *task_status_keys_linux[TASK_STATUS_KEY_COUNT] = {
+	[TASK_STATUS_NAME]                       = "Name",
+	[TASK_STATUS_CPUS_ALLOWED_LIST]          = "Cpus_allowed_list",
+	[TASK_STATUS_SIG_PND]                    = "SigPnd",
+	[TASK_STATUS_SHD_PND]                    = "ShdPnd",
+	[TASK_STATUS_SIG_BLK]                    = "SigBlk",
+	[TASK_STATUS_SIG_IGN]                    = "SigIgn",
+	[TASK_STATUS_VOLUNTARY_CTXT_SWITCHES]    = "voluntary_ctxt_switches",
+	[TASK_STATUS_NONVOLUNTARY_CTXT_SWITCHES] = "nonvoluntary_ctxt_switches",
+};
+
+/**
+ * show_task_field_linux:
+ *
+ * @name: name of entry,
+ * @field: value to display.
+ *
+ * Display @field, or UNKNOWN_STR if it was not found.
+ **/
+static void
+show_task_field_linux (const char *name, const struct procenv_field *field)
+{
+	assert (name);
+	assert (field);
+
+	if (field->ptr)
+		entry (name, "%.*s", (int)field->len, field->ptr);
+	else
+		entry (name, "%s", UNKNOWN_STR);
+}
+
+/**
+ * show_task_time_linux:
+ *
+ * @name: name of entry,
+ * @field: time in clock ticks,
+ * @ticks: number of clock ticks per second.
+ *
+ * Display @field in milliseconds.
+ **/
+static void
+show_task_time_linux (const char *name, const struct procenv_field *field,
+		long ticks)
+{
+	unsigned long  value;
+
+	assert (name);
+	assert (field);
+
+	if (ticks > 0 && field_to_ulong (field, &value))
+		entry (name, "%lu ms", (unsigned long)(value * 1000ULL / (unsigned long)ticks));
+	else
+		entry (name, "%s", UNKNOWN_STR);
+}
+
+/**
+ * show_task_linux:
+ *
+ * @table: table of task_status_keys_linux,
+ * @tid: thread to display,
+ * @ticks: number of clock ticks per second.
+ *
+ * Display the details of thread @tid, reading its stat and status
+ * files once each.
+ **/
+static void
+show_task_linux (const struct procenv_kv_table *table, const char *tid,
+		long ticks)
+{
+	struct procenv_field  fields[PROCENV_STAT_FIELD_PROCESSOR];
+	struct procenv_field  values[TASK_STATUS_KEY_COUNT];
+	char                  stat[PROCENV_BUFFER];
+	char                  status[PROCENV_PROC_FILE_BUFFER];
+	char                  path[PATH_MAX];
+	size_t                count = 0;
+	size_t                i;
+
+	assert (table);
+	assert (tid);
+
+	sprintf (path, "/proc/self/task/%s/stat", tid);
+
+	if (read_file (path, stat, sizeof (stat)) >= 0)
+		count = split_proc_stat (stat, fields, PROCENV_STAT_FIELD_PROCESSOR);
+
+	/* Fields that were not found are shown as unknown */
+	for (i = count; i < PROCENV_STAT_FIELD_PROCESSOR; i++) {
+		fields[i].ptr = NULL;
+		fields[i].len = 0;
+	}
+
+	sprintf (path, "/proc/self/task/%s/status", tid);
+
+	if (read_file (path, status, sizeof (status)) >= 0)
+		(void)kv_parse (table, status, ':', values);
+	else
+		memset (values, '\0', sizeof (values));
+
+	section_open (tid);
+
+	show_task_field_linux ("name", &values[TASK_STATUS_NAME]);
+	show_task_field_linux ("state", &fields[PROCENV_STAT_FIELD_STATE-1]);
+	show_task_field_linux ("last cpu", &fields[PROCENV_STAT_FIELD_PROCESSOR-1]);
+	show_task_field_linux ("affinity", &values[TASK_STATUS_CPUS_ALLOWED_LIST]);
+
+	section_open ("cpu time");
+	show_task_time_linux ("user", &fields[PROCENV_STAT_FIELD_UTIME-1], ticks);
+	show_task_time_linux ("system", &fields[PROCENV_STAT_FIELD_STIME-1], ticks);
+	section_close ();
+
+	section_open ("signals");
+	show_task_field_linux ("blocked", &values[TASK_STATUS_SIG_BLK]);
+	show_task_field_linux ("ignored", &values[TASK_STATUS_SIG_IGN]);
+	show_task_field_linux ("pending", &values[TASK_STATUS_SIG_PND]);
+	show_task_field_linux ("shared pending", &values[TASK_STATUS_SHD_PND]);
+	section_close ();
+
+	section_open ("context switches");
+	show_task_field_linux ("voluntary",
+			&values[TASK_STATUS_VOLUNTARY_CTXT_SWITCHES]);
+	show_task_field_linux ("involuntary",
+			&values[TASK_STATUS_NONVOLUNTARY_CTXT_SWITCHES]);
+	section_close ();
+
+	show_sched_attr_linux ((pid_t)atol (tid));
+
+	section_close ();
+}
+
+/**
+ * show_thread_scheduling_linux:
+ *
+ * Display the name, state, CPU, affinity, scheduling attributes,
+ * signal masks, context switches and CPU time of every thread in the
+ * process.
+ **/
+static void
+show_thread_scheduling_linux (void)
+{
+	struct procenv_kv_table   table;
+	DIR                      *dir;
+	struct dirent            *ent;
+	long                      ticks;
+	size_t                    i;
+
+	kv_table_init (&table);
+
+	for (i = 0; i < TASK_STATUS_KEY_COUNT; i++)
+		(void)kv_table_add (&table, task_status_keys_linux[i]);
+
+	kv_table_build (&table);
+
+	ticks = sysconf (_SC_CLK_TCK);
+
+	container_open ("tasks");
+
+	dir = opendir_tracked ("/proc/self/task");
+	if (! dir)
+		goto out;
+
+	while ((ent = readdir (dir)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+		if (atol (ent->d_name) <= 0)
+			continue;
+
+		object_open (false);
+
+		show_task_linux (&table, ent->d_name, ticks);
+
+		object_close (false);
+	}
+
+	closedir_tracked (dir);
+
+out:
+	container_close ();
+}
+
+static void
+handle_scheduler_type_linux (void)
+{
+	int sched;
+
+	sched = sched_getscheduler (0);
+
+	entry ("type", "%s",
+			sched < 0 ? UNKNOWN_STR :
+			get_scheduler_name (sched));
+
+	show_sched_attr_linux (0);
+	show_autogroup_linux ();
+}
+
+static void
+show_extended_if_flags_linux (const char *interface, unsigned short *flags)
+{
+	int                        sock;
+	struct ifreq               ifr;
+	const struct procenv_map  *p;
+
+	assert (interface);
+	assert (flags);
+
+	/* We need to create a socket to query an interfaces mac
+	 * address. Don't ask me why...
+	 */
+	sock = track_fd (socket (AF_INET, SOCK_DGRAM, IPPROTO_IP));
+
+	if (sock < 0)
+		return;
+
+	memset (&ifr, 0, sizeof (struct ifreq));
+	strncpy (ifr.ifr_name, interface, IFNAMSIZ-1);
+
+	if (ioctl (sock, SIOCGIFPFLAGS, &ifr) < 0)
+		goto out;
+
+	*flags = ifr.ifr_flags;
+
+	for (p = if_extended_flag_map_linux; p && p->name; p++) {
+		if (*flags & p->num) {
+			object_open (false);
+			entry (p->name, "0x%x", p->num);
+			object_close (false);
+		}
+	}
+out:
+	close_tracked (sock);
+}
+
+/* Initial size of buffer used to receive netlink dump responses. The
+ * buffer grows if the kernel sends a larger message.
+ */
+#define PROCENV_NETLINK_BUFFER  (32 * 1024)
+
+struct procenv_netlink_buffer {
+	char    *data;
+	size_t   size;
+};
+
+static struct procenv_map rt_scope_map_linux[] = {
+	{ "global"  , RT_SCOPE_UNIVERSE },
+	{ "site"    , RT_SCOPE_SITE },
+	{ "link"    , RT_SCOPE_LINK },
+	{ "host"    , RT_SCOPE_HOST },
+	{ "nowhere" , RT_SCOPE_NOWHERE },
+
+	{ NULL, 0 }
+};
+
+static struct procenv_map operstate_map_linux[] = {
+	{ "unknown"          , IF_OPER_UNKNOWN },
+	{ "not present"      , IF_OPER_NOTPRESENT },
+	{ "down"             , IF_OPER_DOWN },
+	{ "lower layer down" , IF_OPER_LOWERLAYERDOWN },
+	{ "testing"          , IF_OPER_TESTING },
+	{ "dormant"          , IF_OPER_DORMANT },
+	{ "up"               , IF_OPER_UP },
+
+	{ NULL, 0 }
+};
+
+struct procenv_link_stat {
+	const char  *name;
+	size_t       offset;
+};
+
+#define mk_link_stat(name, field) \
+	{ name, offsetof (struct rtnl_link_stats64, field) }
+
+static struct procenv_link_stat rx_link_stats_linux[] = {
+	mk_link_stat ("bytes"       , rx_bytes),
+	mk_link_stat ("packets"     , rx_packets),
+	mk_link_stat ("errors"      , rx_errors),
+	mk_link_stat ("dropped"     , rx_dropped),
+	mk_link_stat ("fifo errors" , rx_fifo_errors),
+	mk_link_stat ("overruns"    , rx_over_errors),
+	mk_link_stat ("missed"      , rx_missed_errors),
+	mk_link_stat ("multicast"   , multicast),
+
+	{ NULL, 0 }
+};
+
+static struct procenv_link_stat tx_link_stats_linux[] = {
+	mk_link_stat ("bytes"       , tx_bytes),
+	mk_link_stat ("packets"     , tx_packets),
+	mk_link_stat ("errors"      , tx_errors),
+	mk_link_stat ("dropped"     , tx_dropped),
+	mk_link_stat ("fifo errors" , tx_fifo_errors),
+	mk_link_stat ("carrier"     , tx_carrier_errors),
+	mk_link_stat ("collisions"  , collisions),
+
+	{ NULL, 0 }
+};
+
+static const char *
+get_map_name_linux (const struct procenv_map *map, unsigned int num)
+{
+	const struct procenv_map *p;
+
+	for (p = map; p->name; p++) {
+		if (p->num == num)
+			return p->name;
+	}
+
+	return UNKNOWN_STR;
+}
+
+static void
+release_netlink_buffer (void *data)
+{
+	struct procenv_netlink_buffer *buffer = data;
+
+	free_if_set (buffer->data);
+}
+
+/**
+ * netlink_dump:
+ *
+ * @sock: NETLINK_ROUTE socket,
+ * @type: RTM_GET* request type,
+ * @handler: function to call for each message received,
+ * @data: data to pass to @handler.
+ *
+ * Request a dump of all objects of @type from the kernel and pass
+ * each resulting message to @handler.
+ *
+ * Returns: true on success, else false.
+ **/
+static bool
+netlink_dump (int sock, int type,
+		void (*handler) (const struct nlmsghdr *nlh, void *data),
+		void *data)
+{
+	static uint32_t                 seq = 0;
+	struct procenv_netlink_buffer   buffer;
+	ssize_t                         len;
+	struct nlmsghdr                *nlh;
+	bool                            done = false;
+	bool                            ok = false;
+	struct {
+		struct nlmsghdr  nlh;
+		struct rtgenmsg  gen;
+	} req;
+
+	assert (handler);
+
+	memset (&req, '\0', sizeof (req));
+
+	req.nlh.nlmsg_len = NLMSG_LENGTH (sizeof (struct rtgenmsg));
+	req.nlh.nlmsg_type = (unsigned short)type;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nlh.nlmsg_seq = ++seq;
+	req.gen.rtgen_family = AF_UNSPEC;
+
+	if (send (sock, &req, req.nlh.nlmsg_len, 0) < 0)
+		return false;
+
+	buffer.size = PROCENV_NETLINK_BUFFER;
+	buffer.data = malloc (buffer.size);
+	if (! buffer.data)
+		die ("failed to allocate netlink buffer");
+
+	/* Track the holder since the buffer may be reallocated */
+	track_memory (&buffer, release_netlink_buffer);
+
+	while (! done) {
+		/* Determine the size of the next message so that it is
+		 * never truncated.
+		 */
+		len = recv (sock, NULL, 0, MSG_PEEK | MSG_TRUNC);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			goto out;
+
+		if ((size_t)len > buffer.size) {
+			char *data;
+
+			/* Retain the existing buffer on failure so it can be freed */
+			data = realloc (buffer.data, (size_t)len);
+			if (! data)
+				die ("failed to allocate netlink buffer");
+
+			buffer.data = data;
+			buffer.size = (size_t)len;
+		}
+
+		len = recv (sock, buffer.data, buffer.size, 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			goto out;
+
+		for (nlh = (struct nlmsghdr *)buffer.data;
+				NLMSG_OK (nlh, (size_t)len);
+				nlh = NLMSG_NEXT (nlh, len)) {
+
+			if (nlh->nlmsg_seq != seq)
+				continue;
+
+			if (nlh->nlmsg_type == NLMSG_DONE) {
+				done = true;
+				break;
+			}
+
+			if (nlh->nlmsg_type == NLMSG_ERROR)
+				goto out;
+
+			handler (nlh, data);
+		}
+	}
+
+	ok = true;
+
+out:
+	free_tracked (&buffer);
+
+	return ok;
+}
+
+static void
+handle_netlink_link (const struct nlmsghdr *nlh, void *data)
+{
+	struct procenv_netlink      *nl = data;
+	struct procenv_netlink_link *link;
+	const struct ifinfomsg      *ifi;
+	const struct rtattr         *rta;
+	int                          len;
+	size_t                       bytes;
+
+	assert (nlh);
+	assert (nl);
+
+	if (nlh->nlmsg_type != RTM_NEWLINK)
+		return;
+
+	if (nl->link_count == nl->link_size) {
+		struct procenv_netlink_link *links;
+
+		/* Retain the existing links on failure so they can be freed */
+		links = realloc (nl->links,
+				(nl->link_size ? nl->link_size * 2 : 16)
+				* sizeof (struct procenv_netlink_link));
+		if (! links)
+			die ("failed to allocate space for network links");
+
+		nl->links = links;
+		nl->link_size = nl->link_size ? nl->link_size * 2 : 16;
+	}
+
+	link = &nl->links[nl->link_count];
+	memset (link, '\0', sizeof (struct procenv_netlink_link));
+
+	ifi = NLMSG_DATA (nlh);
+
+	link->index = ifi->ifi_index;
+	link->flags = ifi->ifi_flags;
+	link->type = ifi->ifi_type;
+	link->operstate = IF_OPER_UNKNOWN;
+
+	len = (int)IFLA_PAYLOAD (nlh);
+
+	for (rta = IFLA_RTA (ifi); RTA_OK (rta, len); rta = RTA_NEXT (rta, len)) {
+		bytes = RTA_PAYLOAD (rta);
+
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			strncpy (link->name, RTA_DATA (rta), IFNAMSIZ-1);
+			break;
+
+		case IFLA_ADDRESS:
+			if (bytes > sizeof (link->mac))
+				bytes = sizeof (link->mac);
+			memcpy (link->mac, RTA_DATA (rta), bytes);
+			link->mac_len = bytes;
+			break;
+
+		case IFLA_MTU:
+			link->mtu = *(const unsigned int *)RTA_DATA (rta);
+			break;
+
+		case IFLA_QDISC:
+			strncpy (link->qdisc, RTA_DATA (rta), sizeof (link->qdisc)-1);
+			break;
+
+		case IFLA_TXQLEN:
+			link->txqlen = *(const unsigned int *)RTA_DATA (rta);
+			link->have_txqlen = true;
+			break;
+
+		case IFLA_OPERSTATE:
+			link->operstate = *(const unsigned char *)RTA_DATA (rta);
+			break;
+
+		case IFLA_STATS64:
+			if (bytes > sizeof (link->stats))
+				bytes = sizeof (link->stats);
+			memcpy (&link->stats, RTA_DATA (rta), bytes);
+			link->have_stats = true;
+			break;
+		}
+	}
+
+	if (! link->name[0])
+		return;
+
+	nl->link_count++;
+}
+
+static void
+handle_netlink_addr (const struct nlmsghdr *nlh, void *data)
+{
+	struct procenv_netlink      *nl = data;
+	struct procenv_netlink_addr *addr;
+	const struct ifaddrmsg      *ifa;
+	const struct rtattr         *rta;
+	int                          len;
+	size_t                       bytes;
+
+	assert (nlh);
+	assert (nl);
+
+	if (nlh->nlmsg_type != RTM_NEWADDR)
+		return;
+
+	ifa = NLMSG_DATA (nlh);
+
+	if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+		return;
+
+	if (nl->addr_count == nl->addr_size) {
+		struct procenv_netlink_addr *addrs;
+
+		/* Retain the existing addresses on failure so they can be freed */
+		addrs = realloc (nl->addrs,
+				(nl->addr_size ? nl->addr_size * 2 : 16)
+				* sizeof (struct procenv_netlink_addr));
+		if (! addrs)
+			die ("failed to allocate space for network addresses");
+
+		nl->addrs = addrs;
+		nl->addr_size = nl->addr_size ? nl->addr_size * 2 : 16;
+	}
+
+	addr = &nl->addrs[nl->addr_count];
+	memset (addr, '\0', sizeof (struct procenv_netlink_addr));
+
+	addr->seq = nl->addr_count;
+	addr->index = (int)ifa->ifa_index;
+	addr->family = ifa->ifa_family;
+	addr->prefix_len = ifa->ifa_prefixlen;
+	addr->scope = ifa->ifa_scope;
+
+	len = (int)IFA_PAYLOAD (nlh);
+
+	for (rta = IFA_RTA (ifa); RTA_OK (rta, len); rta = RTA_NEXT (rta, len)) {
+		bytes = RTA_PAYLOAD (rta);
+		if (bytes > sizeof (addr->address))
+			bytes = sizeof (addr->address);
+
+		switch (rta->rta_type) {
+		case IFA_ADDRESS:
+			memcpy (addr->address, RTA_DATA (rta), bytes);
+			addr->have_address = true;
+			break;
+
+		case IFA_LOCAL:
+			memcpy (addr->local, RTA_DATA (rta), bytes);
+			addr->have_local = true;
+			break;
+
+		case IFA_BROADCAST:
+			memcpy (addr->broadcast, RTA_DATA (rta), bytes);
+			addr->have_broadcast = true;
+			break;
+		}
+	}
+
+	nl->addr_count++;
+}
+
+static int
+netlink_link_name_compar (const void *a, const void *b)
+{
+	const struct procenv_netlink_link *x = a;
+	const struct procenv_netlink_link *y = b;
+
+	return strcmp (x->name, y->name);
+}
+
+static int
+netlink_addr_compar (const void *a, const void *b)
+{
+	const struct procenv_netlink_addr *x = a;
+	const struct procenv_netlink_addr *y = b;
+
+	if (x->index != y->index)
+		return (x->index > y->index) - (x->index < y->index);
+
+	/* retain kernel ordering for an interface */
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/**
+ * find_netlink_addrs:
+ *
+ * @nl: collected netlink data (with addresses sorted by index),
+ * @index: interface index,
+ * @count: set to number of addresses for @index.
+ *
+ * Returns: first address for interface @index, or NULL if none.
+ **/
+static const struct procenv_netlink_addr *
+find_netlink_addrs (const struct procenv_netlink *nl, int index, size_t *count)
+{
+	size_t low = 0;
+	size_t high = nl->addr_count;
+	size_t mid;
+	size_t end;
+
+	assert (count);
+
+	*count = 0;
+
+	/* find lower bound */
+	while (low < high) {
+		mid = low + ((high - low) / 2);
+		if (nl->addrs[mid].index < index)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (end = low; end < nl->addr_count && nl->addrs[end].index == index; end++)
+		;
+
+	*count = end - low;
+
+	return *count ? &nl->addrs[low] : NULL;
+}
+
+/**
+ * format_netmask:
+ *
+ * @family: AF_INET or AF_INET6,
+ * @prefix_len: network prefix length,
+ * @buffer: buffer of at least INET6_ADDRSTRLEN bytes.
+ **/
+static void
+format_netmask (int family, unsigned int prefix_len, char *buffer)
+{
+	unsigned char  mask[16];
+	size_t         bytes = family == AF_INET ? 4 : 16;
+	size_t         i;
+
+	memset (mask, '\0', sizeof (mask));
+
+	for (i = 0; i < bytes && prefix_len; i++) {
+		if (prefix_len >= 8) {
+			mask[i] = 0xff;
+			prefix_len -= 8;
+		} else {
+			mask[i] = (unsigned char)(0xff << (8 - prefix_len));
+			prefix_len = 0;
+		}
+	}
+
+	if (! inet_ntop (family, mask, buffer, INET6_ADDRSTRLEN))
+		sprintf (buffer, "%s", UNKNOWN_STR);
+}
+
+static void
+show_netlink_addr (const struct procenv_netlink_addr *addr)
+{
+	char           buffer[INET6_ADDRSTRLEN];
+	const void    *local;
+
+	assert (addr);
+
+	/* For point-to-point interfaces, IFA_ADDRESS is the peer
+	 * address and IFA_LOCAL the local one. Otherwise they are
+	 * identical (or IFA_LOCAL is absent).
+	 */
+	local = addr->have_local ? addr->local : addr->address;
+
+	object_open (false);
+
+	entry ("family", "%s (0x%x)",
+			get_net_family_name ((sa_family_t)addr->family),
+			addr->family);
+
+	if (inet_ntop (addr->family, local, buffer, sizeof (buffer)))
+		entry ("address", "%s", buffer);
+	else
+		entry ("address", "%s", UNKNOWN_STR);
+
+	entry ("prefix length", "%u", addr->prefix_len);
+
+	format_netmask (addr->family, addr->prefix_len, buffer);
+	entry ("netmask", "%s", buffer);
+
+	if (addr->have_broadcast
+			&& inet_ntop (addr->family, addr->broadcast, buffer, sizeof (buffer))) {
+		entry ("broadcast", "%s", buffer);
+	} else {
+		entry ("broadcast", "%s", NA_STR);
+	}
+
+	if (addr->have_local && addr->have_address
+			&& memcmp (addr->local, addr->address, sizeof (addr->local))
+			&& inet_ntop (addr->family, addr->address, buffer, sizeof (buffer))) {
+		entry ("point-to-point", "%s", buffer);
+	}
+
+	entry ("scope", "%s", get_map_name_linux (rt_scope_map_linux, addr->scope));
+
+	object_close (false);
+}
+
+static uint64_t
+get_link_stat (const struct rtnl_link_stats64 *stats,
+		const struct procenv_link_stat *stat)
+{
+	return *(const uint64_t *)((const char *)stats + stat->offset);
+}
+
+/**
+ * show_link_stats:
+ *
+ * @name: name of section to create,
+ * @stats: map of statistics to display,
+ * @link: link to display statistics for,
+ * @prev: earlier sample of @link, or NULL,
+ * @elapsed: seconds between @prev and @link samples.
+ *
+ * Display the counters for @link. If @prev is specified, also display
+ * the per-second rate for each counter.
+ **/
+static void
+show_link_stats (const char *name,
+		const struct procenv_link_stat *stats,
+		const struct procenv_netlink_link *link,
+		const struct procenv_netlink_link *prev,
+		double elapsed)
+{
+	const struct procenv_link_stat  *stat;
+	uint64_t                         value;
+	uint64_t                         prev_value;
+	char                            *rate_name = NULL;
+
+	assert (name);
+	assert (stats);
+	assert (link);
+
+	section_open (name);
+
+	for (stat = stats; stat->name; stat++) {
+		value = get_link_stat (&link->stats, stat);
+
+		entry (stat->name, "%" PRIu64, value);
+
+		if (! rate_window)
+			continue;
+
+		appendf (&rate_name, "%s per second", stat->name);
+
+		if (prev && prev->have_stats && elapsed > 0) {
+			prev_value = get_link_stat (&prev->stats, stat);
+
+			/* counters reset (for example, interface re-created) */
+			if (value < prev_value)
+				entry (rate_name, "%s", UNKNOWN_STR);
+			else
+				entry (rate_name, "%.2f",
+						(double)(value - prev_value) / elapsed);
+		} else {
+			entry (rate_name, "%s", NA_STR);
+		}
+
+		free (rate_name);
+		rate_name = NULL;
+	}
+
+	section_close ();
+}
+
+static int
+netlink_link_index_compar (const void *a, const void *b)
+{
+	const struct procenv_netlink_link *x = a;
+	const struct procenv_netlink_link *y = b;
+
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+/**
+ * find_netlink_link:
+ *
+ * @nl: collected netlink data (with links sorted by index),
+ * @index: interface index.
+ *
+ * Returns: link with index @index, or NULL if not found.
+ **/
+static const struct procenv_netlink_link *
+find_netlink_link (const struct procenv_netlink *nl, int index)
+{
+	struct procenv_netlink_link key;
+
+	assert (nl);
+
+	if (! nl->link_count)
+		return NULL;
+
+	key.index = index;
+
+	return bsearch (&key, nl->links, nl->link_count,
+			sizeof (struct procenv_netlink_link),
+			netlink_link_index_compar);
+}
+
+static void
+show_netlink_link (const struct procenv_netlink *nl,
+		const struct procenv_netlink_link *link,
+		const struct procenv_netlink *prev_nl,
+		double elapsed)
+{
+	const struct procenv_netlink_link  *prev = NULL;
+	const struct procenv_netlink_addr  *addrs;
+	char                               *mac = NULL;
+	size_t                              count;
+	size_t                              i;
+	bool                                valid = false;
+
+	assert (nl);
+	assert (link);
+
+	section_open (link->name);
+
+	entry ("index", "%d", link->index);
+
+	section_open ("flags");
+
+	entry ("value", "0x%x", link->flags);
+
+	container_open ("fields");
+	decode_if_flags (link->flags);
+	container_close ();
+
+	section_close ();
+
+	/* MAC comprised of all zeros cannot be valid */
+	for (i = 0; i < link->mac_len; i++) {
+		if (link->mac[i]) {
+			valid = true;
+			break;
+		}
+	}
+
+	if (valid) {
+		for (i = 0; i < link->mac_len; i++)
+			appendf (&mac, "%s%.2x", i ? ":" : "", link->mac[i]);
+	}
+
+	entry ("mac", "%s", mac ? mac : NA_STR);
+	free_if_set (mac);
+
+	if (link->mtu)
+		entry ("mtu", "%u", link->mtu);
+	else
+		entry ("mtu", "%s", UNKNOWN_STR);
+
+	entry ("qdisc", "%s", link->qdisc[0] ? link->qdisc : NA_STR);
+
+	if (link->have_txqlen)
+		entry ("txqlen", "%u", link->txqlen);
+	else
+		entry ("txqlen", "%s", UNKNOWN_STR);
+
+	entry ("operational state", "%s",
+			get_map_name_linux (operstate_map_linux, link->operstate));
+
+	section_open ("statistics");
+
+	if (link->have_stats) {
+		if (rate_window) {
+			entry ("rate window", "%lums", rate_window);
+
+			if (prev_nl)
+				prev = find_netlink_link (prev_nl, link->index);
+		}
+
+		show_link_stats ("rx", rx_link_stats_linux, link, prev, elapsed);
+		show_link_stats ("tx", tx_link_stats_linux, link, prev, elapsed);
+	}
+
+	section_close ();
+
+	container_open ("addresses");
+
+	addrs = find_netlink_addrs (nl, link->index, &count);
+
+	for (i = 0; i < count; i++)
+		show_netlink_addr (&addrs[i]);
+
+	container_close ();
+
+	section_close ();
+}
+
+static void
+release_netlink (void *data)
+{
+	struct procenv_netlink *nl = data;
+
+	free_if_set (nl->links);
+	free_if_set (nl->addrs);
+}
+
+/**
+ * show_network_interfaces_linux:
+ *
+ * Display all network interfaces and their addresses, sorted by
+ * interface name.
+ *
+ * Details are obtained using two netlink dump requests
+ * (RTM_GETLINK and RTM_GETADDR) rather than using getifaddrs(3)
+ * plus multiple ioctl(2) calls for each interface.
+ *
+ * If a rate window has been specified, the links are sampled twice
+ * (@rate_window milliseconds apart) to allow per-second rates
+ * to be calculated for each counter.
+ *
+ * Returns: true if the details were obtained, or false if netlink
+ * is not available (in which case nothing will have been displayed).
+ **/
+static bool
+show_network_interfaces_linux (void)
+{
+	struct procenv_netlink  nl;
+	struct procenv_netlink  prev;
+	struct sockaddr_nl      addr;
+	struct timespec         start;
+	struct timespec         end;
+	struct timespec         delay;
+	double                  elapsed = 0;
+	int                     sock;
+	bool                    ok = false;
+	size_t                  i;
+
+	memset (&nl, '\0', sizeof (nl));
+	memset (&prev, '\0', sizeof (prev));
+
+	sock = track_fd (socket (AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+	if (sock < 0)
+		return false;
+
+	track_memory (&nl, release_netlink);
+	track_memory (&prev, release_netlink);
+
+	memset (&addr, '\0', sizeof (addr));
+	addr.nl_family = AF_NETLINK;
+
+	if (bind (sock, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+		goto out;
+
+	if (rate_window) {
+		if (! netlink_dump (sock, RTM_GETLINK, handle_netlink_link, &prev))
+			goto out;
+
+		if (clock_gettime (CLOCK_MONOTONIC, &start) < 0)
+			goto out;
+
+		delay.tv_sec = (time_t)(rate_window / 1000);
+		delay.tv_nsec = (long)((rate_window % 1000) * 1000000);
+
+		while (nanosleep (&delay, &delay) < 0 && errno == EINTR)
+			;
+	}
+
+	if (! netlink_dump (sock, RTM_GETLINK, handle_netlink_link, &nl))
+		goto out;
+
+	if (rate_window) {
+		if (clock_gettime (CLOCK_MONOTONIC, &end) < 0)
+			goto out;
+
+		elapsed = (double)(end.tv_sec - start.tv_sec)
+			+ ((double)(end.tv_nsec - start.tv_nsec) / 1e9);
+
+		qsort (prev.links, prev.link_count,
+				sizeof (struct procenv_netlink_link),
+				netlink_link_index_compar);
+	}
+
+	if (! netlink_dump (sock, RTM_GETADDR, handle_netlink_addr, &nl))
+		goto out;
+
+	ok = true;
+
+	qsort (nl.addrs, nl.addr_count,
+			sizeof (struct procenv_netlink_addr), netlink_addr_compar);
+
+	qsort (nl.links, nl.link_count,
+			sizeof (struct procenv_netlink_link), netlink_link_name_compar);
+
+	for (i = 0; i < nl.link_count; i++)
+		show_netlink_link (&nl, &nl.links[i],
+				rate_window ? &prev : NULL, elapsed);
+
+out:
+	close_tracked (sock);
+
+	free_tracked (&prev);
+	free_tracked (&nl);
+
+	return ok;
+}
+
+static PROCENV_CPU_SET_TYPE *
+get_cpuset_linux (void)
+{
+	int ret = 0;
+
+#if ! defined (CPU_ALLOC)
+	/* RHEL 5 */
+	static PROCENV_CPU_SET_TYPE  cpu_set_real;
+#else
+	long   max;
+#endif
+
+	size_t size;
+	PROCENV_CPU_SET_TYPE *cs = NULL;
+
+#if defined (CPU_ALLOC)
+
+	max = get_sysconf (_SC_NPROCESSORS_ONLN);
+	if (max < 0)
+		return NULL;
+
+	cs = CPU_ALLOC (max);
+	if (! cs)
+		return NULL;
+
+	size = CPU_ALLOC_SIZE (max);
+	CPU_ZERO_S (size, cs);
+
+#else /* ! CPU_ALLOC */
+
+	size = sizeof (PROCENV_CPU_SET_TYPE);
+
+	CPU_ZERO (&cpu_set_real);
+	cs = &cpu_set_real;
+
+#endif /* CPU_ALLOC */
+
+	/* We could use sched_getaffinity(2) rather than
+	 * sched_getaffinity() on Linux (2.5.8+) but
+	 * pthread_getaffinity_np() provides the same information...
+	 * Except it is missing on kFreeBSD systems (!) so we have to
+	 * use sched_getaffinity() there. :(
+	 */
+#if ! defined (CPU_ALLOC)
+	ret = sched_getaffinity (0, size, cs);
+#else
+
+	/* On a hyperthreaded system, "size" as above may not actually
+	 * be big enough, and we get EINVAL (hwloc has a similar
+	 * workaround).
+	 */
+	{
+		int mult = 0;
+		while ((ret = pthread_getaffinity_np (pthread_self (), size, cs))
+				== EINVAL) {
+			CPU_FREE (cs);
+			/* Bail out at an arbitrary value.  */
+			if (mult > 128) break;
+			mult += 2;
+			cs = CPU_ALLOC (mult * max);
+			size = CPU_ALLOC_SIZE (mult * max);
+			CPU_ZERO_S (size, cs);
+		}
+	}
+#endif
+	if (ret)
+		goto err;
+
+	return cs;
+err:
+#if defined (CPU_ALLOC)
+	CPU_FREE (cs);
+#endif
+	return NULL;
+}
+
+static void
+free_cpuset_linux (PROCENV_CPU_SET_TYPE *cs)
+{
+#if defined (CPU_ALLOC)
+	CPU_FREE (cs);
+#endif
+}
+
+static void
+release_cpuset (void *cs)
+{
+	free_cpuset_linux (cs);
+}
+
+static bool
+cpuset_has_cpu_linux (const PROCENV_CPU_SET_TYPE *cs,
+		PROCENV_CPU_TYPE cpu)
+{
+	return CPU_ISSET (cpu, cs);
+}
+
+#define PROCENV_SYS_NET_PATH "/sys/class/net"
+
+/**
+ * append_cpu_range:
+ *
+ * @list: string to append to,
+ * @first: first CPU in range,
+ * @last: last CPU in range.
+ *
+ * Append the specified CPU range to @list in cpuset(7) "list format".
+ **/
+static void
+append_cpu_range (char **list, long first, long last)
+{
+	assert (list);
+
+	if (first == last)
+		appendf (list, "%s%ld", *list ? "," : "", first);
+	else
+		appendf (list, "%s%ld-%ld", *list ? "," : "", first, last);
+}
+
+/**
+ * cpu_mask_to_lists:
+ *
+ * @mask: sysfs CPU mask (hex digits in comma-separated groups),
+ * @cs: CPU set to cross-reference @mask against (or NULL),
+ * @max: number of CPUs @cs is valid for,
+ * @all: set to list of CPUs in @mask,
+ * @common: set to list of CPUs in both @mask and @cs.
+ *
+ * Convert @mask into cpuset(7) "list format" strings.
+ * Lists will be NULL if no CPUs are set.
+ *
+ * Returns: true on success, false if @mask is invalid.
+ **/
+static bool
+cpu_mask_to_lists (const char *mask, const PROCENV_CPU_SET_TYPE *cs,
+		long max, char **all, char **common)
+{
+	const char  *p;
+	long         cpu = 0;
+	long         all_first = -1;
+	long         common_first = -1;
+	int          digit;
+	int          bit;
+	bool         set;
+	bool         in_cs;
+
+	assert (mask);
+	assert (all);
+	assert (common);
+
+	*all = *common = NULL;
+
+	if (! *mask)
+		return false;
+
+	/* The least-significant digit corresponds to the lowest CPUs,
+	 * so walk the mask backwards.
+	 */
+	for (p = mask + strlen (mask) - 1; p >= mask; p--) {
+		if (*p == ',')
+			continue;
+
+		if (! isxdigit ((unsigned char)*p))
+			goto err;
+
+		digit = isdigit ((unsigned char)*p)
+			? *p - '0'
+			: tolower ((unsigned char)*p) - 'a' + 10;
+
+		for (bit = 0; bit < 4; bit++, cpu++) {
+			set = digit & (1 << bit);
+			in_cs = set && cs && cpu < max && cpuset_has_cpu_linux (cs, cpu);
+
+			if (set && all_first < 0) {
+				all_first = cpu;
+			} else if (! set && all_first >= 0) {
+				append_cpu_range (all, all_first, cpu - 1);
+				all_first = -1;
+			}
+
+			if (in_cs && common_first < 0) {
+				common_first = cpu;
+			} else if (! in_cs && common_first >= 0) {
+				append_cpu_range (common, common_first, cpu - 1);
+				common_first = -1;
+			}
+		}
+	}
+
+	if (all_first >= 0)
+		append_cpu_range (all, all_first, cpu - 1);
+
+	if (common_first >= 0)
+		append_cpu_range (common, common_first, cpu - 1);
+
+	return true;
+
+err:
+	free_if_set (*all);
+	free_if_set (*common);
+	*all = *common = NULL;
+
+	return false;
+}
+
+/**
+ * show_queue_cpus:
+ *
+ * @dir: queue directory,
+ * @file: name of CPU mask file in @dir,
+ * @name: name of entry to display,
+ * @cs: process CPU affinity,
+ * @max: number of CPUs @cs is valid for.
+ *
+ * Display the CPUs in the specified mask file, along with those which
+ * are also in the process's CPU affinity.
+ **/
+static void
+show_queue_cpus (const char *dir, const char *file, const char *name,
+		const PROCENV_CPU_SET_TYPE *cs, long max)
+{
+	char   path[PATH_MAX];
+	char   buffer[PROCENV_BUFFER];
+	char  *all = NULL;
+	char  *common = NULL;
+	char  *common_name = NULL;
+	bool   ok;
+
+	assert (dir);
+	assert (file);
+	assert (name);
+
+	sprintf (path, "%s/%s", dir, file);
+
+	ok = read_sysfs_value (path, buffer, sizeof (buffer))
+		&& cpu_mask_to_lists (buffer, cs, max, &all, &common);
+
+	appendf (&common_name, "%s in affinity", name);
+
+	if (ok) {
+		entry (name, "%s", all ? all : NA_STR);
+		entry (common_name, "%s", common ? common : NA_STR);
+	} else {
+		entry (name, "%s", UNKNOWN_STR);
+		entry (common_name, "%s", UNKNOWN_STR);
+	}
+
+	free (common_name);
+	free_if_set (all);
+	free_if_set (common);
+}
+
+static int
+ethtool_ioctl (int sock, const char *interface, void *cmd)
+{
+	struct ifreq ifr;
+
+	assert (interface);
+	assert (cmd);
+
+	memset (&ifr, '\0', sizeof (ifr));
+	strncpy (ifr.ifr_name, interface, IFNAMSIZ-1);
+	ifr.ifr_data = cmd;
+
+	return ioctl (sock, SIOCETHTOOL, &ifr);
+}
+
+static void
+show_nic_channels (int sock, const char *interface)
+{
+	struct ethtool_channels channels;
+
+	memset (&channels, '\0', sizeof (channels));
+	channels.cmd = ETHTOOL_GCHANNELS;
+
+	section_open ("channels");
+
+	if (ethtool_ioctl (sock, interface, &channels) < 0)
+		goto out;
+
+	entry ("rx", "%u", channels.rx_count);
+	entry ("rx maximum", "%u", channels.max_rx);
+	entry ("tx", "%u", channels.tx_count);
+	entry ("tx maximum", "%u", channels.max_tx);
+	entry ("other", "%u", channels.other_count);
+	entry ("other maximum", "%u", channels.max_other);
+	entry ("combined", "%u", channels.combined_count);
+	entry ("combined maximum", "%u", channels.max_combined);
+
+out:
+	section_close ();
+}
+
+static void
+show_nic_rings (int sock, const char *interface)
+{
+	struct ethtool_ringparam ring;
+
+	memset (&ring, '\0', sizeof (ring));
+	ring.cmd = ETHTOOL_GRINGPARAM;
+
+	section_open ("ring parameters");
+
+	if (ethtool_ioctl (sock, interface, &ring) < 0)
+		goto out;
+
+	entry ("rx", "%u", ring.rx_pending);
+	entry ("rx maximum", "%u", ring.rx_max_pending);
+	entry ("rx mini", "%u", ring.rx_mini_pending);
+	entry ("rx mini maximum", "%u", ring.rx_mini_max_pending);
+	entry ("rx jumbo", "%u", ring.rx_jumbo_pending);
+	entry ("rx jumbo maximum", "%u", ring.rx_jumbo_max_pending);
+	entry ("tx", "%u", ring.tx_pending);
+	entry ("tx maximum", "%u", ring.tx_max_pending);
+
+out:
+	section_close ();
+}
+
+static struct procenv_map ethtool_offload_map_linux[] = {
+	{ "rx-checksumming"              , ETHTOOL_GRXCSUM },
+	{ "tx-checksumming"              , ETHTOOL_GTXCSUM },
+	{ "scatter-gather"               , ETHTOOL_GSG },
+	{ "tcp-segmentation-offload"     , ETHTOOL_GTSO },
+	{ "generic-segmentation-offload" , ETHTOOL_GGSO },
+	{ "generic-receive-offload"      , ETHTOOL_GGRO },
+
+	{ NULL, 0 }
+};
+
+static struct procenv_map ethtool_flag_map_linux[] = {
+	{ "large-receive-offload"        , ETH_FLAG_LRO },
+	{ "rx-vlan-offload"              , ETH_FLAG_RXVLAN },
+	{ "tx-vlan-offload"              , ETH_FLAG_TXVLAN },
+	{ "ntuple-filters"               , ETH_FLAG_NTUPLE },
+	{ "receive-hashing"              , ETH_FLAG_RXHASH },
+
+	{ NULL, 0 }
+};
+
+static void
+show_nic_offloads (int sock, const char *interface)
+{
+	struct ethtool_value       value;
+	const struct procenv_map  *p;
+
+	section_open ("offloads");
+
+	for (p = ethtool_offload_map_linux; p->name; p++) {
+		memset (&value, '\0', sizeof (value));
+		value.cmd = (uint32_t)p->num;
+
+		if (ethtool_ioctl (sock, interface, &value) < 0)
+			continue;
+
+		entry (p->name, "%s", value.data ? YES_STR : NO_STR);
+	}
+
+	memset (&value, '\0', sizeof (value));
+	value.cmd = ETHTOOL_GFLAGS;
+
+	if (ethtool_ioctl (sock, interface, &value) == 0) {
+		for (p = ethtool_flag_map_linux; p->name; p++)
+			entry (p->name, "%s", value.data & (uint32_t)p->num ? YES_STR : NO_STR);
+	}
+
+	section_close ();
+}
+
+/**
+ * struct procenv_dir_entries:
+ *
+ * @names: directory entries returned by scandir(3),
+ * @count: number of @names.
+ **/
+struct procenv_dir_entries {
+	struct dirent  **names;
+	int              count;
+};
+
+static void
+free_dir_entries (void *data)
+{
+	struct procenv_dir_entries  *entries = data;
+	int                          i;
+
+	for (i = 0; i < entries->count; i++)
+		free (entries->names[i]);
+
+	free (entries->names);
+}
+
+static void
+show_nic_queues (const char *interface, const PROCENV_CPU_SET_TYPE *cs, long max)
+{
+	char                         dir[PATH_MAX];
+	char                         queue_dir[PATH_MAX];
+	char                         bql_dir[PATH_MAX];
+	struct procenv_dir_entries   entries;
+	int                          i;
+	const char                  *rx_files[] = { "rps_flow_cnt", NULL };
+	const char                  *bql_files[] = {
+		"limit",
+		"limit_max",
+		"limit_min",
+		"inflight",
+		"hold_time",
+		NULL
+	};
+
+	assert (interface);
+
+	sprintf (dir, "%s/%s/queues", PROCENV_SYS_NET_PATH, interface);
+
+	section_open ("queues");
+
+	entries.count = scandir (dir, &entries.names, NULL, versionsort);
+	if (entries.count < 0)
+		goto out;
+
+	track_memory (&entries, free_dir_entries);
+
+	for (i = 0; i < entries.count; i++) {
+		const char *name = entries.names[i]->d_name;
+
+		if (snprintf (queue_dir, sizeof (queue_dir), "%s/%s",
+					dir, name) >= (int)sizeof (queue_dir))
+			continue;
+
+		if (! strncmp (name, "rx-", 3)) {
+			section_open (name);
+			show_queue_cpus (queue_dir, "rps_cpus", "rps cpus", cs, max);
+			show_sysfs_values (queue_dir, rx_files, false);
+			section_close ();
+		} else if (! strncmp (name, "tx-", 3)) {
+			section_open (name);
+			show_queue_cpus (queue_dir, "xps_cpus", "xps cpus", cs, max);
+
+			section_open ("byte queue limits");
+			if (snprintf (bql_dir, sizeof (bql_dir), "%s/byte_queue_limits",
+						queue_dir) < (int)sizeof (bql_dir))
+				show_sysfs_values (bql_dir, bql_files, false);
+			section_close ();
+
+			section_close ();
+		}
+	}
+
+	free_tracked (&entries);
+
+out:
+	section_close ();
+}
+
+/**
+ * show_nic_linux:
+ *
+ * Display queue, RPS/XPS, ring, channel and offload details for all
+ * network interfaces. RPS/XPS CPU masks are cross-referenced
+ * against the CPU affinity of the process.
+ **/
+static void
+show_nic_linux (void)
+{
+	char                         path[PATH_MAX];
+	char                         link[PATH_MAX];
+	struct procenv_dir_entries   entries;
+	PROCENV_CPU_SET_TYPE        *cs;
+	const char                  *interface;
+	const char                  *driver;
+	ssize_t                      len;
+	long                         max;
+	int                          sock;
+	int                          i;
+
+	cs = get_cpuset_linux ();
+	track_memory (cs, release_cpuset);
+
+	max = get_sysconf (_SC_NPROCESSORS_ONLN);
+
+	sock = track_fd (socket (AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0));
+
+	entries.count = scandir (PROCENV_SYS_NET_PATH, &entries.names, NULL, alphasort);
+	if (entries.count < 0)
+		goto out;
+
+	track_memory (&entries, free_dir_entries);
+
+	for (i = 0; i < entries.count; i++) {
+		interface = entries.names[i]->d_name;
+
+		if (interface[0] == '.')
+			continue;
+
+		section_open (interface);
+
+		sprintf (path, "%s/%s/device/driver", PROCENV_SYS_NET_PATH, interface);
+
+		len = readlink (path, link, sizeof (link) - 1);
+		if (len > 0) {
+			link[len] = '\0';
+			driver = strrchr (link, '/');
+			driver = driver ? driver + 1 : link;
+		} else {
+			driver = NA_STR;
+		}
+
+		entry ("driver", "%s", driver);
+
+		if (sock >= 0) {
+			show_nic_channels (sock, interface);
+			show_nic_rings (sock, interface);
+			show_nic_offloads (sock, interface);
+		}
+
+		show_nic_queues (interface, cs, max);
+
+		section_close ();
+	}
+
+	free_tracked (&entries);
+
+out:
+	if (sock >= 0)
+		close_tracked (sock);
+
+	free_tracked (cs);
+}
+
+/* Maximum length of a GNU build-id (SHA1 is 20 bytes, but allow
+ * for longer hashes).
+ */
+#define PROCENV_MAX_BUILD_ID_LEN 64
+
+struct procenv_lib {
+	char           *name;
+	char           *path;
+	ElfW(Addr)      address;
+
+	/* hex string */
+	char            build_id[(PROCENV_MAX_BUILD_ID_LEN * 2) + 1];
+
+	unsigned long   load_size;
+	unsigned long   writable_size;
+	unsigned long   relro_size;
+	unsigned long   tls_size;
+
+	unsigned long   relocs;
+	unsigned long   relative_relocs;
+	unsigned long   plt_relocs;
+
+	unsigned long   symbols;
+	bool            have_symbols;
+
+	bool            bind_now;
+
+	unsigned long   pages;
+	unsigned long   resident_pages;
+	bool            have_residency;
+};
+
+struct procenv_libs {
+	struct procenv_lib  *libs;
+	size_t               count;
+	size_t               size;
+
+	/* Set if memory could not be allocated */
+	bool                 failed;
+};
+
+/**
+ * get_dyn_ptr:
+ *
+ * @info: library details,
+ * @ptr: value of a pointer-valued dynamic entry.
+ *
+ * The dynamic linker relocates pointer-valued dynamic entries
+ * in-place on most architectures, but not all (and not for a
+ * read-only dynamic section such as that of the vDSO).
+ *
+ * Returns: address corresponding to @ptr.
+ **/
+static const void *
+get_dyn_ptr (const struct dl_phdr_info *info, ElfW(Addr) ptr)
+{
+	assert (info);
+
+	if (ptr < info->dlpi_addr)
+		ptr += info->dlpi_addr;
+
+	return (const void *)ptr;
+}
+
+/**
+ * get_gnu_hash_symbols:
+ *
+ * @hash: DT_GNU_HASH table.
+ *
+ * Returns: number of symbols in the dynamic symbol table.
+ **/
+static unsigned long
+get_gnu_hash_symbols (const uint32_t *hash)
+{
+	uint32_t          nbuckets;
+	uint32_t          symoffset;
+	uint32_t          bloom_size;
+	const uint32_t   *buckets;
+	const uint32_t   *chain;
+	uint32_t          last = 0;
+	uint32_t          i;
+
+	assert (hash);
+
+	nbuckets = hash[0];
+	symoffset = hash[1];
+	bloom_size = hash[2];
+
+	buckets = (const uint32_t *)((const ElfW(Addr) *)(hash + 4) + bloom_size);
+	chain = buckets + nbuckets;
+
+	for (i = 0; i < nbuckets; i++) {
+		if (buckets[i] > last)
+			last = buckets[i];
+	}
+
+	if (last < symoffset)
+		return symoffset;
+
+	/* Walk the last chain until the terminator is found */
+	while (! (chain[last - symoffset] & 1))
+		last++;
+
+	return last + 1;
+}
+
+static void
+get_lib_dynamic (const struct dl_phdr_info *info, const ElfW(Dyn) *dyn,
+		struct procenv_lib *lib)
+{
+	unsigned long  rel_size = 0;
+	unsigned long  rel_ent = sizeof (ElfW(Rel));
+	unsigned long  rela_size = 0;
+	unsigned long  rela_ent = sizeof (ElfW(Rela));
+	unsigned long  plt_size = 0;
+	unsigned long  plt_type = DT_RELA;
+	const void    *gnu_hash = NULL;
+	const void    *hash = NULL;
+#if defined (DT_RELR)
+	const ElfW(Addr) *relr = NULL;
+	unsigned long  relr_size = 0;
+	unsigned long  i;
+	ElfW(Addr)     bits;
+#endif
+
+	assert (info);
+	assert (dyn);
+	assert (lib);
+
+	for (; dyn->d_tag != DT_NULL; dyn++) {
+		switch (dyn->d_tag) {
+		case DT_RELSZ:
+			rel_size = dyn->d_un.d_val;
+			break;
+
+		case DT_RELENT:
+			rel_ent = dyn->d_un.d_val;
+			break;
+
+		case DT_RELASZ:
+			rela_size = dyn->d_un.d_val;
+			break;
+
+		case DT_RELAENT:
+			rela_ent = dyn->d_un.d_val;
+			break;
+
+		case DT_RELCOUNT:
+		case DT_RELACOUNT:
+			lib->relative_relocs += dyn->d_un.d_val;
+			break;
+
+		case DT_PLTRELSZ:
+			plt_size = dyn->d_un.d_val;
+			break;
+
+#if defined (DT_RELR)
+		case DT_RELR:
+			relr = get_dyn_ptr (info, dyn->d_un.d_ptr);
+			break;
+
+		case DT_RELRSZ:
+			relr_size = dyn->d_un.d_val;
+			break;
+#endif
+
+		case DT_PLTREL:
+			plt_type = dyn->d_un.d_val;
+			break;
+
+		case DT_GNU_HASH:
+			gnu_hash = get_dyn_ptr (info, dyn->d_un.d_ptr);
+			break;
+
+		case DT_HASH:
+			hash = get_dyn_ptr (info, dyn->d_un.d_ptr);
+			break;
+
+		case DT_BIND_NOW:
+			lib->bind_now = true;
+			break;
+
+		case DT_FLAGS:
+			if (dyn->d_un.d_val & DF_BIND_NOW)
+				lib->bind_now = true;
+			break;
+
+		case DT_FLAGS_1:
+			if (dyn->d_un.d_val & DF_1_NOW)
+				lib->bind_now = true;
+			break;
+		}
+	}
+
+	if (rel_ent)
+		lib->relocs += rel_size / rel_ent;
+
+	if (rela_ent)
+		lib->relocs += rela_size / rela_ent;
+
+#if defined (DT_RELR)
+	/* Packed relative relocations: even entries specify an address to
+	 * relocate, odd entries are a bitmap of subsequent words to
+	 * relocate.
+	 */
+	if (relr) {
+		for (i = 0; i < relr_size / sizeof (ElfW(Addr)); i++) {
+			if (! (relr[i] & 1)) {
+				lib->relative_relocs++;
+				continue;
+			}
+
+			for (bits = relr[i] >> 1; bits; bits >>= 1)
+				lib->relative_relocs += bits & 1;
+		}
+	}
+#endif
+
+	if (plt_size)
+		lib->plt_relocs = plt_size /
+			(plt_type == DT_REL ? sizeof (ElfW(Rel)) : sizeof (ElfW(Rela)));
+
+	if (gnu_hash) {
+		lib->symbols = get_gnu_hash_symbols (gnu_hash);
+		lib->have_symbols = true;
+	} else if (hash) {
+		/* nchain is the number of symbols */
+		lib->symbols = ((const uint32_t *)hash)[1];
+		lib->have_symbols = true;
+	}
+}
+
+static void
+get_lib_build_id (const struct dl_phdr_info *info, const ElfW(Phdr) *phdr,
+		struct procenv_lib *lib)
+{
+	const char          *p;
+	const char          *end;
+	const ElfW(Nhdr)    *note;
+	const unsigned char *desc;
+	size_t               i;
+	size_t               len;
+
+	assert (info);
+	assert (phdr);
+	assert (lib);
+
+	p = (const char *)(info->dlpi_addr + phdr->p_vaddr);
+	end = p + phdr->p_memsz;
+
+	while (p + sizeof (ElfW(Nhdr)) <= end) {
+		note = (const ElfW(Nhdr) *)p;
+
+		p += sizeof (ElfW(Nhdr));
+
+		/* name and descriptor are padded to 4 bytes */
+		desc = (const unsigned char *)p + ((note->n_namesz + 3) & ~3U);
+		p = (const char *)desc + ((note->n_descsz + 3) & ~3U);
+
+		if (p > end)
+			break;
+
+		if (note->n_type != NT_GNU_BUILD_ID
+				|| note->n_namesz != sizeof ("GNU")
+				|| memcmp (note + 1, "GNU", sizeof ("GNU")))
+			continue;
+
+		len = note->n_descsz;
+		if (len > PROCENV_MAX_BUILD_ID_LEN)
+			len = PROCENV_MAX_BUILD_ID_LEN;
+
+		for (i = 0; i < len; i++)
+			sprintf (lib->build_id + (i * 2), "%.2x", desc[i]);
+
+		return;
+	}
+}
+
+/**
+ * get_lib_residency:
+ *
+ * @info: library details,
+ * @phdr: PT_LOAD program header,
+ * @lib: library to update.
+ *
+ * Determine how many pages of the segment specified by @phdr are
+ * resident in memory.
+ **/
+static void
+get_lib_residency (const struct dl_phdr_info *info, const ElfW(Phdr) *phdr,
+		struct procenv_lib *lib)
+{
+	static long     page_size = 0;
+	uintptr_t       start;
+	uintptr_t       end;
+	size_t          pages;
+	size_t          i;
+	unsigned char  *vec;
+
+	assert (info);
+	assert (phdr);
+	assert (lib);
+
+	if (! page_size)
+		page_size = sysconf (_SC_PAGESIZE);
+
+	if (page_size <= 0 || ! phdr->p_memsz)
+		return;
+
+	start = (uintptr_t)(info->dlpi_addr + phdr->p_vaddr);
+	end = start + phdr->p_memsz;
+
+	start &= ~((uintptr_t)page_size - 1);
+	end = (end + (uintptr_t)page_size - 1) & ~((uintptr_t)page_size - 1);
+
+	pages = (end - start) / (size_t)page_size;
+
+	/* Called with the dynamic linker lock held, so cannot die() */
+	vec = malloc (pages);
+	if (! vec)
+		return;
+
+	if (mincore ((void *)start, end - start, vec) == 0) {
+		lib->pages += pages;
+
+		for (i = 0; i < pages; i++) {
+			if (vec[i] & 1)
+				lib->resident_pages++;
+		}
+
+		lib->have_residency = true;
+	}
+
+	free (vec);
+}
+
+static int
+libs_callback_linux (struct dl_phdr_info *info, size_t size, void *data)
+{
+	struct procenv_libs  *libs = data;
+	struct procenv_lib   *lib;
+	const ElfW(Phdr)     *phdr;
+	const char           *name;
+	int                   i;
+
+	assert (info);
+	assert (libs);
+
+	if (! info->dlpi_name || ! *info->dlpi_name)
+		return 0;
+
+	if (libs->count == libs->size) {
+		lib = realloc (libs->libs,
+				(libs->size ? libs->size * 2 : 16)
+				* sizeof (struct procenv_lib));
+		if (! lib) {
+			libs->failed = true;
+			return 1;
+		}
+
+		libs->libs = lib;
+		libs->size = libs->size ? libs->size * 2 : 16;
+	}
+
+	lib = &libs->libs[libs->count++];
+	memset (lib, '\0', sizeof (struct procenv_lib));
+
+	name = strrchr (info->dlpi_name, '/');
+	name = name ? name + 1 : info->dlpi_name;
+
+	lib->name = strdup (name);
+	lib->path = strdup (info->dlpi_name);
+	if (! lib->name || ! lib->path) {
+		libs->failed = true;
+		return 1;
+	}
+
+	lib->address = info->dlpi_addr;
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		phdr = &info->dlpi_phdr[i];
+
+		switch (phdr->p_type) {
+		case PT_LOAD:
+			lib->load_size += phdr->p_memsz;
+
+			if (phdr->p_flags & PF_W)
+				lib->writable_size += phdr->p_memsz;
+
+			get_lib_residency (info, phdr, lib);
+			break;
+
+		case PT_GNU_RELRO:
+			lib->relro_size += phdr->p_memsz;
+			break;
+
+		case PT_TLS:
+			lib->tls_size += phdr->p_memsz;
+			break;
+
+		case PT_NOTE:
+			if (! lib->build_id[0])
+				get_lib_build_id (info, phdr, lib);
+			break;
+
+		case PT_DYNAMIC:
+			get_lib_dynamic (info,
+					(const ElfW(Dyn) *)(info->dlpi_addr + phdr->p_vaddr),
+					lib);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int
+lib_compar (const void *a, const void *b)
+{
+	const struct procenv_lib *x = a;
+	const struct procenv_lib *y = b;
+	int                       ret;
+
+	ret = strcmp (x->name, y->name);
+
+	return ret ? ret : strcmp (x->path, y->path);
+}
+
+static void
+show_lib_linux (const struct procenv_lib *lib)
+{
+	assert (lib);
+
+	object_open (false);
+
+	section_open (lib->name);
+
+	entry ("path", "%s", lib->path);
+	entry ("address", "%p", (void *)lib->address);
+	entry ("build id", "%s", lib->build_id[0] ? lib->build_id : NA_STR);
+
+	mk_mem_section ("load size", lib->load_size);
+	mk_mem_section ("writable size", lib->writable_size);
+	mk_mem_section ("relro size", lib->relro_size);
+	mk_mem_section ("tls size", lib->tls_size);
+
+	section_open ("relocations");
+	entry ("count", "%lu", lib->relocs);
+	entry ("relative", "%lu", lib->relative_relocs);
+	entry ("plt", "%lu", lib->plt_relocs);
+	section_close ();
+
+	if (lib->have_symbols)
+		entry ("symbols", "%lu", lib->symbols);
+	else
+		entry ("symbols", "%s", UNKNOWN_STR);
+
+	entry ("bind now", "%s", lib->bind_now ? YES_STR : NO_STR);
+
+	section_open ("residency");
+	if (lib->have_residency) {
+		entry ("pages", "%lu", lib->pages);
+		entry ("resident pages", "%lu", lib->resident_pages);
+	} else {
+		entry ("pages", "%s", UNKNOWN_STR);
+		entry ("resident pages", "%s", UNKNOWN_STR);
+	}
+	section_close ();
+
+	section_close ();
+
+	object_close (false);
+}
+
+/**
+ * show_libs_linux:
+ *
+ * Display details of all loaded shared objects, sorted by name,
+ * followed by a summary of the totals.
+ *
+ * "bind now" reflects whether the object was linked to require
+ * immediate binding (or LD_BIND_NOW is set): the mode an object was
+ * dlopen(3)'d with is not available via dl_iterate_phdr(3).
+ **/
+static void
+free_libs_linux (void *data)
+{
+	struct procenv_libs  *libs = data;
+	size_t                i;
+
+	for (i = 0; i < libs->count; i++) {
+		free_if_set (libs->libs[i].name);
+		free_if_set (libs->libs[i].path);
+	}
+
+	free_if_set (libs->libs);
+}
+
+static void
+show_libs_linux (void)
+{
+	struct procenv_libs   libs;
+	struct procenv_lib    totals;
+	const char           *bind_now;
+	bool                  bind_now_env;
+	size_t                i;
+
+	memset (&libs, '\0', sizeof (libs));
+	memset (&totals, '\0', sizeof (totals));
+
+	bind_now = getenv ("LD_BIND_NOW");
+	bind_now_env = bind_now && *bind_now;
+
+	track_memory (&libs, free_libs_linux);
+
+	/* The callback stops the iteration rather than calling die()
+	 * since the dynamic linker lock is held for its duration.
+	 */
+	dl_iterate_phdr (libs_callback_linux, &libs);
+
+	if (libs.failed)
+		die ("failed to allocate space for libraries");
+
+	qsort (libs.libs, libs.count, sizeof (struct procenv_lib), lib_compar);
+
+	container_open ("list");
+
+	for (i = 0; i < libs.count; i++) {
+		struct procenv_lib *lib = &libs.libs[i];
+
+		if (bind_now_env)
+			lib->bind_now = true;
+
+		show_lib_linux (lib);
+
+		totals.load_size += lib->load_size;
+		totals.writable_size += lib->writable_size;
+		totals.relro_size += lib->relro_size;
+		totals.tls_size += lib->tls_size;
+		totals.relocs += lib->relocs;
+		totals.relative_relocs += lib->relative_relocs;
+		totals.plt_relocs += lib->plt_relocs;
+		totals.symbols += lib->symbols;
+		totals.pages += lib->pages;
+		totals.resident_pages += lib->resident_pages;
+	}
+
+	container_close ();
+
+	section_open ("summary");
+
+	entry ("count", "%lu", (unsigned long)libs.count);
+
+	mk_mem_section ("load size", totals.load_size);
+	mk_mem_section ("writable size", totals.writable_size);
+	mk_mem_section ("relro size", totals.relro_size);
+	mk_mem_section ("tls size", totals.tls_size);
+
+	section_open ("relocations");
+	entry ("count", "%lu", totals.relocs);
+	entry ("relative", "%lu", totals.relative_relocs);
+	entry ("plt", "%lu", totals.plt_relocs);
+	section_close ();
+
+	entry ("symbols", "%lu", totals.symbols);
+
+	section_open ("residency");
+	entry ("pages", "%lu", totals.pages);
+	entry ("resident pages", "%lu", totals.resident_pages);
+	section_close ();
+
+	section_close ();
+
+	free_tracked (&libs);
+}
+
+static bool
+in_vm_linux (void)
+{
+	const char *flags;
+
+	flags = get_cpu_flags_linux ();
+
+	return flags && cpu_flag_set (flags, "hypervisor");
+}
+
+#if defined (PROCENV_HAVE_CPUID)
+
+/* Performance-relevant feature flags, named as per /proc/cpuinfo and
+ * sorted by name.
+ */
+static struct procenv_cpuid_feature cpuid_feature_map[] = {
+	mk_cpuid_entry ("abm",                EXT_1, ECX,  5),
+	mk_cpuid_entry ("adx",                7_0,   EBX, 19),
+	mk_cpuid_entry ("aes",                1,     ECX, 25),
+	mk_cpuid_entry ("amx_bf16",           7_0,   EDX, 22),
+	mk_cpuid_entry ("amx_int8",           7_0,   EDX, 25),
+	mk_cpuid_entry ("amx_tile",           7_0,   EDX, 24),
+	mk_cpuid_entry ("avx",                1,     ECX, 28),
+	mk_cpuid_entry ("avx2",               7_0,   EBX,  5),
+	mk_cpuid_entry ("avx512_bf16",        7_1,   EAX,  5),
+	mk_cpuid_entry ("avx512_bitalg",      7_0,   ECX, 12),
+	mk_cpuid_entry ("avx512_fp16",        7_0,   EDX, 23),
+	mk_cpuid_entry ("avx512_vbmi2",       7_0,   ECX,  6),
+	mk_cpuid_entry ("avx512_vnni",        7_0,   ECX, 11),
+	mk_cpuid_entry ("avx512_vp2intersect",7_0,   EDX,  8),
+	mk_cpuid_entry ("avx512_vpopcntdq",   7_0,   ECX, 14),
+	mk_cpuid_entry ("avx512bw",           7_0,   EBX, 30),
+	mk_cpuid_entry ("avx512cd",           7_0,   EBX, 28),
+	mk_cpuid_entry ("avx512dq",           7_0,   EBX, 17),
+	mk_cpuid_entry ("avx512er",           7_0,   EBX, 27),
+	mk_cpuid_entry ("avx512f",            7_0,   EBX, 16),
+	mk_cpuid_entry ("avx512ifma",         7_0,   EBX, 21),
+	mk_cpuid_entry ("avx512pf",           7_0,   EBX, 26),
+	mk_cpuid_entry ("avx512vbmi",         7_0,   ECX,  1),
+	mk_cpuid_entry ("avx512vl",           7_0,   EBX, 31),
+	mk_cpuid_entry ("avx_vnni",           7_1,   EAX,  4),
+	mk_cpuid_entry ("bmi1",               7_0,   EBX,  3),
+	mk_cpuid_entry ("bmi2",               7_0,   EBX,  8),
+	mk_cpuid_entry ("clflushopt",         7_0,   EBX, 23),
+	mk_cpuid_entry ("clwb",               7_0,   EBX, 24),
+	mk_cpuid_entry ("cmov",               1,     EDX, 15),
+	mk_cpuid_entry ("invariant_tsc",      EXT_7, EDX,  8),
+	mk_cpuid_entry ("cx16",               1,     ECX, 13),
+	mk_cpuid_entry ("cx8",                1,     EDX,  8),
+	mk_cpuid_entry ("erms",               7_0,   EBX,  9),
+	mk_cpuid_entry ("f16c",               1,     ECX, 29),
+	mk_cpuid_entry ("fma",                1,     ECX, 12),
+	mk_cpuid_entry ("fma4",               EXT_1, ECX, 16),
+	mk_cpuid_entry ("fsgsbase",           7_0,   EBX,  0),
+	mk_cpuid_entry ("fsrm",               7_0,   EDX,  4),
+	mk_cpuid_entry ("fxsr",               1,     EDX, 24),
+	mk_cpuid_entry ("gfni",               7_0,   ECX,  8),
+	mk_cpuid_entry ("hle",                7_0,   EBX,  4),
+	mk_cpuid_entry ("ht",                 1,     EDX, 28),
+	mk_cpuid_entry ("hybrid_cpu",         7_0,   EDX, 15),
+	mk_cpuid_entry ("hypervisor",         1,     ECX, 31),
+	mk_cpuid_entry ("lahf_lm",            EXT_1, ECX,  0),
+	mk_cpuid_entry ("lm",                 EXT_1, EDX, 29),
+	mk_cpuid_entry ("mmx",                1,     EDX, 23),
+	mk_cpuid_entry ("movbe",              1,     ECX, 22),
+	mk_cpuid_entry ("movdir64b",          7_0,   ECX, 28),
+	mk_cpuid_entry ("movdiri",            7_0,   ECX, 27),
+	mk_cpuid_entry ("nx",                 EXT_1, EDX, 20),
+	mk_cpuid_entry ("osxsave",            1,     ECX, 27),
+	mk_cpuid_entry ("pclmulqdq",          1,     ECX,  1),
+	mk_cpuid_entry ("pdpe1gb",            EXT_1, EDX, 26),
+	mk_cpuid_entry ("popcnt",             1,     ECX, 23),
+	mk_cpuid_entry ("prefetchw",          EXT_1, ECX,  8),
+	mk_cpuid_entry ("rdrand",             1,     ECX, 30),
+	mk_cpuid_entry ("rdseed",             7_0,   EBX, 18),
+	mk_cpuid_entry ("rdtscp",             EXT_1, EDX, 27),
+	mk_cpuid_entry ("rtm",                7_0,   EBX, 11),
+	mk_cpuid_entry ("serialize",          7_0,   EDX, 14),
+	mk_cpuid_entry ("sha_ni",             7_0,   EBX, 29),
+	mk_cpuid_entry ("sse",                1,     EDX, 25),
+	mk_cpuid_entry ("sse2",               1,     EDX, 26),
+	mk_cpuid_entry ("sse3",               1,     ECX,  0),
+	mk_cpuid_entry ("sse4_1",             1,     ECX, 19),
+	mk_cpuid_entry ("sse4_2",             1,     ECX, 20),
+	mk_cpuid_entry ("sse4a",              EXT_1, ECX,  6),
+	mk_cpuid_entry ("ssse3",              1,     ECX,  9),
+	mk_cpuid_entry ("tsc",                1,     EDX,  4),
+	mk_cpuid_entry ("vaes",               7_0,   ECX,  9),
+	mk_cpuid_entry ("vpclmulqdq",         7_0,   ECX, 10),
+	mk_cpuid_entry ("waitpkg",            7_0,   ECX,  5),
+	mk_cpuid_entry ("xop",                EXT_1, ECX, 11),
+	mk_cpuid_entry ("xsave",              1,     ECX, 26),
+
+	{ NULL, 0, 0, 0 }
+};
+
+static void
+query_cpuid_leaves (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		char *vendor)
+{
+	unsigned int  max;
+	unsigned int  max_ext;
+	unsigned int *r;
+
+	memset (regs, 0, sizeof (unsigned int) * CPUID_LEAF_COUNT * CPUID_REG_COUNT);
+	vendor[0] = '\0';
+
+	max = __get_cpuid_max (0, NULL);
+	if (! max)
+		return;
+
+	r = regs[CPUID_LEAF_1];
+	__cpuid (0, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+
+	/* vendor string is returned in EBX, EDX, ECX (in that order) */
+	memcpy (vendor, &r[CPUID_EBX], 4);
+	memcpy (vendor + 4, &r[CPUID_EDX], 4);
+	memcpy (vendor + 8, &r[CPUID_ECX], 4);
+	vendor[12] = '\0';
+
+	__cpuid (1, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+
+	if (max >= 7) {
+		r = regs[CPUID_LEAF_7_0];
+		__cpuid_count (7, 0, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+
+		/* EAX reports the maximum sub-leaf */
+		if (r[CPUID_EAX] >= 1) {
+			r = regs[CPUID_LEAF_7_1];
+			__cpuid_count (7, 1, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+		}
+	}
+
+	max_ext = __get_cpuid_max (0x80000000, NULL);
+
+	if (max_ext >= 0x80000001) {
+		r = regs[CPUID_LEAF_EXT_1];
+		__cpuid (0x80000001, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+	}
+
+	if (max_ext >= 0x80000007) {
+		r = regs[CPUID_LEAF_EXT_7];
+		__cpuid (0x80000007, r[CPUID_EAX], r[CPUID_EBX], r[CPUID_ECX], r[CPUID_EDX]);
+	}
+}
+
+/**
+ * get_cpuid_leaves:
+ *
+ * @regs: array to fill with the register values of each leaf in
+ * CPUIDLeaf,
+ * @vendor: buffer of at least 13 bytes to hold the vendor string.
+ *
+ * Query all feature leaves. The CPU is only queried on the first
+ * call. Leaves not supported by the CPU are left zeroed.
+ **/
+static void
+get_cpuid_leaves (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		char *vendor)
+{
+	static unsigned int  cached_regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT];
+	static char          cached_vendor[13];
+	static bool          cached = false;
+
+	if (! cached) {
+		query_cpuid_leaves (cached_regs, cached_vendor);
+		cached = true;
+	}
+
+	memcpy (regs, cached_regs, sizeof (cached_regs));
+	memcpy (vendor, cached_vendor, sizeof (cached_vendor));
+}
+
+static bool
+cpuid_has_feature (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		const char *name)
+{
+	const struct procenv_cpuid_feature *f;
+
+	for (f = cpuid_feature_map; f->name; f++) {
+		if (! strcmp (f->name, name))
+			return regs[f->leaf][f->reg] & (1U << f->bit);
+	}
+
+	bug ("unknown cpuid feature '%s'", name);
+
+	/* compiler appeasement */
+	return false;
+}
+
+static bool
+cpuid_has_features (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		const char **names)
+{
+	const char **name;
+
+	for (name = names; name && *name; name++) {
+		if (! cpuid_has_feature (regs, *name))
+			return false;
+	}
+
+	return true;
+}
+
+static unsigned long long
+get_xcr0 (void)
+{
+	unsigned int eax;
+	unsigned int edx;
+
+	__asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+
+	return ((unsigned long long)edx << 32) | eax;
+}
+
+/**
+ * get_x86_64_level:
+ *
+ * @regs: cached cpuid leaves,
+ * @os_avx: true if the OS saves AVX state,
+ * @os_avx512: true if the OS saves AVX-512 state.
+ *
+ * Returns: x86-64 micro-architecture level (1-4) as defined by the
+ * x86-64 psABI.
+ **/
+static int
+get_x86_64_level (unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT],
+		bool os_avx, bool os_avx512)
+{
+	const char *v2[] = { "cx16", "lahf_lm", "popcnt", "sse3",
+		"sse4_1", "sse4_2", "ssse3", NULL };
+
+	const char *v3[] = { "avx", "avx2", "bmi1", "bmi2", "f16c",
+		"fma", "abm", "movbe", "osxsave", NULL };
+
+	const char *v4[] = { "avx512f", "avx512bw", "avx512cd",
+		"avx512dq", "avx512vl", NULL };
+
+	if (! cpuid_has_features (regs, v2))
+		return 1;
+
+	if (! os_avx || ! cpuid_has_features (regs, v3))
+		return 2;
+
+	if (! os_avx512 || ! cpuid_has_features (regs, v4))
+		return 3;
+
+	return 4;
+}
+
+#endif /* PROCENV_HAVE_CPUID */
+
+#if defined (__aarch64__)
+
+static struct procenv_map hwcap_map_linux[] = {
+#ifdef HWCAP_FP
+	mk_map_entry (HWCAP_FP),
+#endif
+#ifdef HWCAP_ASIMD
+	mk_map_entry (HWCAP_ASIMD),
+#endif
+#ifdef HWCAP_AES
+	mk_map_entry (HWCAP_AES),
+#endif
+#ifdef HWCAP_PMULL
+	mk_map_entry (HWCAP_PMULL),
+#endif
+#ifdef HWCAP_SHA1
+	mk_map_entry (HWCAP_SHA1),
+#endif
+#ifdef HWCAP_SHA2
+	mk_map_entry (HWCAP_SHA2),
+#endif
+#ifdef HWCAP_CRC32
+	mk_map_entry (HWCAP_CRC32),
+#endif
+#ifdef HWCAP_ATOMICS
+	mk_map_entry (HWCAP_ATOMICS),
+#endif
+#ifdef HWCAP_FPHP
+	mk_map_entry (HWCAP_FPHP),
+#endif
+#ifdef HWCAP_ASIMDHP
+	mk_map_entry (HWCAP_ASIMDHP),
+#endif
+#ifdef HWCAP_ASIMDRDM
+	mk_map_entry (HWCAP_ASIMDRDM),
+#endif
+#ifdef HWCAP_LRCPC
+	mk_map_entry (HWCAP_LRCPC),
+#endif
+#ifdef HWCAP_DCPOP
+	mk_map_entry (HWCAP_DCPOP),
+#endif
+#ifdef HWCAP_SHA3
+	mk_map_entry (HWCAP_SHA3),
+#endif
+#ifdef HWCAP_ASIMDDP
+	mk_map_entry (HWCAP_ASIMDDP),
+#endif
+#ifdef HWCAP_SHA512
+	mk_map_entry (HWCAP_SHA512),
+#endif
+#ifdef HWCAP_SVE
+	mk_map_entry (HWCAP_SVE),
+#endif
+#ifdef HWCAP_ASIMDFHM
+	mk_map_entry (HWCAP_ASIMDFHM),
+#endif
+#ifdef HWCAP_USCAT
+	mk_map_entry (HWCAP_USCAT),
+#endif
+#ifdef HWCAP_ILRCPC
+	mk_map_entry (HWCAP_ILRCPC),
+#endif
+#ifdef HWCAP_PACA
+	mk_map_entry (HWCAP_PACA),
+#endif
+
+	{ NULL, 0 }
+};
+
+static struct procenv_map hwcap2_map_linux[] = {
+#ifdef HWCAP2_SVE2
+	mk_map_entry (HWCAP2_SVE2),
+#endif
+#ifdef HWCAP2_SVEBITPERM
+	mk_map_entry (HWCAP2_SVEBITPERM),
+#endif
+#ifdef HWCAP2_BF16
+	mk_map_entry (HWCAP2_BF16),
+#endif
+#ifdef HWCAP2_I8MM
+	mk_map_entry (HWCAP2_I8MM),
+#endif
+#ifdef HWCAP2_RNG
+	mk_map_entry (HWCAP2_RNG),
+#endif
+#ifdef HWCAP2_BTI
+	mk_map_entry (HWCAP2_BTI),
+#endif
+#ifdef HWCAP2_MTE
+	mk_map_entry (HWCAP2_MTE),
+#endif
+#ifdef HWCAP2_SME
+	mk_map_entry (HWCAP2_SME),
+#endif
+
+	{ NULL, 0 }
+};
+
+#endif /* __aarch64__ */
+
+static struct procenv_map auxv_map_linux[] = {
+
+	mk_map_entry (AT_IGNORE),
+	mk_map_entry (AT_EXECFD),
+	mk_map_entry (AT_PHDR),
+	mk_map_entry (AT_PHENT),
+	mk_map_entry (AT_PHNUM),
+	mk_map_entry (AT_PAGESZ),
+	mk_map_entry (AT_BASE),
+	mk_map_entry (AT_FLAGS),
+	mk_map_entry (AT_ENTRY),
+	mk_map_entry (AT_NOTELF),
+	mk_map_entry (AT_UID),
+	mk_map_entry (AT_EUID),
+	mk_map_entry (AT_GID),
+	mk_map_entry (AT_EGID),
+	mk_map_entry (AT_CLKTCK),
+	mk_map_entry (AT_PLATFORM),
+	mk_map_entry (AT_HWCAP),
+#if defined (AT_FPUCW)
+	mk_map_entry (AT_FPUCW),
+#endif
+#if defined (AT_DCACHEBSIZE)
+	mk_map_entry (AT_DCACHEBSIZE),
+	mk_map_entry (AT_ICACHEBSIZE),
+	mk_map_entry (AT_UCACHEBSIZE),
+#endif
+#if defined (AT_IGNOREPPC)
+	mk_map_entry (AT_IGNOREPPC),
+#endif
+#if defined (AT_SECURE)
+	mk_map_entry (AT_SECURE),
+#endif
+#if defined (AT_BASE_PLATFORM)
+	mk_map_entry (AT_BASE_PLATFORM),
+#endif
+#if defined (AT_RANDOM)
+	mk_map_entry (AT_RANDOM),
+#endif
+#if defined (AT_HWCAP2)
+	mk_map_entry (AT_HWCAP2),
+#endif
+#if defined (AT_RSEQ_FEATURE_SIZE)
+	mk_map_entry (AT_RSEQ_FEATURE_SIZE),
+	mk_map_entry (AT_RSEQ_ALIGN),
+#endif
+#if defined (AT_HWCAP3)
+	mk_map_entry (AT_HWCAP3),
+	mk_map_entry (AT_HWCAP4),
+#endif
+#if defined (AT_EXECFN)
+	mk_map_entry (AT_EXECFN),
+#endif
+#if defined (AT_SYSINFO)
+	mk_map_entry (AT_SYSINFO),
+#endif
+#if defined (AT_SYSINFO_EHDR)
+	mk_map_entry (AT_SYSINFO_EHDR),
+#endif
+#if defined (AT_L1I_CACHESHAPE)
+	mk_map_entry (AT_L1I_CACHESHAPE),
+	mk_map_entry (AT_L1D_CACHESHAPE),
+	mk_map_entry (AT_L2_CACHESHAPE),
+	mk_map_entry (AT_L3_CACHESHAPE),
+#endif
+#if defined (AT_L1I_CACHESIZE)
+	mk_map_entry (AT_L1I_CACHESIZE),
+	mk_map_entry (AT_L1I_CACHEGEOMETRY),
+	mk_map_entry (AT_L1D_CACHESIZE),
+	mk_map_entry (AT_L1D_CACHEGEOMETRY),
+	mk_map_entry (AT_L2_CACHESIZE),
+	mk_map_entry (AT_L2_CACHEGEOMETRY),
+	mk_map_entry (AT_L3_CACHESIZE),
+	mk_map_entry (AT_L3_CACHEGEOMETRY),
+#endif
+#if defined (AT_MINSIGSTKSZ)
+	mk_map_entry (AT_MINSIGSTKSZ),
+#endif
+
+	{ NULL, 0 }
+};
+
+static const char *
+get_auxv_name (unsigned long type)
+{
+	const struct procenv_map *p;
+
+	for (p = auxv_map_linux; p->name; p++) {
+		if (p->num == type)
+			return p->name;
+	}
+
+	return NULL;
+}
+
+/**
+ * show_auxv_entry:
+ *
+ * @type: AT_* type of auxiliary vector entry,
+ * @value: value of entry.
+ *
+ * Display a single auxiliary vector entry, formatting the value
+ * according to its type.
+ **/
+static void
+show_auxv_entry (unsigned long type, unsigned long value)
+{
+	const char *name;
+	char        unknown[32];
+
+	name = get_auxv_name (type);
+	if (! name) {
+		sprintf (unknown, "AT_%lu", type);
+		name = unknown;
+	}
+
+	object_open (false);
+
+	switch (type) {
+
+	/* Strings in this process's address space */
+	case AT_PLATFORM:
+#if defined (AT_BASE_PLATFORM)
+	case AT_BASE_PLATFORM:
+#endif
+#if defined (AT_EXECFN)
+	case AT_EXECFN:
+#endif
+		entry (name, "%s", value ? (const char *)value : NA_STR);
+		break;
+
+	/* Addresses and bitmasks.
+	 *
+	 * Note that only the address of the AT_RANDOM bytes is shown
+	 * since they seed the stack protector and pointer guard.
+	 */
+	case AT_PHDR:
+	case AT_BASE:
+	case AT_ENTRY:
+	case AT_FLAGS:
+	case AT_HWCAP:
+#if defined (AT_HWCAP2)
+	case AT_HWCAP2:
+#endif
+#if defined (AT_HWCAP3)
+	case AT_HWCAP3:
+	case AT_HWCAP4:
+#endif
+#if defined (AT_RANDOM)
+	case AT_RANDOM:
+#endif
+#if defined (AT_SYSINFO)
+	case AT_SYSINFO:
+#endif
+#if defined (AT_SYSINFO_EHDR)
+	case AT_SYSINFO_EHDR:
+#endif
+		entry (name, "0x%lx", value);
+		break;
+
+	default:
+		entry (name, "%lu", value);
+		break;
+	}
+
+	object_close (false);
+}
+
+#define PROCENV_AUXV_PATH "/proc/self/auxv"
+
+/**
+ * read_auxv_linux:
+ *
+ * @buffer: buffer to write the auxiliary vector to,
+ * @len: size of @buffer in bytes.
+ *
+ * Read the auxiliary vector passed to the process by the kernel.
+ *
+ * Returns: number of bytes read, or zero if PROCENV_AUXV_PATH is
+ * not available.
+ **/
+static size_t
+read_auxv_linux (unsigned long *buffer, size_t len)
+{
+	ssize_t  ret;
+	size_t   bytes = 0;
+	int      fd;
+
+	assert (buffer);
+
+	fd = open (PROCENV_AUXV_PATH, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	while (bytes < len) {
+		ret = read (fd, (char *)buffer + bytes, len - bytes);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		bytes += (size_t)ret;
+	}
+
+	close (fd);
+
+	return bytes;
+}
+
+/**
+ * get_auxv_value_linux:
+ *
+ * @type: AT_* type to look up.
+ *
+ * Obtain the value the kernel passed for @type, as displayed by
+ * show_auxv_linux(). getauxval(3) is only used if the vector cannot
+ * be read since on some architectures (such as x86), glibc returns
+ * its own value for AT_HWCAP rather than the kernel's.
+ *
+ * Returns: value of @type, or zero if not set.
+ **/
+static unsigned long
+get_auxv_value_linux (unsigned long type)
+{
+	unsigned long        buffer[PROCENV_BUFFER];
+	const unsigned long *p;
+	const unsigned long *end;
+	size_t               bytes;
+
+	bytes = read_auxv_linux (buffer, sizeof (buffer));
+	if (! bytes)
+		return getauxval (type);
+
+	end = buffer + (bytes / sizeof (unsigned long));
+
+	for (p = buffer; p + 1 < end && p[0] != AT_NULL; p += 2) {
+		if (p[0] == type)
+			return p[1];
+	}
+
+	return 0;
+}
+
+/**
+ * show_auxv_linux:
+ *
+ * Display the ELF auxiliary vector passed to the process by the
+ * kernel. The vector is read in full from /proc/self/auxv; if that
+ * is not available, each known type is queried using getauxval(3).
+ **/
+static void
+show_auxv_linux (void)
+{
+	unsigned long        buffer[PROCENV_BUFFER];
+	const unsigned long *p;
+	const unsigned long *end;
+	const struct procenv_map *m;
+	size_t               bytes;
+	unsigned long        vdso = 0;
+	unsigned long        value;
+	bool                 seen_vdso = false;
+
+	bytes = read_auxv_linux (buffer, sizeof (buffer));
+
+	entry ("source", "%s", bytes ? PROCENV_AUXV_PATH : "getauxval");
+
+	container_open ("entries");
+
+	if (bytes) {
+		end = buffer + (bytes / sizeof (unsigned long));
+
+		for (p = buffer; p + 1 < end && p[0] != AT_NULL; p += 2) {
+#if defined (AT_SYSINFO_EHDR)
+			if (p[0] == AT_SYSINFO_EHDR) {
+				seen_vdso = true;
+				vdso = p[1];
+			}
+#endif
+			show_auxv_entry (p[0], p[1]);
+		}
+	} else {
+		for (m = auxv_map_linux; m->name; m++) {
+			errno = 0;
+			value = getauxval (m->num);
+			if (! value && errno == ENOENT)
+				continue;
+
+#if defined (AT_SYSINFO_EHDR)
+			if (m->num == AT_SYSINFO_EHDR) {
+				seen_vdso = true;
+				vdso = value;
+			}
+#endif
+			show_auxv_entry (m->num, value);
+		}
+	}
+
+	container_close ();
+
+	/* Without a vDSO, every clock_gettime(2) and gettimeofday(2)
+	 * call results in a real system call.
+	 */
+	entry ("vdso", "%s", seen_vdso && vdso ? YES_STR : NO_STR);
+}
+
+/**
+ * show_instruction_set_linux:
+ *
+ * Display the instruction set features of the CPU. On x86, these
+ * are obtained directly using cpuid(1) (which avoids having to
+ * parse /proc/cpuinfo, which can be huge on large systems); on
+ * other architectures, the hardware capability bits the kernel
+ * passes in the auxiliary vector are used.
+ **/
+static void
+show_instruction_set_linux (void)
+{
+	unsigned long hwcap;
+	unsigned long hwcap2 = 0;
+	const char *str;
+
+#if defined (PROCENV_HAVE_CPUID)
+	unsigned int regs[CPUID_LEAF_COUNT][CPUID_REG_COUNT];
+	const struct procenv_cpuid_feature *f;
+	char vendor[13];
+	bool os_avx = false;
+	bool os_avx512 = false;
+	unsigned long long xcr0 = 0;
+#endif
+
+#if defined (__aarch64__)
+	const struct procenv_map *p;
+#endif
+
+	str = (const char *)getauxval (AT_PLATFORM);
+	entry ("platform", "%s", str ? str : UNKNOWN_STR);
+
+#if defined (AT_BASE_PLATFORM)
+	str = (const char *)getauxval (AT_BASE_PLATFORM);
+	entry ("base platform", "%s", str ? str : UNKNOWN_STR);
+#endif
+
+	hwcap = get_auxv_value_linux (AT_HWCAP);
+	entry ("hwcap", "0x%lx", hwcap);
+
+#if defined (AT_HWCAP2)
+	hwcap2 = get_auxv_value_linux (AT_HWCAP2);
+	entry ("hwcap2", "0x%lx", hwcap2);
+#endif
+
+#if defined (PROCENV_HAVE_CPUID)
+
+	get_cpuid_leaves (regs, vendor);
+
+	entry ("vendor", "%s", vendor[0] ? vendor : UNKNOWN_STR);
+
+	if (cpuid_has_feature (regs, "osxsave")) {
+		xcr0 = get_xcr0 ();
+		os_avx = (xcr0 & PROCENV_XCR0_AVX) == PROCENV_XCR0_AVX;
+		os_avx512 = (xcr0 & PROCENV_XCR0_AVX512) == PROCENV_XCR0_AVX512;
+	}
+
+	entry ("xcr0", "0x%llx", xcr0);
+	entry ("os avx support", "%s", os_avx ? YES_STR : NO_STR);
+	entry ("os avx-512 support", "%s", os_avx512 ? YES_STR : NO_STR);
+
+#if defined (__x86_64__)
+	{
+		int level = get_x86_64_level (regs, os_avx, os_avx512);
+
+		entry ("x86-64 level", "x86-64-v%d", level);
+
+		/* The dynamic loader searches the glibc-hwcaps
+		 * subdirectory for the highest supported level first
+		 * (there is no subdirectory for the baseline).
+		 */
+		if (level > 1)
+			entry ("glibc-hwcaps", "x86-64-v%d", level);
+		else
+			entry ("glibc-hwcaps", "%s", NA_STR);
+	}
+#else
+	entry ("x86-64 level", "%s", NA_STR);
+	entry ("glibc-hwcaps", "%s", NA_STR);
+#endif
+
+	section_open ("features");
+
+	for (f = cpuid_feature_map; f->name; f++) {
+		entry (f->name, "%s",
+				regs[f->leaf][f->reg] & (1U << f->bit)
+				? YES_STR : NO_STR);
+	}
+
+	section_close ();
+
+#else /* ! PROCENV_HAVE_CPUID */
+
+	entry ("glibc-hwcaps", "%s", NA_STR);
+
+	section_open ("features");
+
+#if defined (__aarch64__)
+	for (p = hwcap_map_linux; p->name; p++)
+		entry (p->name, "%s", hwcap & p->num ? YES_STR : NO_STR);
+
+	for (p = hwcap2_map_linux; p->name; p++)
+		entry (p->name, "%s", hwcap2 & p->num ? YES_STR : NO_STR);
+#else
+	/* Architecture-specific hwcap bits are not decoded */
+	(void)hwcap2;
+#endif
+
+	section_close ();
 
-	return result;
+#endif /* PROCENV_HAVE_CPUID */
 }
 
 struct procenv_ops platform_ops =
@@ -2270,6 +6267,7 @@ struct procenv_ops platform_ops =
 	.personality_map               = personality_map_linux,
 	.personality_flag_map          = personality_flag_map_linux,
 
+	.show_auxv                     = show_auxv_linux,
 	.show_capabilities             = show_capabilities_linux,
 	.show_cgroups                  = show_cgroups_linux,
 	.show_confstrs                 = show_confstrs_generic,
@@ -2278,23 +6276,30 @@ struct procenv_ops platform_ops =
 
 	.show_cpu                      = show_cpu_linux,
 	.show_clocks                   = show_clocks_generic,
+	.show_clock_probe              = show_clock_probe_linux,
 	.show_extended_if_flags        = show_extended_if_flags_linux,
 	.show_fds                      = show_fds_linux,
+	.show_hugepages                = show_hugepages_linux,
+	.show_instruction_set          = show_instruction_set_linux,
 	.show_io_priorities            = show_io_priorities_linux,
 	.show_mounts                   = show_mounts_generic_linux,
 	.show_msg_queues               = show_msg_queues_linux,
 	.show_namespaces               = show_namespaces_linux,
+	.show_network_interfaces       = show_network_interfaces_linux,
+	.show_nic                      = show_nic_linux,
 	.show_oom                      = show_oom_linux,
 	.show_prctl                    = show_prctl_linux,
 	.show_rlimits                  = show_rlimits_linux,
 	.show_security_module          = show_security_module_linux,
 	.show_semaphores               = show_semaphores_linux,
 	.show_shared_mem               = show_shared_mem_linux,
+	.show_thread_scheduling        = show_thread_scheduling_linux,
 	.show_timezone                 = show_timezone_generic,
-	.show_libs                     = show_libs_generic,
+	.show_libs                     = show_libs_linux,
 
-	.handle_memory                 = show_memory_generic,
+	.handle_memory                 = show_memory_linux,
 	.handle_numa_memory            = handle_numa_memory_linux,
+	.handle_process_memory         = handle_process_memory_linux,
 	.handle_proc_branch            = handle_proc_branch_linux,
 	.handle_scheduler_type         = handle_scheduler_type_linux,
 };
@@ -98,6 +98,167 @@ show_clocks_generic (void)
 #endif
 }
 
+#if defined (CLOCK_MONOTONIC)
+
+/* Number of timed samples taken when probing the cost of reading a
+ * clock. Each sample times a batch of calls to reduce the effect of
+ * the overhead of the timing calls themselves.
+ */
+#define PROCENV_CLOCK_PROBE_SAMPLES          1001
+#define PROCENV_CLOCK_PROBE_SYSCALL_SAMPLES  101
+#define PROCENV_CLOCK_PROBE_BATCH            16
+
+static int
+uint64_compar (const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static uint64_t
+timespec_to_ns (const struct timespec *ts)
+{
+	return ((uint64_t)ts->tv_sec * 1000000000) + (uint64_t)ts->tv_nsec;
+}
+
+/**
+ * measure_clock_cost:
+ *
+ * @clock: clock to read,
+ * @use_syscall: if true, read @clock using the system call directly
+ *   (bypassing any vDSO implementation),
+ * @samples: number of samples to take,
+ * @median: set to median cost of a single read in nanoseconds,
+ * @p99: set to 99th percentile cost of a single read in nanoseconds.
+ *
+ * Returns: true on success, else false.
+ **/
+static bool
+measure_clock_cost (clockid_t clock, bool use_syscall, size_t samples,
+		double *median, double *p99)
+{
+	struct timespec   start;
+	struct timespec   end;
+	struct timespec   ts;
+	uint64_t         *results;
+	size_t            i;
+	int               j;
+	int               ret = 0;
+
+	assert (samples);
+	assert (median);
+	assert (p99);
+
+#if ! defined (PROCENV_PLATFORM_LINUX) || ! defined (SYS_clock_gettime)
+	if (use_syscall)
+		return false;
+#endif
+
+	/* ensure the clock is usable before timing it */
+	if (clock_gettime (clock, &ts) < 0)
+		return false;
+
+	results = calloc (samples, sizeof (uint64_t));
+	if (! results)
+		die ("failed to allocate space for clock samples");
+
+	for (i = 0; i < samples; i++) {
+		if (clock_gettime (CLOCK_MONOTONIC, &start) < 0)
+			goto err;
+
+		for (j = 0; j < PROCENV_CLOCK_PROBE_BATCH; j++) {
+#if defined (PROCENV_PLATFORM_LINUX) && defined (SYS_clock_gettime)
+			if (use_syscall)
+				ret = (int)syscall (SYS_clock_gettime, clock, &ts);
+			else
+#endif
+				ret = clock_gettime (clock, &ts);
+		}
+
+		if (clock_gettime (CLOCK_MONOTONIC, &end) < 0 || ret < 0)
+			goto err;
+
+		results[i] = timespec_to_ns (&end) - timespec_to_ns (&start);
+	}
+
+	qsort (results, samples, sizeof (uint64_t), uint64_compar);
+
+	*median = (double)results[samples / 2] / PROCENV_CLOCK_PROBE_BATCH;
+	*p99 = (double)results[(samples * 99) / 100] / PROCENV_CLOCK_PROBE_BATCH;
+
+	free (results);
+
+	return true;
+
+err:
+	free (results);
+
+	return false;
+}
+
+/**
+ * show_clock_cost:
+ *
+ * @clock: clock to consider.
+ *
+ * Display the cost of reading the specified clock with
+ * clock_gettime(3), and whether the C library is able to satisfy
+ * the call without entering the kernel (using the vDSO).
+ **/
+void
+show_clock_cost (clockid_t clock)
+{
+	double       median;
+	double       p99;
+	double       syscall_median;
+	double       syscall_p99;
+	const char  *method = UNKNOWN_STR;
+
+	section_open ("cost");
+
+	if (! measure_clock_cost (clock, false,
+				PROCENV_CLOCK_PROBE_SAMPLES,
+				&median, &p99)) {
+		entry ("median", "%s", UNKNOWN_STR);
+		entry ("p99", "%s", UNKNOWN_STR);
+		goto out;
+	}
+
+	entry ("median", "%.1f ns", median);
+	entry ("p99", "%.1f ns", p99);
+
+	if (measure_clock_cost (clock, true,
+				PROCENV_CLOCK_PROBE_SYSCALL_SAMPLES,
+				&syscall_median, &syscall_p99)) {
+
+		entry ("syscall median", "%.1f ns", syscall_median);
+
+		/* A vDSO read avoids the kernel entry and exit so is
+		 * significantly cheaper than the system call.
+		 */
+		method = (median * 2) < syscall_median ? "vdso" : "syscall";
+	}
+
+out:
+	entry ("method", "%s", method);
+
+	section_close ();
+}
+
+#else /* ! CLOCK_MONOTONIC */
+
+void
+show_clock_cost (clockid_t clock)
+{
+	section_open ("cost");
+	entry ("method", "%s", UNKNOWN_STR);
+	section_close ();
+}
+
+#endif /* CLOCK_MONOTONIC */
+
 long
 get_kernel_bits_generic (void)
 {
@@ -490,6 +651,12 @@ show_confstrs_generic (void)
     defined (PROCENV_PLATFORM_BSD)   || \
     defined (PROCENV_PLATFORM_HURD)
 
+static void
+release_cpuset_generic (void *cpu_set)
+{
+	ops->free_cpuset (cpu_set);
+}
+
 /* Display cpu affinities in the same compressed but reasonably
  * human-readable fashion as /proc/self/status:Cpus_allowed_list under Linux.
  */
@@ -521,6 +688,9 @@ show_cpu_affinities_generic (void)
 	if (! cpu_set)
 		return;
 
+	if (ops->free_cpuset)
+		track_memory (cpu_set, release_cpuset_generic);
+
 	// FIXME: should be handled by get_cpuset()!!
 	max = get_sysconf (_SC_NPROCESSORS_ONLN);
 
@@ -567,7 +737,7 @@ show_cpu_affinities_generic (void)
 	entry ("affinity list", "%s", cpu_list ? cpu_list : "-1");
 
 	if (ops->free_cpuset)
-		ops->free_cpuset (cpu_set);
+		free_tracked (cpu_set);
 
 	free (cpu_list);
 }
@@ -959,6 +1129,30 @@ get_canonical_generic_linux (const char *path, char *canonical, size_t len)
 	return ret;
 }
 
+static void
+show_huge_page_size_generic_linux (struct mntent *mnt)
+{
+	const char *size;
+
+	assert (mnt);
+
+	size = hasmntopt (mnt, "pagesize");
+
+	if (size && (size = strchr (size, '=')))
+		entry ("huge page size", "%.*s",
+				(int)strcspn (size + 1, ","), size + 1);
+	else
+		entry ("huge page size", "%s", UNKNOWN_STR);
+}
+
+/**
+ * show_mounts_generic_linux:
+ *
+ * @what: details to display.
+ *
+ * Walk the mount table. SHOW_HUGETLBFS displays only hugetlbfs
+ * mounts, as objects for the "mounts" container of --hugepages.
+ **/
 void
 show_mounts_generic_linux (ShowMountType what)
 {
@@ -970,7 +1164,7 @@ show_mounts_generic_linux (ShowMountType what)
 	int              have_stats;
 	char             canonical[PATH_MAX];
 
-	mtab = fopen (MOUNTS, "r");
+	mtab = fopen_tracked (MOUNTS, "r");
 
 	if (! mtab)
 		return;
@@ -978,6 +1172,22 @@ show_mounts_generic_linux (ShowMountType what)
 	while ((mnt = getmntent (mtab))) {
 		have_stats = true;
 
+		if (what == SHOW_HUGETLBFS) {
+			if (strcmp (mnt->mnt_type, "hugetlbfs"))
+				continue;
+
+			object_open (false);
+			section_open (mnt->mnt_dir);
+
+			show_huge_page_size_generic_linux (mnt);
+			entry ("options", "'%s'", mnt->mnt_opts);
+
+			section_close ();
+			object_close (false);
+
+			continue;
+		}
+
 		if (what == SHOW_ALL || what == SHOW_MOUNTS) {
 			unsigned multiplier = 0;
 			fsblkcnt_t blocks = 0;
@@ -1017,6 +1227,9 @@ show_mounts_generic_linux (ShowMountType what)
 			entry ("type", "'%s'", mnt->mnt_type);
 			entry ("options", "'%s'", mnt->mnt_opts);
 
+			if (! strcmp (mnt->mnt_type, "hugetlbfs"))
+				show_huge_page_size_generic_linux (mnt);
+
 			show_pathconfs (what, mnt->mnt_dir);
 
 			section_open ("device");
@@ -1091,7 +1304,7 @@ show_mounts_generic_linux (ShowMountType what)
 		}
 	}
 
-	fclose (mtab);
+	fclose_tracked (mtab);
 }
 
 #endif /* PROCENV_PLATFORM_LINUX || PROCENV_PLATFORM_HURD */
@@ -1158,7 +1371,9 @@ libs_callback (struct dl_phdr_info *info, size_t size, void *data)
 void
 show_libs_generic(void)
 {
+	container_open ("list");
 	dl_iterate_phdr (libs_callback, NULL);
+	container_close ();
 }
 
 #endif
@@ -62,6 +62,7 @@ void show_memory_generic (void);
 #endif
 
 void show_clocks_generic (void);
+void show_clock_cost (clockid_t clock);
 
 #if defined (PROCENV_PLATFORM_LINUX) || defined (PROCENV_PLATFORM_BSD) || defined (PROCENV_PLATFORM_DARWIN)
 
@@ -10,6 +10,15 @@
 #include <pr_list.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+
+/* Number of partial results maintained by pr_list_sort(): enough to
+ * sort a list of any length that can be addressed.
+ */
+#define PR_LIST_SORT_BINS (sizeof (size_t) * CHAR_BIT)
+
+/* Alignment of allocations made from a PRListPool */
+#define PR_LIST_POOL_ALIGN (sizeof (void *))
 
 /**
  * pr_list_new:
@@ -317,6 +326,297 @@ pr_list_remove (PRList *entry)
 	return entry;
 }
 
+/**
+ * pr_list_merge:
+ *
+ * @a: NULL-terminated singly-linked run of entries,
+ * @b: NULL-terminated singly-linked run of entries,
+ * @cmp: comparison function.
+ *
+ * Merge the sorted runs @a and @b (only the next pointers are
+ * considered). Where entries compare equal, those from @a are placed
+ * first such that the sort is stable.
+ *
+ * Returns: Merged NULL-terminated run.
+ **/
+static PRList *
+pr_list_merge (PRList *a, PRList *b, PRListCmp cmp)
+{
+	PRList   head;
+	PRList  *tail = &head;
+
+	while (a && b) {
+		if (cmp (b, a) < 0) {
+			tail->next = b;
+			b = b->next;
+		} else {
+			tail->next = a;
+			a = a->next;
+		}
+
+		tail = tail->next;
+	}
+
+	tail->next = a ? a : b;
+
+	return head.next;
+}
+
+/**
+ * pr_list_sort:
+ *
+ * @list: list to operate on,
+ * @cmp: comparison function.
+ *
+ * Stable sort of all entries in @list (excluding @list itself) into
+ * ascending order using a bottom-up merge sort.
+ *
+ * Building a sorted list by adding all entries unsorted and then
+ * calling this function once is O(n log n), whereas adding each entry
+ * using pr_list_prepend_sorted() is O(n^2).
+ **/
+void
+pr_list_sort (PRList *list, PRListCmp cmp)
+{
+	PRList  *bins[PR_LIST_SORT_BINS] = { NULL };
+	PRList  *p;
+	PRList  *next;
+	PRList  *prev;
+	size_t   i;
+
+	assert (list);
+	assert (cmp);
+
+	if (list->next == list || list->next == list->prev)
+		return;
+
+	/* Break the ring to form a NULL-terminated singly-linked list */
+	list->prev->next = NULL;
+
+	/* bins[i] holds a sorted run of 2^i entries (or is empty) and
+	 * contains entries that appeared earlier than those in bins[i-1].
+	 */
+	for (p = list->next; p; p = next) {
+		next = p->next;
+		p->next = NULL;
+
+		for (i = 0; i < PR_LIST_SORT_BINS - 1 && bins[i]; i++) {
+			p = pr_list_merge (bins[i], p, cmp);
+			bins[i] = NULL;
+		}
+
+		bins[i] = bins[i] ? pr_list_merge (bins[i], p, cmp) : p;
+	}
+
+	for (p = NULL, i = 0; i < PR_LIST_SORT_BINS; i++) {
+		if (bins[i])
+			p = pr_list_merge (bins[i], p, cmp);
+	}
+
+	/* Restore the prev pointers and the ring */
+	list->next = p;
+
+	for (prev = list; p; prev = p, p = p->next)
+		p->prev = prev;
+
+	prev->next = list;
+	list->prev = prev;
+}
+
+/**
+ * pr_list_sort_str:
+ *
+ * @list: list to operate on.
+ *
+ * Sort all entries in @list by their string data.
+ **/
+void
+pr_list_sort_str (PRList *list)
+{
+	pr_list_sort (list, pr_list_cmp_str);
+}
+
+/**
+ * pr_list_pool_new:
+ *
+ * Create a new allocator for list entries.
+ *
+ * Returns: New PRListPool or NULL on error.
+ **/
+PRListPool *
+pr_list_pool_new (void)
+{
+	PRListPool *pool;
+
+	pool = (PRListPool *)calloc (1, sizeof (PRListPool));
+	if (! pool)
+		return NULL;
+
+	pool->chunk_size = PR_LIST_POOL_CHUNK_SIZE;
+
+	return pool;
+}
+
+/**
+ * pr_list_pool_free:
+ *
+ * @pool: pool to free.
+ *
+ * Free @pool along with all entries and strings allocated from it.
+ **/
+void
+pr_list_pool_free (PRListPool *pool)
+{
+	PRListPoolChunk *chunk;
+	PRListPoolChunk *next;
+
+	if (! pool)
+		return;
+
+	for (chunk = pool->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free (chunk);
+	}
+
+	free (pool);
+}
+
+/**
+ * pr_list_pool_alloc:
+ *
+ * @pool: pool to allocate from,
+ * @size: number of bytes required.
+ *
+ * Returns: Pointer to @size bytes of memory owned by @pool, or NULL
+ * on error.
+ **/
+static void *
+pr_list_pool_alloc (PRListPool *pool, size_t size)
+{
+	PRListPoolChunk  *chunk;
+	size_t            chunk_size;
+	void             *p;
+
+	assert (pool);
+
+	size = (size + PR_LIST_POOL_ALIGN - 1) & ~(PR_LIST_POOL_ALIGN - 1);
+
+	chunk = pool->chunks;
+
+	if (! chunk || chunk->size - chunk->used < size) {
+		chunk_size = size > pool->chunk_size ? size : pool->chunk_size;
+
+		chunk = malloc (sizeof (PRListPoolChunk) + chunk_size);
+		if (! chunk)
+			return NULL;
+
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		if (pool->chunks && chunk_size > pool->chunk_size) {
+			/* Oversized request, so retain the current chunk
+			 * for subsequent allocations.
+			 */
+			chunk->next = pool->chunks->next;
+			pool->chunks->next = chunk;
+		} else {
+			chunk->next = pool->chunks;
+			pool->chunks = chunk;
+		}
+	}
+
+	p = (char *)chunk->data + chunk->used;
+	chunk->used += size;
+
+	return p;
+}
+
+/**
+ * pr_list_pool_new_entry:
+ *
+ * @pool: pool to allocate from,
+ * @data: data pointer to store in node.
+ *
+ * Create a new list entry whose memory is owned by @pool. The entry
+ * must not be passed to free().
+ *
+ * Returns: New PRList or NULL on error.
+ **/
+PRList *
+pr_list_pool_new_entry (PRListPool *pool, void *data)
+{
+	PRList *entry;
+
+	entry = pr_list_pool_alloc (pool, sizeof (PRList));
+	if (! entry)
+		return NULL;
+
+	entry->next = entry->prev = entry;
+	entry->data = data;
+
+	return entry;
+}
+
+/**
+ * pr_list_pool_prepend_str:
+ *
+ * @pool: pool to allocate from,
+ * @list: list to operate on,
+ * @str: string value to add to new entry.
+ *
+ * Create entry containing a copy of @str, both owned by @pool, and
+ * add it before @list.
+ *
+ * Returns: New entry or NULL on error.
+ **/
+PRList *
+pr_list_pool_prepend_str (PRListPool *pool, PRList *list, const char *str)
+{
+	assert (str);
+
+	return pr_list_pool_prependn_str (pool, list, str, strlen (str));
+}
+
+/**
+ * pr_list_pool_prependn_str:
+ *
+ * @pool: pool to allocate from,
+ * @list: list to operate on,
+ * @str: string value to add to new entry,
+ * @len: length of @str to add to entry.
+ *
+ * Create entry containing a copy of the first @len bytes of @str,
+ * both owned by @pool, and add it before @list.
+ *
+ * Returns: New entry or NULL on error.
+ **/
+PRList *
+pr_list_pool_prependn_str (PRListPool *pool, PRList *list,
+		const char *str, size_t len)
+{
+	PRList  *entry;
+	char    *s;
+
+	assert (pool);
+	assert (list);
+	assert (str);
+
+	len = strnlen (str, len);
+
+	/* Allocate the entry and the string together */
+	entry = pr_list_pool_alloc (pool, sizeof (PRList) + len + 1);
+	if (! entry)
+		return NULL;
+
+	s = (char *)(entry + 1);
+	memcpy (s, str, len);
+	s[len] = '\0';
+
+	entry->data = s;
+
+	return pr_list_prepend (list, entry);
+}
+
 /**
  * pr_list_foreach_visit:
  *
@@ -31,6 +31,25 @@ typedef void (*PRListVisitor) (PRList *entry);
 
 typedef int (*PRListCmp) (PRList *a, PRList *b);
 
+/* Default size of each block of memory allocated by a PRListPool */
+#define PR_LIST_POOL_CHUNK_SIZE (64 * 1024)
+
+/* A block of memory owned by a PRListPool */
+typedef struct pr_list_pool_chunk {
+	struct pr_list_pool_chunk  *next;
+	size_t                      size;
+	size_t                      used;
+	void                       *data[];
+} PRListPoolChunk;
+
+/* Allocator for list entries (and the strings they hold) which are
+ * only ever freed together by calling pr_list_pool_free().
+ */
+typedef struct pr_list_pool {
+	PRListPoolChunk  *chunks;
+	size_t            chunk_size;
+} PRListPool;
+
 PRList *pr_list_new (void *data);
 
 PRList *pr_list_append (PRList *list, PRList *entry);
@@ -49,6 +68,18 @@ PRList *pr_list_append_sorted(PRList *list, PRList *entry, PRListCmp cmp);
 
 PRList *pr_list_remove (PRList *entry);
 
+int pr_list_cmp_str (PRList *la, PRList *lb);
+
+void pr_list_sort (PRList *list, PRListCmp cmp);
+void pr_list_sort_str (PRList *list);
+
+PRListPool *pr_list_pool_new (void);
+void pr_list_pool_free (PRListPool *pool);
+PRList *pr_list_pool_new_entry (PRListPool *pool, void *data);
+PRList *pr_list_pool_prepend_str (PRListPool *pool, PRList *list, const char *str);
+PRList *pr_list_pool_prependn_str (PRListPool *pool, PRList *list,
+		const char *str, size_t len);
+
 void pr_list_foreach_visit (PRList *list, PRListVisitor visitor);
 void pr_list_foreach_rev_visit (PRList *list, PRListVisitor visitor);
 
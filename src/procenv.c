@@ -33,6 +33,29 @@ pstring *doc = NULL;
  **/
 int reexec = false;
 
+/**
+ * probe_clocks:
+ *
+ * true if the cost of reading each clock should be measured.
+ **/
+bool probe_clocks = false;
+
+/**
+ * rate_window:
+ *
+ * If non-zero, number of milliseconds to wait between samples when
+ * calculating rates.
+ **/
+unsigned long rate_window = 0;
+
+/**
+ * env_filter:
+ *
+ * If set, only display environment variables whose names match
+ * this glob.
+ **/
+const char *env_filter = NULL;
+
 /**
  * selected_option:
  *
@@ -1000,6 +1023,50 @@ struct procenv_map thread_sched_policy_map[] = {
 	mk_map_entry (SCHED_RR)
 };
 
+struct procenv_map signal_action_flag_map[] = {
+#if defined (SA_NOCLDSTOP)
+	mk_map_entry (SA_NOCLDSTOP),
+#endif
+#if defined (SA_NOCLDWAIT)
+	mk_map_entry (SA_NOCLDWAIT),
+#endif
+#if defined (SA_NODEFER)
+	mk_map_entry (SA_NODEFER),
+#endif
+#if defined (SA_ONSTACK)
+	mk_map_entry (SA_ONSTACK),
+#endif
+#if defined (SA_RESETHAND)
+	mk_map_entry (SA_RESETHAND),
+#endif
+#if defined (SA_RESTART)
+	mk_map_entry (SA_RESTART),
+#endif
+	mk_map_entry (SA_SIGINFO),
+
+	{ NULL, 0 }
+};
+
+/* Number of largest environment variables to display */
+#define PROCENV_ENV_LARGEST 5
+
+struct procenv_section {
+	const char  *name;
+	void       (*func) (void);
+};
+
+/* A view of an environment variable (no strings are copied) */
+struct env_var {
+	/* full "name=value" string */
+	const char  *str;
+
+	size_t       name_len;
+	const char  *value;
+
+	/* length of @str including terminator */
+	size_t       size;
+};
+
 struct network_map {
 	struct ifaddrs   ifaddr;
 	char            *mac_address;
@@ -1023,13 +1090,24 @@ usage (void)
 	show ("  -A, --arguments         : Display program arguments.");
 	show ("  -b, --libs              : Display details of linked libraries.");
 	show ("  -B, --libc              : Display standard library details.");
+	show ("  --canonical             : Sort all output values and display a");
+	show ("                            content hash for each section in the");
+	show ("                            meta section.");
 	show ("  -c, --cgroups           : Display cgroup details (Linux only).");
 	show ("  -C, --cpu               : Display CPU and scheduler details.");
 	show ("  --crumb-separator=<str> : Specify string '<str>' as alternate delimiter");
 	show ("                            for crumb format output (default='%s').",
 			get_crumb_separator ());
 	show ("  -d, --compiler          : Display compiler details.");
+	show ("  --emit=<format>:<type>[:<file>]");
+	show ("                          : Render the collected details in <format>");
+	show ("                            to output <type> (see --format and");
+	show ("                            --output). May be specified multiple times");
+	show ("                            to produce several outputs from a single");
+	show ("                            collection pass.");
 	show ("  -e, --environment       : Display environment variables.");
+	show ("  --env-filter=<glob>     : Only display environment variables whose");
+	show ("                            names match '<glob>'.");
 	show ("  -E, --semaphores        : Display semaphore details.");
 	show ("  --exec                  : Treat non-option arguments as program to execute.");
 	show ("  -f, --fds               : Display file descriptor details.");
@@ -1041,24 +1119,33 @@ usage (void)
 	show ("");
 	show ("                            crumb    : ASCII 'breadcrumbs'");
 	show ("                            json     : JSON output.");
+	show ("                            openmetrics : OpenMetrics gauges for");
+	show ("                                       numeric values.");
 	show ("                            text     : ASCII output (default).");
 	show ("                            xml      : XML output.");
 	show ("");
 	show ("  -g, --sizeof            : Display sizes of data types in bytes.");
 	show ("  -h, --help              : This help text.");
+	show ("  -H, --hugepages         : Display huge page details (Linux only).");
 	show ("  -i, --misc              : Display miscellaneous details.");
+	show ("  -I, --instruction-set   : Display CPU instruction set features.");
 	show ("  --indent                : Number of indent characters to use for each indent");
 	show ("                            (default=%d).", get_indent_amount ());
 	show ("  --indent-char=<c>       : Use character '<c>' for indenting");
 	show ("                            (default='%s').", get_indent_char ());
 	show ("  -j, --uname             : Display uname details.");
 	show ("  -k, --clocks            : Display clock details.");
+	show ("                            Specify '--clocks=probe' to also measure the");
+	show ("                            cost of reading each clock and show");
+	show ("                            clocksource and synchronisation details.");
 	show ("  -l, --limits            : Display limits.");
 	show ("  -L, --locale            : Display locale details.");
 	show ("  -m, --mounts            : Display mount details.");
 	show ("  -M, --message-queues    : Display message queue details.");
 	show ("  -n, --confstr           : Display confstr details.");
 	show ("  -N, --network           : Display network details.");
+	show ("  -Q, --nic               : Display network interface queue, RSS and");
+	show ("                            offload details (Linux only).");
 	show ("  -o, --oom               : Display out-of-memory manager details (Linux only)");
 	show ("  --output=<type>         : Send output to alternative location.");
 	show ("                            <type> can be one of:");
@@ -1072,10 +1159,25 @@ usage (void)
 	show ("  -p, --process           : Display process details.");
 	show ("  -P, --platform          : Display platform details.");
 	show ("  -q, --time              : Display time details.");
+	show ("  --query=<paths>         : Only display the entries specified by the");
+	show ("                            comma-separated list of crumb paths.");
 	show ("  -r, --ranges            : Display range of data types.");
+	show ("  --rate-window=<ms>      : Sample network interface and vmstat");
+	show ("                            counters twice, <ms> milliseconds apart,");
+	show ("                            and display per-second rates (Linux only).");
 	show ("  --separator=<str>       : Specify string '<str>' as alternate delimiter");
 	show ("                            for text format output (default='%s').",
 			get_text_separator ());
+	show ("  --serve=<path>          : Answer requests for details on Unix domain");
+	show ("                            socket <path> (Linux only). Each request is a");
+	show ("                            line of the form '<format>[ <section>[,...]]'.");
+	show ("  --serve-timeout=<ms>    : Time to wait for an idle client before");
+	show ("                            disconnecting it when serving (default=%d).",
+			PROCENV_SERVE_DEFAULT_TIMEOUT);
+	show ("  --serve-ttl=[<section>=]<ms>[,...]");
+	show ("                          : Time to cache volatile sections (or the");
+	show ("                            specified section) for when serving");
+	show ("                            (default=%d).", PROCENV_SERVE_DEFAULT_TTL);
 	show ("  -s, --signals           : Display signal details.");
 	show ("  -S, --shared-memory     : Display shared memory details.");
 	show ("  -t, --tty               : Display terminal details.");
@@ -1085,6 +1187,7 @@ usage (void)
 	show ("  -v, --version           : Display version details.");
 	show ("  -w, --capabilities      : Display capability details (Linux only).");
 	show ("  -x, --pathconf          : Display pathconf details.");
+	show ("  -X, --auxv              : Display auxiliary vector details (Linux only).");
 	show ("  -y, --sysconf           : Display sysconf details.");
 	show ("  -Y, --memory            : Display memory details.");
 	show ("  -z, --timezone          : Display timezone details.");
@@ -1109,6 +1212,99 @@ usage (void)
 	show ("Home page: %s", PACKAGE_URL);
 }
 
+/**
+ * get_signal_display_name:
+ *
+ * @signum: signal number,
+ * @buffer: buffer to write real-time signal names to,
+ * @len: size of @buffer.
+ *
+ * Returns: name of @signum, or NULL if the signal is unknown.
+ **/
+static const char *
+get_signal_display_name (int signum, char *buffer, size_t len)
+{
+	const char *name;
+
+	assert (buffer);
+
+	name = get_signal_name (signum);
+	if (name)
+		return name;
+
+#if defined (SIGRTMIN) && defined (SIGRTMAX)
+	/* Real-time signals are not in the signal map since their
+	 * numbers are only known at runtime.
+	 */
+	if (signum == SIGRTMAX)
+		snprintf (buffer, len, "SIGRTMAX");
+	else if (signum == SIGRTMIN)
+		snprintf (buffer, len, "SIGRTMIN");
+	else if (signum > SIGRTMIN && signum < SIGRTMAX)
+		snprintf (buffer, len, "SIGRTMIN+%d", signum - SIGRTMIN);
+	else
+		return NULL;
+
+	return buffer;
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * show_signal_stack:
+ *
+ * Display the alternate signal stack of the calling thread
+ * (see sigaltstack(2)).
+ **/
+static void
+show_signal_stack (void)
+{
+	stack_t        stack;
+	unsigned long  minimum = 0;
+
+	section_open ("alternate stack");
+
+	if (sigaltstack (NULL, &stack) < 0) {
+		entry ("enabled", "%s", UNKNOWN_STR);
+		goto out;
+	}
+
+	entry ("enabled", "%s", stack.ss_flags & SS_DISABLE ? NO_STR : YES_STR);
+	entry ("active", "%s", stack.ss_flags & SS_ONSTACK ? YES_STR : NO_STR);
+
+	if (stack.ss_flags & SS_DISABLE)
+		entry ("size", "%s", NA_STR);
+	else
+		entry ("size", "%lu bytes", (unsigned long)stack.ss_size);
+
+#if defined (PROCENV_PLATFORM_LINUX) && defined (AT_MINSIGSTKSZ)
+	/* The kernel-provided minimum accounts for the size of the
+	 * signal frame on this CPU (which may exceed MINSIGSTKSZ).
+	 */
+	minimum = getauxval (AT_MINSIGSTKSZ);
+#endif
+
+#if defined (MINSIGSTKSZ)
+	if (! minimum)
+		minimum = (unsigned long)MINSIGSTKSZ;
+#endif
+
+	if (minimum)
+		entry ("minimum size", "%lu bytes", minimum);
+	else
+		entry ("minimum size", "%s", UNKNOWN_STR);
+
+	if ((stack.ss_flags & SS_DISABLE) || ! minimum)
+		entry ("sufficient", "%s", NA_STR);
+	else
+		entry ("sufficient", "%s",
+				stack.ss_size >= minimum ? YES_STR : NO_STR);
+
+out:
+	section_close ();
+}
+
 /**
  * show_signals:
  *
@@ -1141,12 +1337,15 @@ show_signals (void)
 	int                        rc;
 	int                        blocked;
 	int                        ignored;
+	int                        pending;
 	sigset_t                   old_sigset;
+	sigset_t                   pending_sigset;
 	struct sigaction           act;
 	const struct procenv_map  *p;
 	int                        max;
+	char                       name[32];
 
-	container_open ("signals");
+	header ("signals");
 
 	/* Query blocked signals.
 	 *
@@ -1155,6 +1354,13 @@ show_signals (void)
 	if (sigprocmask (SIG_BLOCK, NULL, &old_sigset) < 0)
 		die ("failed to query signal mask");
 
+	/* Signals pending for either the thread or the process */
+	if (sigpending (&pending_sigset) < 0)
+		die ("failed to query pending signals");
+
+#if defined (NSIG)
+	max = NSIG;
+#else
 	/* first, count the number of entries in the platform-specific
 	 * signal map.
 	 */
@@ -1163,6 +1369,21 @@ show_signals (void)
 			p++, max++) {
 		; /* NOP */
 	}
+#endif
+
+#if defined (SIGRTMIN) && defined (SIGRTMAX)
+	section_open ("real-time");
+	entry ("SIGRTMIN", "%d", SIGRTMIN);
+	entry ("SIGRTMAX", "%d", SIGRTMAX);
+	section_close ();
+
+	if (SIGRTMAX >= max)
+		max = SIGRTMAX + 1;
+#endif
+
+	show_signal_stack ();
+
+	container_open ("list");
 
 	/* Note that we don't iterate the signal map directly in case the
 	 * entries are out of order. Instead, present the signals in numeric
@@ -1178,7 +1399,8 @@ show_signals (void)
 		rc = sigismember (&old_sigset, i);
 
 		/* there is no signal with this value: there are gaps in
-		 * the list.
+		 * the list (and the C library reserves some real-time
+		 * signals).
 		 */
 		if (sigaction (i, NULL, &act) < 0)
 			continue;
@@ -1191,7 +1413,9 @@ show_signals (void)
 		else if (rc)
 			blocked = 1;
 
-		signal_name = get_signal_name (i);
+		pending = sigismember (&pending_sigset, i) > 0;
+
+		signal_name = get_signal_display_name (i, name, sizeof (name));
 		if (! signal_name)
 			continue;
 
@@ -1206,6 +1430,21 @@ show_signals (void)
 				signal_desc ? signal_desc : UNKNOWN_STR);
 		entry ("blocked", "%s", blocked ? YES_STR : NO_STR);
 		entry ("ignored", "%s", ignored ? YES_STR : NO_STR);
+		entry ("pending", "%s", pending ? YES_STR : NO_STR);
+
+		entry ("handler", "%s",
+				act.sa_handler == SIG_DFL ? "default"
+				: act.sa_handler == SIG_IGN ? "ignore"
+				: "installed");
+
+		section_open ("flags");
+
+		for (p = signal_action_flag_map; p->name; p++) {
+			entry (p->name, "%s",
+					act.sa_flags & p->num ? YES_STR : NO_STR);
+		}
+
+		section_close ();
 
 		section_close ();
 
@@ -1213,8 +1452,9 @@ show_signals (void)
 	}
 
 	container_close ();
-}
 
+	footer ();
+}
 
 void
 show_rusage (void)
@@ -1451,6 +1691,50 @@ show_cpu (void)
 	footer ();
 }
 
+void
+show_auxv (void)
+{
+	header ("auxv");
+
+	if (ops->show_auxv)
+		ops->show_auxv ();
+
+	footer ();
+}
+
+void
+show_nic (void)
+{
+	header ("nic");
+
+	if (ops->show_nic)
+		ops->show_nic ();
+
+	footer ();
+}
+
+void
+show_hugepages (void)
+{
+	header ("hugepages");
+
+	if (ops->show_hugepages)
+		ops->show_hugepages ();
+
+	footer ();
+}
+
+void
+show_instruction_set (void)
+{
+	header ("instruction set");
+
+	if (ops->show_instruction_set)
+		ops->show_instruction_set ();
+
+	footer ();
+}
+
 void
 show_memory (void)
 {
@@ -1464,6 +1748,9 @@ show_memory (void)
 	if (ops->handle_numa_memory)
 		ops->handle_numa_memory ();
 
+	if (ops->handle_process_memory)
+		ops->handle_process_memory ();
+
 	footer ();
 }
 
@@ -1489,59 +1776,177 @@ show_namespaces (void)
 	container_close ();
 }
 
+/**
+ * env_var_compar:
+ *
+ * Compare two environment variables by their full "name=value"
+ * strings.
+ **/
+static int
+env_var_compar (const void *a, const void *b)
+{
+	const struct env_var *x = a;
+	const struct env_var *y = b;
+
+	return strcoll (x->str, y->str);
+}
+
+/**
+ * get_env_var_name:
+ *
+ * @var: environment variable,
+ * @buffer: buffer to write name to (will be reallocated as required),
+ * @size: size of @buffer.
+ *
+ * Copy the name of @var into @buffer, which is reused across calls to
+ * avoid an allocation per variable.
+ **/
+static void
+get_env_var_name (const struct env_var *var, char **buffer, size_t *size)
+{
+	assert (var);
+	assert (buffer);
+	assert (size);
+
+	if (var->name_len + 1 > *size) {
+		*size = var->name_len + 1;
+		*buffer = realloc (*buffer, *size);
+		if (! *buffer)
+			die ("failed to allocate storage");
+	}
+
+	memcpy (*buffer, var->str, var->name_len);
+	(*buffer)[var->name_len] = '\0';
+}
+
+/**
+ * show_env:
+ *
+ * Display environment variables, sorted by name, followed by a
+ * summary of the size of the environment.
+ *
+ * Rather than copying each environment string, an array of views
+ * into environ is sorted and displayed.
+ **/
 void
 show_env (void)
 {
-	char    **env = environ;
-	char    **copy;
-	char     *name;
-	char     *value;
-	size_t    i;
-	size_t    max;
+	struct env_var   *vars;
+	struct env_var   *largest[PROCENV_ENV_LARGEST];
+	size_t            largest_count = 0;
+	char             *name = NULL;
+	size_t            name_size = 0;
+	size_t            count;
+	size_t            shown = 0;
+	size_t            bytes = 0;
+	size_t            pointer_bytes;
+	size_t            i;
+	size_t            j;
+	long              arg_max;
+	const char       *equals;
 
 	header ("environment");
 
 	/* Calculate size of environment array */
-	for (max=0; env[max]; max++)
+	for (count = 0; environ[count]; count++)
 		;
 
-	copy = calloc (1+max, sizeof (char *));
-	if (! copy)
+	vars = calloc (count ? count : 1, sizeof (struct env_var));
+	if (! vars)
 		die ("failed to allocate storage");
 
-	/* Copy the environ array since modification is not allowed */
-	for (i=0; i < max; i++) {
-		copy[i] = calloc (1, 1+strlen (env[i]));
-		if (! copy[i])
-			die ("failed to allocate storage");
-		strcpy (copy[i], env[i]);
+	for (i = 0; i < count; i++) {
+		struct env_var *var = &vars[i];
+
+		var->str = environ[i];
+		var->size = strlen (var->str) + 1;
+
+		equals = strchr (var->str, '=');
+
+		var->name_len = equals ? (size_t)(equals - var->str) : var->size - 1;
+		var->value = equals ? equals + 1 : "";
+
+		bytes += var->size;
 	}
 
-	/* Terminate */
-	copy[max] = NULL;
+	/* Sorting views retains the original ordering (by the full
+	 * "name=value" string) without copying any strings.
+	 */
+	qsort (vars, count, sizeof (struct env_var), env_var_compar);
 
-	/* Sort */
-	env = copy;
-	qsort (env, i, sizeof (env[0]), qsort_compar);
+	/* Record the largest variables (in descending size order) */
+	for (i = 0; i < count; i++) {
+		struct env_var *var = &vars[i];
 
-	/* Display */
-	env = copy;
-	while (env && *env) {
-		name = *env;
-		value = strchr (name, '=');
-		assert (value);
-		*value = '\0';
-		value++;
+		for (j = largest_count; j > 0 && largest[j-1]->size < var->size; j--) {
+			if (j < PROCENV_ENV_LARGEST)
+				largest[j] = largest[j-1];
+		}
+
+		if (j < PROCENV_ENV_LARGEST) {
+			largest[j] = var;
+			if (largest_count < PROCENV_ENV_LARGEST)
+				largest_count++;
+		}
+	}
+
+	section_open ("variables");
 
-		entry (name, "%s", value);
-		env++;
+	for (i = 0; i < count; i++) {
+		get_env_var_name (&vars[i], &name, &name_size);
+
+		if (env_filter && fnmatch (env_filter, name, 0))
+			continue;
+
+		entry (name, "%s", vars[i].value);
+		shown++;
 	}
 
-	/* Tidy up */
-	for (i = 0; i < max; i++)
-		free (copy[i]);
+	section_close ();
+
+	section_open ("size");
+
+	entry ("variables", "%lu", (unsigned long)count);
+
+	if (env_filter) {
+		entry ("filter", "%s", env_filter);
+		entry ("matched variables", "%lu", (unsigned long)shown);
+	}
+
+	/* The kernel also accounts for the environ pointer array */
+	pointer_bytes = (count + 1) * sizeof (char *);
+
+	entry ("string bytes", "%lu", (unsigned long)bytes);
+	entry ("pointer bytes", "%lu", (unsigned long)pointer_bytes);
+	entry ("total bytes", "%lu", (unsigned long)(bytes + pointer_bytes));
+
+	arg_max = sysconf (_SC_ARG_MAX);
+
+	if (arg_max > 0) {
+		entry ("ARG_MAX", "%ld", arg_max);
+		entry ("percentage of ARG_MAX", "%.2f%%",
+				(100.0 * (double)(bytes + pointer_bytes)) / (double)arg_max);
+	} else {
+		entry ("ARG_MAX", "%s", UNKNOWN_STR);
+		entry ("percentage of ARG_MAX", "%s", UNKNOWN_STR);
+	}
 
-	free (copy);
+	container_open ("largest");
+
+	for (i = 0; i < largest_count; i++) {
+		get_env_var_name (largest[i], &name, &name_size);
+
+		object_open (false);
+		entry (name, "%lu", (unsigned long)largest[i]->size);
+		object_close (false);
+	}
+
+	container_close ();
+
+	section_close ();
+
+	free_if_set (name);
+	free (vars);
 
 	footer ();
 }
@@ -1779,7 +2184,10 @@ init (void)
 	if (ops->init)
 		ops->init ();
 
+#if ! defined (PROCENV_LIBRARY)
+	/* A library must not change the locale of its host process */
 	save_locale ();
+#endif
 
 	handle_indent_char ();
 
@@ -1839,7 +2247,7 @@ show_meta (void)
 	entry ("file", ops->driver.file);
 	section_close ();
 
-	entry ("format-type", "%s", get_output_format_name ());
+	entry_func ("format-type", get_output_format_name);
 	entry ("format-version", "%d", PROCENV_FORMAT_VERSION);
 
 	footer ();
@@ -1970,6 +2378,7 @@ dump (void)
 	show_meta ();
 	show_arguments ();
 
+	show_auxv ();
 	show_capabilities ();
 	show_cgroups ();
 	show_clocks ();
@@ -1978,6 +2387,8 @@ dump (void)
 	show_cpu ();
 	show_env ();
 	show_fds ();
+	show_hugepages ();
+	show_instruction_set ();
 	show_libc ();
 	show_libs ();
 	show_rlimits ();
@@ -1988,6 +2399,7 @@ dump (void)
 	show_mounts (SHOW_ALL);
 	show_namespaces ();
 	show_network ();
+	show_nic ();
 	show_oom ();
 	show_platform ();
 	show_proc ();
@@ -2863,12 +3275,12 @@ show_libs (void)
 {
 	common_assert ();
 
-	container_open ("libraries");
+	header ("libraries");
 
 	if (ops->show_libs)
 		ops->show_libs();
 
-	container_close ();
+	footer ();
 }
 
 void
@@ -2879,6 +3291,9 @@ show_clocks (void)
 	if (ops->show_clocks)
 		ops->show_clocks();
 
+	if (probe_clocks && ops->show_clock_probe)
+		ops->show_clock_probe ();
+
 	footer ();
 }
 
@@ -3864,6 +4279,9 @@ show_threads (void)
 
 #endif
 
+	if (ops->show_thread_scheduling)
+		ops->show_thread_scheduling ();
+
 	footer ();
 }
 
@@ -3918,13 +4336,171 @@ show_data_model (void)
 }
 #undef DATA_MODEL
 
+static void
+show_mounts_section (void)
+{
+	show_mounts (SHOW_MOUNTS);
+}
+
+static void
+show_pathconf_section (void)
+{
+	show_mounts (SHOW_PATHCONF);
+}
+
+/**
+ * sections:
+ *
+ * Map of top-level section names to the functions that display them.
+ **/
+static struct procenv_section sections[] = {
+	{ "arguments"        , show_arguments },
+	{ "auxv"             , show_auxv },
+	{ "capabilities"     , show_capabilities },
+	{ "cgroups"          , show_cgroups },
+	{ "clocks"           , show_clocks },
+	{ "compiler"         , show_compiler },
+	{ "confstr"          , show_confstrs },
+	{ "cpu"              , show_cpu },
+	{ "environment"      , show_env },
+	{ "file descriptors" , show_fds },
+	{ "hugepages"        , show_hugepages },
+	{ "instruction set"  , show_instruction_set },
+	{ "libc"             , show_libc },
+	{ "libraries"        , show_libs },
+	{ "limits"           , show_rlimits },
+	{ "locale"           , show_locale },
+	{ "memory"           , show_memory },
+	{ "message queues"   , show_msg_queues },
+	{ "meta"             , show_meta },
+	{ "misc"             , show_misc },
+	{ "mounts"           , show_mounts_section },
+	{ "namespaces"       , show_namespaces },
+	{ "network"          , show_network },
+	{ "nic"              , show_nic },
+	{ "oom"              , show_oom },
+	{ "pathconf"         , show_pathconf_section },
+	{ "platform"         , show_platform },
+	{ "process"          , show_proc },
+	{ "ranges"           , show_ranges },
+	{ "rusage"           , show_rusage },
+	{ "semaphores"       , show_semaphores },
+	{ "shared memory"    , show_shared_mem },
+	{ "signals"          , show_signals },
+	{ "sizeof"           , show_sizeof },
+	{ "stat"             , show_stat },
+	{ "sysconf"          , show_sysconf },
+	{ "threads"          , show_threads },
+	{ "time"             , show_time },
+	{ "timezone"         , show_timezone },
+	{ "tty"              , show_tty_attrs },
+	{ "uname"            , show_uname },
+	{ "version"          , show_version },
+
+	{ NULL, NULL }
+};
+
+/**
+ * show_section:
+ *
+ * @name: name of section.
+ *
+ * Display the section called @name.
+ *
+ * Returns: true if @name is a valid section, else false.
+ **/
+bool
+show_section (const char *name)
+{
+	const struct procenv_section *section;
+
+	assert (name);
+
+	for (section = sections; section->name; section++) {
+		if (! strcmp (name, section->name)) {
+			section->func ();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * get_section_name:
+ *
+ * @i: index of section.
+ *
+ * Returns: name of section @i (in alphabetical order), or NULL if
+ * @i is out of range.
+ **/
+const char *
+get_section_name (size_t i)
+{
+	if (i >= (sizeof (sections) / sizeof (sections[0])) - 1)
+		return NULL;
+
+	return sections[i].name;
+}
+
+#if ! defined (PROCENV_LIBRARY)
+
+/**
+ * show_query:
+ *
+ * Run only those collectors required to satisfy the paths specified
+ * via --query, then display the matching entries.
+ **/
+static void
+show_query (void)
+{
+	const struct procenv_section  *section;
+	const char                    *query;
+	const char                    *sep;
+	size_t                         len;
+	size_t                         i;
+	bool                           found;
+
+	common_assert ();
+
+	sep = get_crumb_separator ();
+
+	/* Resolve the section for each query before running anything */
+	for (i = 0; i < get_query_count (); i++) {
+		query = get_query (i);
+		found = false;
+
+		for (section = sections; section->name; section++) {
+			len = strlen (section->name);
+
+			if (! strncmp (query, section->name, len)
+					&& (! query[len] || ! strncmp (query + len, sep, strlen (sep)))) {
+				found = true;
+				break;
+			}
+		}
+
+		if (! found)
+			die ("unknown section in query: '%s'", query);
+	}
+
+	for (section = sections; section->name; section++) {
+		if (query_section_wanted (section->name))
+			section->func ();
+	}
+
+	show_query_results (&doc);
+}
+
 int
 main (int    argc,
 		char  *argv[])
 {
-	int  option;
-	int  long_index;
-	int  done = false;
+	int          option;
+	int          long_index;
+	int          done = false;
+	bool         canonical = false;
+	const char  *serve_path = NULL;
 
 	struct option long_options[] = {
 		{"meta"            , no_argument       , NULL, 'a'},
@@ -3934,6 +4510,7 @@ main (int    argc,
 		{"cgroups"         , no_argument       , NULL, 'c'},
 		{"cpu"             , no_argument       , NULL, 'C'},
 		{"compiler"        , no_argument       , NULL, 'd'},
+		{"canonical"       , no_argument       , NULL,  0 },
 		{"crumb-separator" , required_argument , NULL,  0 },
 		{"environment"     , no_argument       , NULL, 'e'},
 		{"semaphores"      , no_argument       , NULL, 'E'},
@@ -3941,15 +4518,18 @@ main (int    argc,
 		{"namespaces"      , no_argument       , NULL, 'F'},
 		{"sizeof"          , no_argument       , NULL, 'g'},
 		{"help"            , no_argument       , NULL, 'h'},
+		{"hugepages"       , no_argument       , NULL, 'H'},
 		{"misc"            , no_argument       , NULL, 'i'},
+		{"instruction-set" , no_argument       , NULL, 'I'},
 		{"uname"           , no_argument       , NULL, 'j'},
-		{"clocks"          , no_argument       , NULL, 'k'},
+		{"clocks"          , optional_argument , NULL, 'k'},
 		{"limits"          , no_argument       , NULL, 'l'},
 		{"locale"          , no_argument       , NULL, 'L'},
 		{"mounts"          , no_argument       , NULL, 'm'},
 		{"message-queues"  , no_argument       , NULL, 'M'},
 		{"confstr"         , no_argument       , NULL, 'n'},
 		{"network"         , no_argument       , NULL, 'N'},
+		{"nic"             , no_argument       , NULL, 'Q'},
 		{"oom"             , no_argument       , NULL, 'o'},
 		{"process"         , no_argument       , NULL, 'p'},
 		{"platform"        , no_argument       , NULL, 'P'},
@@ -3964,17 +4544,25 @@ main (int    argc,
 		{"version"         , no_argument       , NULL, 'v'},
 		{"capabilities"    , no_argument       , NULL, 'w'},
 		{"pathconf"        , no_argument       , NULL, 'x'},
+		{"auxv"            , no_argument       , NULL, 'X'},
 		{"sysconf"         , no_argument       , NULL, 'y'},
 		{"memory"          , no_argument       , NULL, 'Y'},
 		{"timezone"        , no_argument       , NULL, 'z'},
+		{"env-filter"      , required_argument , NULL,  0 },
 		{"exec"            , no_argument       , NULL,  0 },
 		{"file"            , required_argument , NULL,  0 },
 		{"file-append"     , no_argument       , NULL,  0 },
 		{"format"          , required_argument , NULL,  0 },
 		{"indent"          , required_argument , NULL,  0 },
 		{"indent-char"     , required_argument , NULL,  0 },
+		{"emit"            , required_argument , NULL,  0 },
 		{"output"          , required_argument , NULL,  0 },
+		{"query"           , required_argument , NULL,  0 },
+		{"rate-window"     , required_argument , NULL,  0 },
 		{"separator"       , required_argument , NULL,  0 },
+		{"serve"           , required_argument , NULL,  0 },
+		{"serve-timeout"   , required_argument , NULL,  0 },
+		{"serve-ttl"       , required_argument , NULL,  0 },
 
 		/* terminator */
 		{NULL              , no_argument       , NULL,  0 }
@@ -3997,7 +4585,7 @@ main (int    argc,
 
 	while (true) {
 		option = getopt_long (argc, argv,
-				"aAbBcCdeEfFghijklLmMnNopPqrsStTuUvwxyYz",
+				"aAbBcCdeEfFghHiIjk::lLmMnNopPqQrsStTuUvwxXyYz",
 				long_options, &long_index);
 		if (option == -1)
 			break;
@@ -4058,6 +4646,34 @@ main (int    argc,
 				} else {
 					set_text_separator (optarg);
 				}
+			} else if (! strcmp ("env-filter", long_options[long_index].name)) {
+				env_filter = optarg;
+			} else if (! strcmp ("query", long_options[long_index].name)) {
+				add_query (optarg);
+			} else if (! strcmp ("serve", long_options[long_index].name)) {
+				if (done)
+					die ("cannot specify display options with --serve");
+				serve_path = optarg;
+			} else if (! strcmp ("serve-ttl", long_options[long_index].name)) {
+				serve_set_ttl (optarg);
+			} else if (! strcmp ("serve-timeout", long_options[long_index].name)) {
+				serve_set_timeout (optarg);
+			} else if (! strcmp ("canonical", long_options[long_index].name)) {
+				if (done)
+					die ("must specify --canonical before display options");
+				canonical = true;
+				set_canonical ();
+			} else if (! strcmp ("emit", long_options[long_index].name)) {
+				if (done)
+					die ("must specify --emit before display options");
+				add_emit (optarg);
+			} else if (! strcmp ("rate-window", long_options[long_index].name)) {
+				char *endptr = NULL;
+
+				errno = 0;
+				rate_window = strtoul (optarg, &endptr, 10);
+				if (errno || ! *optarg || *endptr || ! rate_window)
+					die ("invalid value for --rate-window: '%s'", optarg);
 			} else if (! strcmp ("crumb-separator", long_options[long_index].name)) {
 				if (! strcmp (optarg, "\\t")) {
 					set_crumb_separator ("\t");
@@ -4123,6 +4739,10 @@ main (int    argc,
 			usage ();
 			break;
 
+		case 'H':
+			show_hugepages ();
+			break;
+
 		case 'i':
 			get_uname ();
 			get_user_info ();
@@ -4130,11 +4750,20 @@ main (int    argc,
 			show_misc ();
 			break;
 
+		case 'I':
+			show_instruction_set ();
+			break;
+
 		case 'j':
 			show_uname ();
 			break;
 
 		case 'k':
+			if (optarg) {
+				if (strcmp (optarg, "probe"))
+					die ("invalid value for --clocks: '%s'", optarg);
+				probe_clocks = true;
+			}
 			show_clocks ();
 			break;
 
@@ -4162,6 +4791,10 @@ main (int    argc,
 			show_network ();
 			break;
 
+		case 'Q':
+			show_nic ();
+			break;
+
 		case 'o':
 			show_oom ();
 			break;
@@ -4219,6 +4852,10 @@ main (int    argc,
 			show_mounts (SHOW_PATHCONF);
 			break;
 
+		case 'X':
+			show_auxv ();
+			break;
+
 		case 'y':
 			show_sysconf ();
 			break;
@@ -4237,7 +4874,23 @@ main (int    argc,
 		}
 	}
 
-	if (done) {
+	if (get_query_count () && done)
+		die ("cannot specify display options with --query");
+
+	if (get_query_count () && get_emit_count ())
+		die ("cannot specify --emit with --query");
+
+	if (get_query_count () && output_format == OUTPUT_FORMAT_OPENMETRICS)
+		die ("cannot specify --query with openmetrics format");
+
+	if (get_query_count () && canonical)
+		die ("cannot specify --canonical with --query");
+
+	if (serve_path && (done || get_query_count () || get_emit_count ()
+				|| canonical || output_format == OUTPUT_FORMAT_OPENMETRICS))
+		die ("cannot specify display options, --canonical, --emit, --query or openmetrics format with --serve");
+
+	if (done && ! is_recording ()) {
 		common_assert ();
 
 		master_footer (&doc);
@@ -4251,6 +4904,12 @@ main (int    argc,
 
 	output_init ();
 
+	if (serve_path) {
+		serve (serve_path);
+		cleanup ();
+		exit (EXIT_SUCCESS);
+	}
+
 	if (reexec && ! exec_args && optind >= argc)
 		die ("must specify at least one argument with '--exec'");
 
@@ -4262,15 +4921,24 @@ main (int    argc,
 		}
 	}
 
-	if (! done) {
+	if (get_query_count ()) {
+		show_query ();
+	} else if (! done) {
 		dump ();
 
-		pstring_chomp (doc);
+		if (! is_recording ()) {
+			pstring_chomp (doc);
 
-		pstring_compress (&doc, wide_indent_char);
+			pstring_compress (&doc, wide_indent_char);
+		}
 	}
 
-	_show_output_pstring (doc);
+	if (get_emit_count ())
+		render_emits ();
+	else if (is_recording ())
+		show_recorded ();
+	else
+		_show_output_pstring (doc);
 	cleanup ();
 
 	/* Perform re-exec */
@@ -4283,6 +4951,8 @@ main (int    argc,
 
 }
 
+#endif /* ! PROCENV_LIBRARY */
+
 /* FIXME: we _assume_ the returned value is a static, but is it guaranteed?
 */
 const char *
@@ -4470,28 +5140,55 @@ show_network (void)
 
 #else
 
-void
-show_network (void)
+static void
+release_ifaddrs (void *if_addrs)
+{
+	freeifaddrs (if_addrs);
+}
+
+static void
+free_network_map (void *data)
+{
+	struct network_map  *head = data;
+	struct network_map  *node;
+	struct network_map  *next;
+
+	for (node = head->next; node; node = next) {
+		next = node->next;
+
+		free_if_set (node->mac_address);
+		free (node);
+	}
+
+	free (head);
+}
+
+/**
+ * show_network_ifaddrs:
+ *
+ * Display network interfaces using getifaddrs(3).
+ **/
+static void
+show_network_ifaddrs (void)
 {
 	struct ifaddrs      *if_addrs;
 	struct ifaddrs      *ifa;
 	char                *mac_address = NULL;
 	struct network_map  *head = NULL;
 	struct network_map  *node = NULL;
-	struct network_map  *tmp = NULL;
-
-	common_assert ();
-
-	header ("network");
 
 	/* Query all network interfaces */
 	if (getifaddrs (&if_addrs) < 0)
 		return;
 
+	track_memory (if_addrs, release_ifaddrs);
+
 	/* Construct an initial node for the cache */
 	head = calloc (1, sizeof (struct network_map));
 	assert (head);
 
+	track_memory (head, free_network_map);
+
 	/* Iterate over all network interfaces */
 	for (ifa = if_addrs; ifa; ifa = ifa->ifa_next) {
 #if !defined (PROCENV_PLATFORM_HURD)
@@ -4578,23 +5275,29 @@ show_network (void)
 		}
 	}
 
-	/* Destroy the cache, displaying any interfaces not previously displayed.
-	 * These by definition cannot have addresses assigned to them.
+	/* Display any interfaces remaining in the cache. These by
+	 * definition cannot have addresses assigned to them.
 	 */
-	for (node = head->next; node && node->ifaddr.ifa_name; node = tmp) {
+	for (node = head->next; node && node->ifaddr.ifa_name; node = node->next)
+		show_network_if (&node->ifaddr, node->mac_address);
 
-		tmp = node->next;
+	/* Destroy the cache */
+	free_tracked (head);
+	free_tracked (if_addrs);
+}
 
-		show_network_if (&node->ifaddr, node->mac_address);
+void
+show_network (void)
+{
+	common_assert ();
 
-		/* Destroy */
-		if (node->mac_address)
-			free (node->mac_address);
-		free (node);
-	}
+	header ("network");
 
-	free (head);
-	freeifaddrs (if_addrs);
+	/* Prefer the platform-specific method, falling back to
+	 * getifaddrs(3) if it is unavailable or fails.
+	 */
+	if (! ops->show_network_interfaces || ! ops->show_network_interfaces ())
+		show_network_ifaddrs ();
 
 	footer ();
 }
@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <paths.h>
 #include <dirent.h>
+#include <fnmatch.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -75,6 +76,7 @@
 #include "string-util.h"
 #include "pr_list.h"
 #include "output.h"
+#include "serve.h"
 #include "platform.h"
 
 #include "platform-headers.h"
@@ -174,8 +176,80 @@
  *    Now, 'device' is a container showing the name, permissions,
  *    major/minor numbers and owner of the file represented by the file
  *    descriptor (assuming it isn't a pipe).
+ * VERSION 25:
+ *  - Added --instruction-set.
+ * VERSION 26:
+ *  - Added --auxv.
+ * VERSION 27:
+ *  - Added per-process usage and mapping details to --memory.
+ * VERSION 28:
+ *  - Added --hugepages.
+ * VERSION 29:
+ *  - Added full scheduler attributes and autogroup details to --cpu
+ *    and per-thread scheduler attributes to --threads.
+ * VERSION 30:
+ *  - Added --clocks=probe.
+ * VERSION 31:
+ *  - On Linux, --network now displays one section per interface
+ *    (sorted by name) with an "addresses" container, qdisc, txqlen
+ *    and operational state.
+ * VERSION 32:
+ *  - Added per-interface statistics to --network and --rate-window.
+ * VERSION 33:
+ *  - Added --nic.
+ * VERSION 34:
+ *  - --libs is now a section containing a "list" container. On Linux,
+ *    libraries are sorted by name and show build-id, segment sizes,
+ *    relocation and symbol counts and residency, followed by a
+ *    "summary" section.
+ * VERSION 35:
+ *  - --environment now contains a "variables" section and a "size"
+ *    section. Added --env-filter.
+ * VERSION 36:
+ *  - Added --query.
+ * VERSION 37:
+ *  - Added --emit.
+ * VERSION 38:
+ *  - Added --serve and --serve-ttl.
+ * VERSION 39:
+ *  - Added openmetrics output format.
+ * VERSION 40:
+ *  - Added --canonical.
+ * VERSION 41:
+ *  - On Linux, --memory now displays "meminfo", "derived" and "vmstat"
+ *    sections. --rate-window also applies to the vmstat counters.
+ * VERSION 42:
+ *  - On Linux, --capabilities no longer requires libcap. Replaced
+ *    "count (CAP_LAST_CAP+1)" with the runtime "count", added a
+ *    "sets" section and an "unknown" section.
+ * VERSION 43:
+ *  - On Linux, each entry in the --threads "tasks" container now
+ *    displays state, last cpu, affinity, cpu time, signals and
+ *    context switches.
+ * VERSION 44:
+ *  - --signals is now a section containing "real-time",
+ *    "alternate stack" and "list" (the previous signals container).
+ *    Real-time signals are listed and each signal now shows
+ *    "pending", "handler" and "flags". On Linux, the --threads task
+ *    "signals" section also shows pending signals.
+ * VERSION 45:
+ *  - On Linux, hugetlbfs mounts in --mounts and in the --hugepages
+ *    "mounts" container show "huge page size".
+ * VERSION 46:
+ *  - On x86, the --instruction-set "constant_tsc" feature is now
+ *    "invariant_tsc". On Linux, "hwcap" and "hwcap2" are the values
+ *    passed by the kernel (as shown by --auxv).
+ * VERSION 47:
+ *  - On x86, the --clocks=probe "tsc" section now shows
+ *    "invariant tsc".
+ * VERSION 48:
+ *  - openmetrics "path" labels identify objects by name or address
+ *    rather than by position where possible.
+ * VERSION 49:
+ *  - With --canonical, addresses that vary due to address space
+ *    layout randomisation and library residency are "[suppressed]".
  **/
-#define PROCENV_FORMAT_VERSION 24
+#define PROCENV_FORMAT_VERSION 49
 
 #if defined (PROCENV_PLATFORM_LINUX) || defined (PROCENV_PLATFORM_HURD)
 
@@ -199,6 +273,13 @@
 
 #define PROCENV_BUFFER                1024
 
+/* Size of buffer used to read an entire /proc file such as
+ * /proc/self/status or /proc/meminfo. The status file alone can
+ * exceed 8k on systems with many CPUs and NUMA nodes; read_file()
+ * fails rather than truncating a larger file.
+ */
+#define PROCENV_PROC_FILE_BUFFER      32768
+
 /* FIXME: explain! */
 #define CTIME_BUFFER                  32
 
@@ -220,6 +301,8 @@
 		entry ("resolution", "%s", UNKNOWN_STR); \
 	else \
 		entry ("resolution", "%ld.%09lds", res.tv_sec, res.tv_nsec); \
+	if (probe_clocks) \
+		show_clock_cost (clock); \
 	section_close (); \
 }
 
@@ -361,6 +444,7 @@ char *get_path (const char *argv0);
 char *get_personality_flags (unsigned int flags);
 const char *get_arch (void);
 const char *get_group_name (gid_t gid);
+const char *get_net_family_name (sa_family_t family);
 const char *get_os (void);
 const char *get_personality_name (unsigned int domain);
 const char *get_signal_name (int signum);
@@ -370,14 +454,18 @@ int get_major_minor (const char *path, unsigned int *_major, unsigned int *_mino
 long get_kernel_bits (void);
 void get_priorities (void);
 void get_uname (void);
+void decode_if_flags (unsigned int flags);
 
 void show_all_groups (void);
+void show_auxv (void);
 void show_capabilities (void);
 void show_cgroups (void);
 void show_clocks (void);
 void show_compiler (void);
 void show_confstrs (void);
 void show_data_model (void);
+void show_hugepages (void);
+void show_instruction_set (void);
 void show_libc (void);
 void show_libs (void);
 void show_locale (void);
@@ -385,6 +473,7 @@ void show_mounts (ShowMountType what);
 void show_misc (void);
 void show_msg_queues (void);
 void show_network (void);
+void show_nic (void);
 void show_oom (void);
 void show_ranges (void);
 void show_rlimits (void);
@@ -400,6 +489,11 @@ void show_version (void);
 
 void handle_proc_branch (void);
 
+void init (void);
+void dump (void);
+bool show_section (const char *name);
+const char *get_section_name (size_t i);
+
 char *format_perms (mode_t mode);
 void format_time (const time_t *t, char *buffer, size_t len);
 void restore_locale (void);
@@ -409,5 +503,8 @@ extern char **environ;
 
 extern Output output;
 extern pstring *doc;
+extern bool probe_clocks;
+extern unsigned long rate_window;
+extern const char *env_filter;
 
 #endif /* PROCENV_H */
@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 
 extern wchar_t wide_indent_char;
 
@@ -175,6 +176,99 @@ char_to_pstring (const char *str)
 	return pstr;
 }
 
+/**
+ * replacement_char:
+ *
+ * Returns: Character to use in place of invalid multi-byte sequences:
+ * U+FFFD if it can be represented in the current locale, else '?'.
+ **/
+static wchar_t
+replacement_char (void)
+{
+	char       buf[MB_LEN_MAX];
+	mbstate_t  ps;
+
+	memset (&ps, 0, sizeof (ps));
+
+	if (wcrtomb (buf, (wchar_t)0xFFFD, &ps) != (size_t)-1)
+		return (wchar_t)0xFFFD;
+
+	return L'?';
+}
+
+/**
+ * char_to_pstring_lossy:
+ *
+ * @str: multi-byte string.
+ *
+ * Convert @str to a pstring. Unlike char_to_pstring(), the
+ * conversion cannot fail due to the contents of @str: each byte
+ * that does not form part of a valid multi-byte sequence in the
+ * current locale is converted to replacement_char().
+ *
+ * Returns: Newly-allocated pstring, or NULL on allocation failure.
+ **/
+pstring *
+char_to_pstring_lossy (const char *str)
+{
+	pstring    *pstr;
+	wchar_t    *wstr;
+	wchar_t     wc;
+	wchar_t     replacement = L'\0';
+	mbstate_t   ps;
+	size_t      len;
+	size_t      bytes;
+	size_t      ret;
+	size_t      i = 0;
+
+	assert (str);
+
+	len = strlen (str);
+
+	/* Each character requires at least one byte */
+	bytes = (1 + len) * sizeof (wchar_t);
+
+	wstr = malloc (bytes);
+	if (! wstr)
+		return NULL;
+
+	memset (&ps, 0, sizeof (ps));
+
+	while (len) {
+		ret = mbrtowc (&wc, str, len, &ps);
+
+		if (ret == (size_t)-1 || ret == (size_t)-2) {
+			if (! replacement)
+				replacement = replacement_char ();
+
+			wstr[i++] = replacement;
+
+			memset (&ps, 0, sizeof (ps));
+			ret = 1;
+		} else {
+			/* ret cannot be 0 since len excludes the terminator */
+			wstr[i++] = wc;
+		}
+
+		str += ret;
+		len -= ret;
+	}
+
+	wstr[i] = L'\0';
+
+	pstr = pstring_new ();
+	if (! pstr) {
+		free (wstr);
+		return NULL;
+	}
+
+	pstr->buf = wstr;
+	pstr->len = i + 1;
+	pstr->size = bytes;
+
+	return pstr;
+}
+
 char *
 pstring_to_char (const pstring *str)
 {
@@ -32,6 +32,7 @@ typedef struct procenv_string {
 pstring *pstring_new (void);
 pstring *pstring_create (const wchar_t *str);
 pstring *char_to_pstring (const char *str);
+pstring *char_to_pstring_lossy (const char *str);
 char *pstring_to_char (const pstring *str);
 void pstring_chomp (pstring *str);
 void pstring_compress (pstring **wstr, wchar_t remove_char);
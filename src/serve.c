@@ -0,0 +1,975 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2016-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ *
+ * Answer requests for details over a Unix domain socket.
+ *
+ * Each client sends a single line of the form:
+ *
+ *     <format>[ <section>[,<section>...]]
+ *
+ * (for example "json meta,limits") and receives the rendered document
+ * for the specified sections (or all sections if none are specified),
+ * after which the connection is closed.
+ *--------------------------------------------------------------------
+ */
+
+#include "procenv.h"
+#include "serve.h"
+
+#if defined (PROCENV_PLATFORM_LINUX)
+#include <sys/epoll.h>
+#include <sys/un.h>
+#endif
+
+/* Section is collected once for the lifetime of the server */
+#define PROCENV_SERVE_TTL_FOREVER (-1L)
+
+/**
+ * struct procenv_serve_policy:
+ *
+ * @name: name of section,
+ * @ttl: time in milliseconds the section may be cached for.
+ **/
+struct procenv_serve_policy {
+	const char  *name;
+	long         ttl;
+};
+
+/**
+ * serve_ttl:
+ *
+ * Time in milliseconds that sections not listed in serve_policies
+ * (or specified via --serve-ttl) are cached for.
+ **/
+static long serve_ttl = PROCENV_SERVE_DEFAULT_TTL;
+
+/**
+ * serve_timeout:
+ *
+ * Time in milliseconds a client may remain idle before being
+ * disconnected.
+ **/
+static long serve_timeout = PROCENV_SERVE_DEFAULT_TIMEOUT;
+
+/**
+ * serve_policies:
+ *
+ * Default cache time of sections whose details either cannot change
+ * while the server is running, or which are only meaningful at the
+ * time of the request. All other sections are cached for serve_ttl
+ * milliseconds.
+ **/
+static const struct procenv_serve_policy serve_policies[] = {
+	{ "compiler"        , PROCENV_SERVE_TTL_FOREVER },
+	{ "confstr"         , PROCENV_SERVE_TTL_FOREVER },
+	{ "instruction set" , PROCENV_SERVE_TTL_FOREVER },
+	{ "meta"            , PROCENV_SERVE_TTL_FOREVER },
+	{ "ranges"          , PROCENV_SERVE_TTL_FOREVER },
+	{ "sizeof"          , PROCENV_SERVE_TTL_FOREVER },
+	{ "sysconf"         , PROCENV_SERVE_TTL_FOREVER },
+	{ "version"         , PROCENV_SERVE_TTL_FOREVER },
+
+	{ "clocks"          , 0 },
+	{ "rusage"          , 0 },
+	{ "time"            , 0 },
+
+	{ NULL, 0 }
+};
+
+/**
+ * serve_ttls, serve_ttl_count:
+ *
+ * Per-section cache times specified via --serve-ttl, which override
+ * serve_policies.
+ **/
+static struct procenv_serve_policy *serve_ttls = NULL;
+static size_t serve_ttl_count = 0;
+
+/**
+ * serve_parse_ms:
+ *
+ * @str: string to parse,
+ * @len: length of @str,
+ * @ms: [output] value of @str.
+ *
+ * Returns: true if @str is a valid number of milliseconds.
+ **/
+static bool
+serve_parse_ms (const char *str, size_t len, long *ms)
+{
+	struct procenv_field  field;
+	unsigned long         value;
+
+	assert (str);
+	assert (ms);
+
+	field.ptr = str;
+	field.len = len;
+
+	/* field_to_ulong() ignores trailing characters */
+	if (! len || strspn (str, "0123456789") != len)
+		return false;
+
+	if (! field_to_ulong (&field, &value) || value > LONG_MAX)
+		return false;
+
+	*ms = (long)value;
+
+	return true;
+}
+
+/**
+ * serve_set_ttl:
+ *
+ * @spec: comma-separated list of "[SECTION=]MS" values.
+ *
+ * Specify how long sections are cached for when serving. A value
+ * without a section name sets the time for all sections not listed
+ * in serve_policies.
+ **/
+void
+serve_set_ttl (const char *spec)
+{
+	const char  *p;
+	const char  *end;
+	const char  *equals;
+	size_t       len;
+	long         ms;
+
+	assert (spec);
+
+	for (p = spec; p; p = end ? end + 1 : NULL) {
+		end = strchr (p, ',');
+		len = end ? (size_t)(end - p) : strlen (p);
+
+		equals = memchr (p, '=', len);
+
+		if (! equals) {
+			if (! serve_parse_ms (p, len, &ms))
+				die ("invalid value for --serve-ttl: '%s'", spec);
+
+			serve_ttl = ms;
+			continue;
+		}
+
+		if (equals == p
+				|| ! serve_parse_ms (equals + 1, len - (size_t)(equals + 1 - p), &ms))
+			die ("invalid value for --serve-ttl: '%s'", spec);
+
+		serve_ttls = realloc (serve_ttls,
+				(serve_ttl_count + 1) * sizeof (struct procenv_serve_policy));
+		if (! serve_ttls)
+			die ("failed to allocate cache times");
+
+		serve_ttls[serve_ttl_count].name = strndup (p, (size_t)(equals - p));
+		if (! serve_ttls[serve_ttl_count].name)
+			die ("failed to allocate cache times");
+
+		serve_ttls[serve_ttl_count].ttl = ms;
+		serve_ttl_count++;
+	}
+}
+
+/**
+ * serve_set_timeout:
+ *
+ * @spec: number of milliseconds.
+ *
+ * Specify how long a client may be idle for before being
+ * disconnected.
+ **/
+void
+serve_set_timeout (const char *spec)
+{
+	assert (spec);
+
+	if (! serve_parse_ms (spec, strlen (spec), &serve_timeout) || ! serve_timeout)
+		die ("invalid value for --serve-timeout: '%s'", spec);
+}
+
+#if defined (PROCENV_PLATFORM_LINUX)
+
+#define PROCENV_SERVE_MAX_REQUEST 4096
+#define PROCENV_SERVE_MAX_EVENTS  64
+#define PROCENV_SERVE_BACKLOG     128
+
+/**
+ * struct procenv_serve_cache:
+ *
+ * @name: name of section,
+ * @ttl: time in milliseconds @tree remains valid for,
+ * @tree: recorded elements of section (or NULL if not yet collected),
+ * @collected: time @tree was recorded.
+ **/
+struct procenv_serve_cache {
+	const char           *name;
+	long                  ttl;
+	struct procenv_node  *tree;
+	struct timespec       collected;
+};
+
+/**
+ * struct procenv_serve_client:
+ *
+ * @fd: connected socket,
+ * @request: request line received so far,
+ * @request_len: number of bytes in @request,
+ * @response: rendered response (or NULL if request not yet complete),
+ * @response_len: length of @response,
+ * @sent: number of bytes of @response sent so far,
+ * @active: time in milliseconds the client was last active,
+ * @prev, @next: adjacent clients in serve_clients.
+ **/
+struct procenv_serve_client {
+	int      fd;
+	char     request[PROCENV_SERVE_MAX_REQUEST];
+	size_t   request_len;
+	char    *response;
+	size_t   response_len;
+	size_t   sent;
+	long     active;
+
+	struct procenv_serve_client  *prev;
+	struct procenv_serve_client  *next;
+};
+
+static struct procenv_serve_cache *serve_cache = NULL;
+static size_t serve_cache_count = 0;
+
+/**
+ * serve_clients, serve_clients_tail, serve_client_count:
+ *
+ * All connected clients, least recently active first.
+ **/
+static struct procenv_serve_client *serve_clients = NULL;
+static struct procenv_serve_client *serve_clients_tail = NULL;
+static size_t serve_client_count = 0;
+
+/**
+ * serve_spare_fd:
+ *
+ * File descriptor reserved such that when the file descriptor limit
+ * is reached, it can be released to accept and immediately close a
+ * pending connection (since otherwise the listening socket would
+ * remain readable, resulting in a busy loop).
+ **/
+static int serve_spare_fd = -1;
+
+/**
+ * serve_paused_count:
+ *
+ * If non-zero, the listening socket has been removed from the epoll
+ * set since no file descriptors were available, and the number of
+ * clients connected at that time.
+ **/
+static size_t serve_paused_count = 0;
+
+static volatile sig_atomic_t serve_quit = 0;
+
+static void
+serve_handle_signal (int signum)
+{
+	(void)signum;
+
+	serve_quit = 1;
+}
+
+static struct procenv_serve_cache *
+serve_cache_find (const char *name, size_t len)
+{
+	size_t i;
+
+	assert (name);
+
+	for (i = 0; i < serve_cache_count; i++) {
+		if (strlen (serve_cache[i].name) == len
+				&& ! strncmp (serve_cache[i].name, name, len))
+			return &serve_cache[i];
+	}
+
+	return NULL;
+}
+
+static void
+serve_cache_init (void)
+{
+	const struct procenv_serve_policy  *policy;
+	struct procenv_serve_cache         *entry;
+	const char                         *name;
+	size_t                              i;
+
+	for (i = 0; get_section_name (i); i++)
+		;
+
+	serve_cache_count = i;
+
+	serve_cache = calloc (serve_cache_count, sizeof (struct procenv_serve_cache));
+	if (! serve_cache)
+		die ("failed to allocate cache");
+
+	for (i = 0; i < serve_cache_count; i++) {
+		name = get_section_name (i);
+
+		serve_cache[i].name = name;
+		serve_cache[i].ttl = serve_ttl;
+
+		for (policy = serve_policies; policy->name; policy++) {
+			if (! strcmp (name, policy->name)) {
+				serve_cache[i].ttl = policy->ttl;
+				break;
+			}
+		}
+	}
+
+	/* Apply times specified on the command-line last */
+	for (i = 0; i < serve_ttl_count; i++) {
+		entry = serve_cache_find (serve_ttls[i].name, strlen (serve_ttls[i].name));
+		if (! entry)
+			die ("unknown section for --serve-ttl: '%s'", serve_ttls[i].name);
+
+		entry->ttl = serve_ttls[i].ttl;
+	}
+}
+
+static void
+serve_cache_free (void)
+{
+	size_t i;
+
+	for (i = 0; i < serve_cache_count; i++)
+		free_tree (serve_cache[i].tree);
+
+	free (serve_cache);
+	serve_cache = NULL;
+	serve_cache_count = 0;
+
+	for (i = 0; i < serve_ttl_count; i++)
+		free ((char *)serve_ttls[i].name);
+
+	free (serve_ttls);
+	serve_ttls = NULL;
+	serve_ttl_count = 0;
+}
+
+/**
+ * serve_now:
+ *
+ * Returns: current monotonic time in milliseconds.
+ **/
+static long
+serve_now (void)
+{
+	struct timespec now;
+
+	if (clock_gettime (CLOCK_MONOTONIC, &now) < 0)
+		die ("failed to query time");
+
+	return (now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * serve_cache_get:
+ *
+ * @entry: cache entry.
+ *
+ * Returns: elements recorded for section represented by @entry,
+ * collecting them again if the cached elements have expired.
+ **/
+static struct procenv_node *
+serve_cache_get (struct procenv_serve_cache *entry)
+{
+	struct timespec  now;
+	long             age;
+
+	assert (entry);
+
+	if (clock_gettime (CLOCK_MONOTONIC, &now) < 0)
+		die ("failed to query time");
+
+	if (entry->tree) {
+		if (entry->ttl == PROCENV_SERVE_TTL_FOREVER)
+			return entry->tree;
+
+		age = (now.tv_sec - entry->collected.tv_sec) * 1000
+			+ (now.tv_nsec - entry->collected.tv_nsec) / 1000000;
+
+		if (age < entry->ttl)
+			return entry->tree;
+
+		free_tree (entry->tree);
+		entry->tree = NULL;
+	}
+
+	record_start ();
+
+	if (! show_section (entry->name))
+		bug ("invalid section: '%s'", entry->name);
+
+	entry->tree = record_stop ();
+	entry->collected = now;
+
+	return entry->tree;
+}
+
+static void
+serve_error (struct procenv_serve_client *client, const char *msg,
+		const char *arg, size_t len)
+{
+	assert (client);
+	assert (msg);
+	assert (arg);
+
+	appendf (&client->response, "ERROR: %s: '%.*s'\n", msg, (int)len, arg);
+}
+
+/**
+ * serve_request:
+ *
+ * @client: client whose request line has been received.
+ *
+ * Render the response to the request made by @client.
+ **/
+static void
+serve_request (struct procenv_serve_client *client)
+{
+	struct procenv_serve_cache   *entry;
+	struct procenv_node         **trees = NULL;
+	size_t                        count = 0;
+	OutputFormat                  format;
+	OutputFormat                  saved_format;
+	pstring                      *rendered = NULL;
+	char                         *format_name;
+	char                         *names;
+	char                         *end;
+	char                         *p;
+	size_t                        i;
+
+	assert (client);
+
+	client->request[client->request_len] = '\0';
+
+	format_name = client->request;
+	format_name[strcspn (format_name, "\r\n")] = '\0';
+
+	names = strchr (format_name, ' ');
+	if (names)
+		*names++ = '\0';
+
+	if (! get_output_format_by_name (format_name, &format)) {
+		serve_error (client, "invalid output format",
+				format_name, strlen (format_name));
+		goto out;
+	}
+
+	if (names && *names) {
+		for (p = names; p; p = end ? end + 1 : NULL) {
+			end = strchr (p, ',');
+
+			entry = serve_cache_find (p, end ? (size_t)(end - p) : strlen (p));
+			if (! entry) {
+				serve_error (client, "unknown section",
+						p, end ? (size_t)(end - p) : strlen (p));
+				goto out;
+			}
+
+			trees = realloc (trees, (count + 1) * sizeof (struct procenv_node *));
+			if (! trees)
+				die ("failed to allocate trees");
+
+			trees[count++] = serve_cache_get (entry);
+		}
+	} else {
+		trees = calloc (serve_cache_count, sizeof (struct procenv_node *));
+		if (! trees)
+			die ("failed to allocate trees");
+
+		for (i = 0; i < serve_cache_count; i++)
+			trees[count++] = serve_cache_get (&serve_cache[i]);
+	}
+
+	saved_format = output_format;
+	output_format = format;
+
+	render_trees (trees, count, &rendered);
+
+	output_format = saved_format;
+
+	client->response = pstring_to_char (rendered);
+	if (! client->response)
+		die ("failed to convert output");
+
+	pstring_free (rendered);
+
+out:
+	free (trees);
+
+	client->response_len = strlen (client->response);
+	client->sent = 0;
+}
+
+static void
+serve_client_unlink (struct procenv_serve_client *client)
+{
+	assert (client);
+
+	if (client->prev)
+		client->prev->next = client->next;
+	else
+		serve_clients = client->next;
+
+	if (client->next)
+		client->next->prev = client->prev;
+	else
+		serve_clients_tail = client->prev;
+
+	client->prev = client->next = NULL;
+}
+
+/**
+ * serve_client_touch:
+ *
+ * @client: client that has just been active.
+ *
+ * Record activity by @client, moving it to the end of serve_clients
+ * such that the list remains ordered by time of last activity.
+ **/
+static void
+serve_client_touch (struct procenv_serve_client *client)
+{
+	assert (client);
+
+	if (client->prev || serve_clients == client)
+		serve_client_unlink (client);
+
+	client->active = serve_now ();
+
+	client->prev = serve_clients_tail;
+
+	if (serve_clients_tail)
+		serve_clients_tail->next = client;
+	else
+		serve_clients = client;
+
+	serve_clients_tail = client;
+}
+
+static void
+serve_client_free (struct procenv_serve_client *client)
+{
+	assert (client);
+
+	serve_client_unlink (client);
+	serve_client_count--;
+
+	close (client->fd);
+	free (client->response);
+	free (client);
+}
+
+/**
+ * serve_expire_clients:
+ *
+ * Disconnect all clients that have been idle for serve_timeout
+ * milliseconds.
+ *
+ * Returns: time in milliseconds until the next client will expire,
+ * or -1 if there are no clients.
+ **/
+static int
+serve_expire_clients (void)
+{
+	long  now;
+	long  remaining;
+
+	now = serve_now ();
+
+	while (serve_clients) {
+		remaining = serve_clients->active + serve_timeout - now;
+
+		if (remaining > 0)
+			return remaining > INT_MAX ? INT_MAX : (int)remaining;
+
+		serve_client_free (serve_clients);
+	}
+
+	return -1;
+}
+
+/**
+ * serve_client_read:
+ *
+ * @client: client to read from.
+ *
+ * Returns: false if @client should be disconnected, else true.
+ **/
+static bool
+serve_client_read (struct procenv_serve_client *client)
+{
+	ssize_t  ret;
+	bool     eof = false;
+
+	assert (client);
+
+	while (client->request_len < sizeof (client->request) - 1) {
+		ret = read (client->fd,
+				client->request + client->request_len,
+				sizeof (client->request) - 1 - client->request_len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+
+		if (! ret) {
+			eof = true;
+			break;
+		}
+
+		client->request_len += (size_t)ret;
+
+		if (memchr (client->request, '\n', client->request_len))
+			break;
+	}
+
+	if (memchr (client->request, '\n', client->request_len)
+			|| client->request_len == sizeof (client->request) - 1
+			|| (eof && client->request_len)) {
+		serve_request (client);
+		return true;
+	}
+
+	return ! eof;
+}
+
+/**
+ * serve_client_write:
+ *
+ * @client: client to send response to.
+ *
+ * Returns: true if the response has been sent (or the client has
+ * disconnected), else false.
+ **/
+static bool
+serve_client_write (struct procenv_serve_client *client)
+{
+	ssize_t ret;
+
+	assert (client);
+	assert (client->response);
+
+	while (client->sent < client->response_len) {
+		ret = send (client->fd,
+				client->response + client->sent,
+				client->response_len - client->sent,
+				MSG_NOSIGNAL);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			return true;
+		}
+
+		client->sent += (size_t)ret;
+	}
+
+	return true;
+}
+
+static int
+serve_listen (const char *path)
+{
+	struct sockaddr_un  addr;
+	struct stat         st;
+	int                 fd;
+
+	assert (path);
+
+	if (strlen (path) >= sizeof (addr.sun_path))
+		die ("socket path too long: '%s'", path);
+
+	/* Remove a socket left behind by a previous instance */
+	if (! lstat (path, &st)) {
+		if (! S_ISSOCK (st.st_mode))
+			die ("not a socket: '%s'", path);
+
+		if (unlink (path) < 0)
+			die ("failed to remove socket '%s': %s", path, strerror (errno));
+	}
+
+	fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		die ("failed to create socket: %s", strerror (errno));
+
+	memset (&addr, '\0', sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+
+	if (bind (fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+		die ("failed to bind to '%s': %s", path, strerror (errno));
+
+	if (listen (fd, PROCENV_SERVE_BACKLOG) < 0)
+		die ("failed to listen on '%s': %s", path, strerror (errno));
+
+	return fd;
+}
+
+static void
+serve_reserve_fd (void)
+{
+	if (serve_spare_fd < 0)
+		serve_spare_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+static void
+serve_listen_watch (int epoll_fd, int listen_fd)
+{
+	struct epoll_event event;
+
+	memset (&event, '\0', sizeof (event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0)
+		die ("failed to watch socket: %s", strerror (errno));
+}
+
+/**
+ * serve_shed:
+ *
+ * @epoll_fd: epoll instance,
+ * @listen_fd: listening socket.
+ *
+ * Handle exhaustion of file descriptors by rejecting a pending
+ * connection using the spare file descriptor or, if that is not
+ * available, by ignoring the listening socket until a client
+ * disconnects.
+ *
+ * Returns: true if a connection was rejected and further connections
+ * may be accepted.
+ **/
+static bool
+serve_shed (int epoll_fd, int listen_fd)
+{
+	int  fd;
+	int  saved;
+
+	if (serve_spare_fd >= 0) {
+		close (serve_spare_fd);
+		serve_spare_fd = -1;
+
+		fd = accept4 (listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		saved = errno;
+
+		if (fd >= 0)
+			close (fd);
+
+		serve_reserve_fd ();
+
+		if (fd >= 0)
+			return true;
+
+		/* No more pending connections */
+		if (saved == EAGAIN || saved == EWOULDBLOCK)
+			return false;
+	}
+
+	if (epoll_ctl (epoll_fd, EPOLL_CTL_DEL, listen_fd, NULL) < 0)
+		die ("failed to ignore socket: %s", strerror (errno));
+
+	/* Ensure non-zero even if there are no clients */
+	serve_paused_count = serve_client_count + 1;
+
+	return false;
+}
+
+static void
+serve_accept (int epoll_fd, int listen_fd)
+{
+	struct procenv_serve_client  *client;
+	struct epoll_event            event;
+	int                           fd;
+
+	while (true) {
+		fd = accept4 (listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			if ((errno == EMFILE || errno == ENFILE)
+					&& serve_shed (epoll_fd, listen_fd))
+				continue;
+
+			/* EAGAIN, or out of resources: try again later */
+			return;
+		}
+
+		client = calloc (1, sizeof (struct procenv_serve_client));
+		if (! client)
+			die ("failed to allocate client");
+
+		client->fd = fd;
+
+		serve_client_count++;
+		serve_client_touch (client);
+
+		memset (&event, '\0', sizeof (event));
+		event.events = EPOLLIN;
+		event.data.ptr = client;
+
+		if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+			die ("failed to add client: %s", strerror (errno));
+	}
+}
+
+static void
+serve_client (int epoll_fd, struct procenv_serve_client *client,
+		uint32_t events)
+{
+	struct epoll_event event;
+
+	assert (client);
+
+	serve_client_touch (client);
+
+	if (! client->response) {
+		if (! serve_client_read (client)) {
+			serve_client_free (client);
+			return;
+		}
+
+		if (! client->response)
+			return;
+	} else if (! (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+		return;
+	}
+
+	if (serve_client_write (client)) {
+		serve_client_free (client);
+		return;
+	}
+
+	/* Wait until the client can accept more of the response */
+	memset (&event, '\0', sizeof (event));
+	event.events = EPOLLOUT;
+	event.data.ptr = client;
+
+	if (epoll_ctl (epoll_fd, EPOLL_CTL_MOD, client->fd, &event) < 0)
+		die ("failed to modify client: %s", strerror (errno));
+}
+
+/**
+ * serve:
+ *
+ * @path: path of Unix domain socket to listen on.
+ *
+ * Answer requests on @path until terminated by SIGINT or SIGTERM.
+ **/
+void
+serve (const char *path)
+{
+	struct epoll_event  events[PROCENV_SERVE_MAX_EVENTS];
+	struct sigaction    act;
+	sigset_t            blocked;
+	sigset_t            wait_mask;
+	int                 listen_fd;
+	int                 epoll_fd;
+	int                 timeout;
+	int                 ready;
+	int                 i;
+
+	assert (path);
+
+	memset (&act, '\0', sizeof (act));
+	act.sa_handler = serve_handle_signal;
+	sigemptyset (&act.sa_mask);
+
+	/* Deliberately not SA_RESTART to interrupt epoll_pwait(2) */
+	if (sigaction (SIGINT, &act, NULL) < 0 || sigaction (SIGTERM, &act, NULL) < 0)
+		die ("failed to install signal handler");
+
+	/* Only allow the signals to be delivered while waiting, since
+	 * otherwise one arriving after serve_quit has been checked
+	 * would not interrupt the wait.
+	 */
+	sigemptyset (&blocked);
+	sigaddset (&blocked, SIGINT);
+	sigaddset (&blocked, SIGTERM);
+
+	if (sigprocmask (SIG_BLOCK, &blocked, &wait_mask) < 0)
+		die ("failed to block signals");
+
+	serve_cache_init ();
+
+	listen_fd = serve_listen (path);
+
+	epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		die ("failed to create epoll instance: %s", strerror (errno));
+
+	serve_listen_watch (epoll_fd, listen_fd);
+
+	serve_reserve_fd ();
+
+	while (! serve_quit) {
+		timeout = serve_expire_clients ();
+
+		/* Resume accepting connections once a client has gone */
+		if (serve_paused_count && serve_client_count < serve_paused_count) {
+			serve_reserve_fd ();
+			serve_listen_watch (epoll_fd, listen_fd);
+			serve_paused_count = 0;
+		}
+
+		ready = epoll_pwait (epoll_fd, events, PROCENV_SERVE_MAX_EVENTS,
+				timeout, &wait_mask);
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			die ("failed to wait for events: %s", strerror (errno));
+		}
+
+		for (i = 0; i < ready; i++) {
+			if (! events[i].data.ptr)
+				serve_accept (epoll_fd, listen_fd);
+			else
+				serve_client (epoll_fd, events[i].data.ptr, events[i].events);
+		}
+	}
+
+	while (serve_clients)
+		serve_client_free (serve_clients);
+
+	if (serve_spare_fd >= 0) {
+		close (serve_spare_fd);
+		serve_spare_fd = -1;
+	}
+
+	close (epoll_fd);
+	close (listen_fd);
+
+	(void)unlink (path);
+
+	serve_cache_free ();
+
+	(void)sigprocmask (SIG_SETMASK, &wait_mask, NULL);
+}
+
+#else /* ! PROCENV_PLATFORM_LINUX */
+
+void
+serve (const char *path)
+{
+	(void)path;
+
+	die ("--serve is not supported on this platform");
+}
+
+#endif /* PROCENV_PLATFORM_LINUX */
@@ -0,0 +1,23 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2016-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ */
+
+#ifndef _PROCENV_SERVE_H
+#define _PROCENV_SERVE_H
+
+/* Default time in milliseconds that volatile sections are cached
+ * for when serving.
+ */
+#define PROCENV_SERVE_DEFAULT_TTL 1000
+
+/* Default time in milliseconds a client may be idle for */
+#define PROCENV_SERVE_DEFAULT_TIMEOUT 5000
+
+void serve_set_ttl (const char *spec);
+void serve_set_timeout (const char *spec);
+void serve (const char *path);
+
+#endif /* _PROCENV_SERVE_H */
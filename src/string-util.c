@@ -7,6 +7,9 @@
 
 #include "string-util.h"
 
+#include <ctype.h>
+#include <limits.h>
+
 /* append @src to @dest */
 void
 append (char **dest, const char *src)
@@ -282,8 +285,8 @@ appendva (char **dest, const char *fmt, va_list ap)
 			break;
 		}
 
-		/* Bump to allow one char to be written */
-		len++;
+		/* vsnprintf(3) returns the space required */
+		len = ret + 1;
 
 		/* recalculate number of bytes */
 		bytes = (1 + len) * sizeof (char);
@@ -336,9 +339,14 @@ wappendva (pstring **dest, const wchar_t *fmt, va_list ap)
 	 */
 	while (true) {
 		va_copy (ap_copy, ap);
+		errno = 0;
 		ret = vswprintf (new, len, fmt, ap_copy);
 		va_end (ap_copy);
 
+		/* Retrying would never succeed */
+		if (ret < 0 && errno == EILSEQ)
+			die ("failed to convert multi-byte string");
+
 		if ((size_t)ret < len) {
 			/* now we have sufficient space, so update for
 			 * actual number of bytes used (including the
@@ -353,8 +361,11 @@ wappendva (pstring **dest, const wchar_t *fmt, va_list ap)
 			break;
 		}
 
-		/* Bump to allow one more wide-char to be written */
-		len++;
+		/* vswprintf(3) does not report the space required, so
+		 * double it to avoid reformatting the string once per
+		 * character.
+		 */
+		len *= 2;
 
 		/* recalculate number of bytes */
 		bytes = (1 + len) * sizeof (wchar_t);
@@ -465,68 +476,420 @@ pappend (pstring **dest, const pstring *src)
 }
 
 /**
+ * split_fields:
+ *
  * @string: input,
  * @delimiter: field delimiter,
- * @compress: if true, ignore repeated contiguous delimiter characters,
- * @array: [output] array of fields, which this function will allocate.
+ * @compress: if true, ignore repeated contiguous delimiter characters
+ *  (otherwise they denote empty fields),
+ * @fields: [output] array of views into @string,
+ * @max: number of elements in @fields.
  *
- * Notes: it is the callers responsibility to free @array
- * if the returned value is >0.
+ * Split @string into fields without allocating or modifying @string.
+ * A trailing newline is not considered part of the last field. Only
+ * the first @max fields are stored in @fields.
  *
- * Returns: number of fields in @string.
+ * Returns: number of fields in @string (which may exceed @max).
  **/
 size_t
-split_fields (const char *string, char delimiter, int compress, char ***array)
+split_fields (const char *string, char delimiter, int compress,
+		struct procenv_field *fields, size_t max)
 {
-	const char  *p = NULL;
-	const char  *start = NULL;
+	const char  *p;
+	const char  *start;
 	size_t       count = 0;
-	char        *elem;
-	char       **new;
 
 	assert (string);
 	assert (delimiter);
-	assert (array);
-
-	*array = NULL;
-
-	new = realloc ((*array), sizeof (char *) * (1+count));
-	assert (new);
-
-	new[0] = NULL;
-	*array = new;
+	assert (fields || ! max);
 
 	p = string;
 
-	while (p && *p) {
-		/* skip leading prefix */
-		while (compress && p && *p == delimiter)
+	while (*p && *p != '\n') {
+		/* skip leading delimiters */
+		while (compress && *p == delimiter)
 			p++;
 
-		if (! *p)
+		if (! *p || *p == '\n')
 			break;
 
-		/* found a field */
+		start = p;
+		while (*p && *p != delimiter && *p != '\n')
+			p++;
+
+		if (count < max) {
+			fields[count].ptr = start;
+			fields[count].len = (size_t)(p - start);
+		}
+
 		count++;
 
-		if (! compress)
+		if (*p == delimiter) {
 			p++;
 
-		/* skip over the field */
-		start = p;
-		while (p && *p && *p != delimiter)
-			p++;
+			/* trailing empty field */
+			if (! compress && (! *p || *p == '\n')) {
+				if (count < max) {
+					fields[count].ptr = p;
+					fields[count].len = 0;
+				}
+				count++;
+			}
+		}
+	}
 
-		elem = strndup (start, p-start);
-		assert (elem);
+	return count;
+}
 
-		new = realloc ((*array), sizeof (char *) * (1+count));
-		assert (new);
+/**
+ * split_proc_stat:
+ *
+ * @string: contents of a /proc/<pid>/stat file,
+ * @fields: [output] array of views into @string,
+ * @max: number of elements in @fields.
+ *
+ * Split @string into fields. The second field (the command name) is
+ * returned without its surrounding parentheses and may itself contain
+ * spaces and parentheses, so is delimited by the _last_ closing
+ * parenthesis in @string.
+ *
+ * Field numbers in proc(5) are one-based, so field N is @fields[N-1].
+ *
+ * Returns: number of fields in @string (which may exceed @max), or
+ * zero if @string is not in the expected format.
+ **/
+size_t
+split_proc_stat (const char *string,
+		struct procenv_field *fields, size_t max)
+{
+	const char  *open;
+	const char  *close;
+	size_t       len;
+	size_t       count;
+
+	assert (string);
+	assert (fields || ! max);
+
+	open = strchr (string, '(');
+	close = strrchr (string, ')');
+
+	if (! open || ! close || close < open)
+		return 0;
 
-		new[count-1] = elem;
-		*array = new;
+	/* pid (excluding the space before the command name) */
+	len = (size_t)(open - string);
+
+	while (len && string[len-1] == ' ')
+		len--;
+
+	if (! len)
+		return 0;
+
+	if (max) {
+		fields[0].ptr = string;
+		fields[0].len = len;
 	}
 
+	/* comm */
+	if (max > 1) {
+		fields[1].ptr = open + 1;
+		fields[1].len = (size_t)(close - (open + 1));
+	}
+
+	count = 2;
+
+	count += split_fields (close + 1, ' ', true,
+			max > count ? fields + count : NULL,
+			max > count ? max - count : 0);
+
 	return count;
 }
 
+/**
+ * field_to_ulong:
+ *
+ * @field: field to convert,
+ * @value: [output] numeric value of @field.
+ *
+ * Convert the leading decimal digits of @field to a number. Any
+ * suffix (such as " kB") is ignored.
+ *
+ * Returns: true on success, or false if @field does not start with a
+ * digit or the value would overflow.
+ **/
+bool
+field_to_ulong (const struct procenv_field *field, unsigned long *value)
+{
+	unsigned long  result = 0;
+	unsigned long  digit;
+	size_t         i;
+
+	assert (field);
+	assert (value);
+
+	if (! field->ptr || ! field->len || field->ptr[0] < '0' || field->ptr[0] > '9')
+		return false;
+
+	for (i = 0; i < field->len && field->ptr[i] >= '0' && field->ptr[i] <= '9'; i++) {
+		digit = (unsigned long)(field->ptr[i] - '0');
+
+		if (result > (ULONG_MAX - digit) / 10)
+			return false;
+
+		result = (result * 10) + digit;
+	}
+
+	*value = result;
+
+	return true;
+}
+
+/**
+ * kv_hash:
+ *
+ * @key: key to hash,
+ * @len: length of @key.
+ *
+ * Returns: 32-bit FNV-1a hash of @key.
+ **/
+static uint32_t
+kv_hash (const char *key, size_t len)
+{
+	uint32_t  hash = 2166136261U;
+	size_t    i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/**
+ * kv_slot:
+ *
+ * @hash: hash of key,
+ * @seed: hash seed,
+ * @mask: number of slots - 1.
+ *
+ * Returns: slot for @hash when using @seed. Since only this function
+ * depends on @seed, the keys need only be hashed once when searching
+ * for a seed.
+ **/
+static uint32_t
+kv_slot (uint32_t hash, uint32_t seed, uint32_t mask)
+{
+	hash ^= seed;
+	hash *= 0x9e3779b1U;
+
+	/* the low bits are used as the slot so mix in the high bits */
+	return (hash ^ (hash >> 16)) & mask;
+}
+
+/**
+ * kv_table_init:
+ *
+ * @table: table to initialise.
+ *
+ * Initialise @table such that keys can be added with kv_table_add().
+ **/
+void
+kv_table_init (struct procenv_kv_table *table)
+{
+	assert (table);
+
+	memset (table, '\0', sizeof (*table));
+}
+
+/**
+ * kv_table_add:
+ *
+ * @table: table to operate on,
+ * @key: key to add.
+ *
+ * Add @key to @table. kv_table_build() must be called after all keys
+ * have been added.
+ *
+ * Returns: index of @key in @table (which is also the index of its
+ * value in the array filled by kv_parse()).
+ **/
+size_t
+kv_table_add (struct procenv_kv_table *table, const char *key)
+{
+	assert (table);
+	assert (key);
+
+	if (table->count == PROCENV_KV_MAX_KEYS)
+		bug ("too many keys for table (max %d)", PROCENV_KV_MAX_KEYS);
+
+	table->keys[table->count] = key;
+	table->lens[table->count] = strlen (key);
+	table->hashes[table->count] = kv_hash (key, table->lens[table->count]);
+
+	return table->count++;
+}
+
+/**
+ * kv_table_try_seed:
+ *
+ * @table: table to operate on,
+ * @size: number of slots to use,
+ * @seed: hash seed.
+ *
+ * Returns: true if @seed maps every key in @table to a different slot
+ * (leaving the slots populated), else false.
+ **/
+static bool
+kv_table_try_seed (struct procenv_kv_table *table, uint32_t size, uint32_t seed)
+{
+	uint32_t  slot;
+	size_t    i;
+
+	memset (table->slots, '\0', size);
+
+	for (i = 0; i < table->count; i++) {
+		slot = kv_slot (table->hashes[i], seed, size - 1);
+
+		if (table->slots[slot])
+			return false;
+
+		table->slots[slot] = (uint8_t)(i + 1);
+	}
+
+	table->seed = seed;
+	table->mask = size - 1;
+
+	return true;
+}
+
+/**
+ * kv_table_build:
+ *
+ * @table: table to operate on.
+ *
+ * Find a hash seed for which every key in @table hashes to a
+ * different slot such that a lookup requires a single hash and
+ * comparison (a perfect hash).
+ *
+ * Failure to find a suitable seed is fatal.
+ **/
+void
+kv_table_build (struct procenv_kv_table *table)
+{
+	uint32_t  size;
+	uint32_t  seed;
+
+	assert (table);
+
+	/* start with a load factor of at most 50% */
+	for (size = 2; size < table->count * 2; size *= 2)
+		;
+
+	for (; size <= PROCENV_KV_MAX_SLOTS; size *= 2) {
+		for (seed = 0; seed < PROCENV_KV_SEED_ATTEMPTS; seed++) {
+			if (kv_table_try_seed (table, size, seed))
+				return;
+		}
+	}
+
+	bug ("failed to build perfect hash for %lu keys",
+			(unsigned long)table->count);
+}
+
+/**
+ * kv_table_lookup:
+ *
+ * @table: table to operate on,
+ * @key: key to find (need not be nul-terminated),
+ * @len: length of @key.
+ *
+ * Returns: index of @key in @table, or -1 if not found.
+ **/
+int
+kv_table_lookup (const struct procenv_kv_table *table,
+		const char *key, size_t len)
+{
+	uint32_t  slot;
+	int       i;
+
+	assert (table);
+	assert (key);
+
+	slot = kv_slot (kv_hash (key, len), table->seed, table->mask);
+
+	if (! table->slots[slot])
+		return -1;
+
+	i = table->slots[slot] - 1;
+
+	if (table->lens[i] != len || memcmp (table->keys[i], key, len))
+		return -1;
+
+	return i;
+}
+
+/**
+ * kv_parse:
+ *
+ * @table: keys to find,
+ * @buffer: nul-terminated file contents comprising lines of the form
+ *  "key<separator> value",
+ * @separator: character separating keys from values,
+ * @values: [output] array of at least @table->count elements.
+ *
+ * Find the value of every key in @table without allocating or
+ * modifying @buffer. Whitespace surrounding each value is ignored.
+ * Where a key occurs more than once, the first value is used. Keys
+ * that are not found have a NULL @ptr in @values.
+ *
+ * Returns: number of keys found.
+ **/
+size_t
+kv_parse (const struct procenv_kv_table *table,
+		const char *buffer, char separator,
+		struct procenv_field *values)
+{
+	const char  *line;
+	const char  *sep;
+	const char  *end;
+	const char  *value;
+	size_t       found = 0;
+	int          i;
+
+	assert (table);
+	assert (buffer);
+	assert (values);
+
+	memset (values, '\0', sizeof (struct procenv_field) * table->count);
+
+	for (line = buffer; *line && found < table->count; line = end) {
+		end = strchrnul (line, '\n');
+
+		sep = memchr (line, separator, (size_t)(end - line));
+
+		if (*end)
+			end++;
+
+		if (! sep)
+			continue;
+
+		i = kv_table_lookup (table, line, (size_t)(sep - line));
+		if (i < 0 || values[i].ptr)
+			continue;
+
+		for (value = sep + 1; *value == ' ' || *value == '\t'; value++)
+			;
+
+		sep = end;
+		while (sep > value && isspace ((unsigned char)sep[-1]))
+			sep--;
+
+		values[i].ptr = value;
+		values[i].len = (size_t)(sep - value);
+
+		found++;
+	}
+
+	return found;
+}
@@ -16,6 +16,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include "pstring.h"
@@ -24,6 +26,48 @@
 
 #define DEFAULT_ALLOC_GUESS_SIZE 8
 
+/* Maximum number of keys a struct procenv_kv_table can hold */
+#define PROCENV_KV_MAX_KEYS 64
+
+/* Maximum number of hash slots a struct procenv_kv_table can use
+ * (must be a power of two).
+ */
+#define PROCENV_KV_MAX_SLOTS 1024
+
+/* Number of hash seeds tried for each table size before trying a
+ * larger table.
+ */
+#define PROCENV_KV_SEED_ATTEMPTS 256
+
+/* One-based numbers of fields in /proc/<pid>/stat (see proc(5)) */
+#define PROCENV_STAT_FIELD_STATE      3
+#define PROCENV_STAT_FIELD_UTIME      14
+#define PROCENV_STAT_FIELD_STIME      15
+#define PROCENV_STAT_FIELD_PROCESSOR  39
+
+/* View of part of a string: @ptr is *not* nul-terminated at @len */
+struct procenv_field {
+	const char  *ptr;
+	size_t       len;
+};
+
+/* Keys to extract from a "key: value" file (such as
+ * /proc/self/status or /proc/meminfo) along with a collision-free
+ * hash table to find them.
+ */
+struct procenv_kv_table {
+	const char  *keys[PROCENV_KV_MAX_KEYS];
+	size_t       lens[PROCENV_KV_MAX_KEYS];
+	uint32_t     hashes[PROCENV_KV_MAX_KEYS];
+	size_t       count;
+
+	uint32_t     seed;
+	uint32_t     mask;
+
+	/* Index+1 of key in each slot (0 denotes an empty slot) */
+	uint8_t      slots[PROCENV_KV_MAX_SLOTS];
+};
+
 /* operate on multi-bytes */
 void append (char **dest, const char *src);
 void appendn (char **dest, const char *src, size_t len);
@@ -43,7 +87,20 @@ void wmappendf (pstring **dest, const char *fmt, ...);
 void wmappendva (pstring **dest, const char *fmt, va_list ap);
 
 void pappend (pstring **dest, const pstring *src);
-size_t split_fields (const char *string, char delimiter,
-		     int compress, char ***array);
+size_t split_fields (const char *string, char delimiter, int compress,
+		     struct procenv_field *fields, size_t max);
+size_t split_proc_stat (const char *string,
+		     struct procenv_field *fields, size_t max);
+bool field_to_ulong (const struct procenv_field *field,
+		     unsigned long *value);
+
+void kv_table_init (struct procenv_kv_table *table);
+size_t kv_table_add (struct procenv_kv_table *table, const char *key);
+void kv_table_build (struct procenv_kv_table *table);
+int kv_table_lookup (const struct procenv_kv_table *table,
+		     const char *key, size_t len);
+size_t kv_parse (const struct procenv_kv_table *table,
+		     const char *buffer, char separator,
+		     struct procenv_field *values);
 
 #endif /* _PROCENV_STRING_UTIL_H */
@@ -0,0 +1,172 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2015-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ * Description: Microbenchmark for the output formatter.
+ *
+ * Formats a document comprising a section of entries and a container
+ * of objects in each output format and reports the mean time taken
+ * per element.
+ *
+ * Usage: bench_output [iterations]
+ *
+ * Not run by 'make check': build with 'make bench_output'.
+ *--------------------------------------------------------------------
+ */
+
+#include "procenv.h"
+
+#include <time.h>
+
+#define BENCH_DEFAULT_ITERATIONS 2000
+
+/* Number of times to repeat each measurement (the fastest is reported
+ * to reduce noise).
+ */
+#define BENCH_REPEATS 5
+
+/* Number of entries and objects in each document */
+#define BENCH_ENTRIES 100
+#define BENCH_OBJECTS 50
+
+/* Elements that result in a call to the formatter per document */
+#define BENCH_ELEMENTS \
+    (1 + BENCH_ENTRIES + 1 + (BENCH_OBJECTS * 3) + 1 + 1)
+
+extern const char *program_name;
+extern ElementType last_element;
+extern ElementType current_element;
+
+static const struct {
+    const char    *name;
+    OutputFormat   format;
+} bench_formats[] = {
+    { "crumb", OUTPUT_FORMAT_CRUMB },
+    { "json",  OUTPUT_FORMAT_JSON  },
+    { "text",  OUTPUT_FORMAT_TEXT  },
+    { "xml",   OUTPUT_FORMAT_XML   },
+};
+
+#define BENCH_FORMAT_COUNT (sizeof (bench_formats) / sizeof (bench_formats[0]))
+
+/* Replaces the library implementation: within the benchmark, every
+ * die() and bug() call is a failure.
+ */
+void
+procenv_lib_fail (const char *prefix, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "%s: ", prefix);
+
+    va_start (ap, fmt);
+    vfprintf (stderr, fmt, ap);
+    va_end (ap);
+
+    fputc ('\n', stderr);
+
+    abort ();
+}
+
+static double
+now (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) < 0) {
+        perror ("bench_output: failed to read clock");
+        exit (EXIT_FAILURE);
+    }
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static void
+format_document (void)
+{
+    int i;
+
+    doc = pstring_new ();
+    if (! doc)
+        abort ();
+
+    reset_indent ();
+    last_element = current_element = ELEMENT_TYPE_NONE;
+
+    master_header (&doc);
+
+    section_open ("section");
+
+    for (i = 0; i < BENCH_ENTRIES; i++)
+        entry ("entry", "%d", i);
+
+    container_open ("container");
+
+    for (i = 0; i < BENCH_OBJECTS; i++) {
+        object_open (false);
+        entry ("object", "%d", i);
+        object_close (false);
+    }
+
+    container_close ();
+
+    section_close ();
+
+    master_footer (&doc);
+
+    pstring_free (doc);
+    doc = NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+    unsigned long  iterations = BENCH_DEFAULT_ITERATIONS;
+    double         start;
+    double         elapsed;
+    double         best;
+    unsigned long  i;
+    size_t         f;
+    int            repeat;
+
+    if (argc > 1)
+        iterations = strtoul (argv[1], NULL, 10);
+
+    if (! iterations) {
+        fprintf (stderr, "Usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    (void)setlocale (LC_ALL, "");
+
+    program_name = "bench_output";
+
+    handle_indent_char ();
+
+    for (f = 0; f < BENCH_FORMAT_COUNT; f++) {
+        output_format = bench_formats[f].format;
+
+        /* warm up */
+        format_document ();
+
+        best = 0;
+
+        for (repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+            start = now ();
+
+            for (i = 0; i < iterations; i++)
+                format_document ();
+
+            elapsed = now () - start;
+
+            if (! best || elapsed < best)
+                best = elapsed;
+        }
+
+        printf ("%-5s: %8.1f ns/element\n", bench_formats[f].name,
+                best / ((double)iterations * BENCH_ELEMENTS));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2015-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ * Description: Microbenchmark for building sorted lists.
+ *
+ * Builds a sorted list of pseudo-random strings by:
+ *
+ * - inserting each entry in order (pr_list_prepend_str_sorted()).
+ * - adding all entries then sorting once (pr_list_sort_str()).
+ * - as above, but allocating entries from a PRListPool.
+ *
+ * Usage: bench_pr_list [entries]
+ *
+ * Note that the sorted insert case is O(n^2) so takes minutes at the
+ * default number of entries.
+ *
+ * Not run by 'make check': build with 'make bench_pr_list'.
+ *--------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <pr_list.h>
+
+#define BENCH_DEFAULT_ENTRIES 100000
+
+static char **strings;
+
+static double
+now (void)
+{
+    struct timespec ts;
+
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) < 0) {
+        perror ("bench_pr_list: failed to read clock");
+        exit (EXIT_FAILURE);
+    }
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static void
+make_strings (size_t count)
+{
+    uint32_t  state = 2463534242U;
+    char      str[32];
+    size_t    i;
+
+    strings = calloc (count, sizeof (char *));
+    if (! strings)
+        abort ();
+
+    for (i = 0; i < count; i++) {
+        /* xorshift32 */
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        sprintf (str, "entry-%08x", state);
+
+        strings[i] = strdup (str);
+        if (! strings[i])
+            abort ();
+    }
+}
+
+static void
+check_sorted (PRList *list, size_t count)
+{
+    size_t n = 0;
+
+    PR_LIST_FOREACH (list, iter) {
+        if (iter->next != list
+                && strcmp (iter->data, iter->next->data) > 0) {
+            fprintf (stderr, "bench_pr_list: list not sorted\n");
+            exit (EXIT_FAILURE);
+        }
+        n++;
+    }
+
+    if (n != count) {
+        fprintf (stderr, "bench_pr_list: expected %lu entries, found %lu\n",
+                (unsigned long)count, (unsigned long)n);
+        exit (EXIT_FAILURE);
+    }
+}
+
+static void
+free_list (PRList *list)
+{
+    PR_LIST_FOREACH_SAFE (list, iter) {
+        pr_list_remove (iter);
+        free (iter->data);
+        free (iter);
+    }
+
+    free (list);
+}
+
+static double
+bench_sorted_insert (size_t count)
+{
+    PRList  *list;
+    PRList  *entry;
+    double   start;
+    double   elapsed;
+    size_t   i;
+
+    start = now ();
+
+    list = pr_list_new (NULL);
+    if (! list)
+        abort ();
+
+    for (i = 0; i < count; i++) {
+        entry = pr_list_new (strdup (strings[i]));
+        if (! entry || ! entry->data)
+            abort ();
+
+        pr_list_prepend_str_sorted (list, entry);
+    }
+
+    elapsed = now () - start;
+
+    check_sorted (list, count);
+    free_list (list);
+
+    return elapsed;
+}
+
+static double
+bench_sort (size_t count)
+{
+    PRList  *list;
+    double   start;
+    double   elapsed;
+    size_t   i;
+
+    start = now ();
+
+    list = pr_list_new (NULL);
+    if (! list)
+        abort ();
+
+    for (i = 0; i < count; i++)
+        pr_list_prepend_str (list, strings[i]);
+
+    pr_list_sort_str (list);
+
+    elapsed = now () - start;
+
+    check_sorted (list, count);
+    free_list (list);
+
+    return elapsed;
+}
+
+static double
+bench_pool_sort (size_t count)
+{
+    PRListPool  *pool;
+    PRList      *list;
+    double       start;
+    double       elapsed;
+    size_t       i;
+
+    start = now ();
+
+    pool = pr_list_pool_new ();
+    if (! pool)
+        abort ();
+
+    list = pr_list_pool_new_entry (pool, NULL);
+    if (! list)
+        abort ();
+
+    for (i = 0; i < count; i++) {
+        if (! pr_list_pool_prepend_str (pool, list, strings[i]))
+            abort ();
+    }
+
+    pr_list_sort_str (list);
+
+    elapsed = now () - start;
+
+    check_sorted (list, count);
+    pr_list_pool_free (pool);
+
+    return elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+    size_t count = BENCH_DEFAULT_ENTRIES;
+    size_t i;
+
+    if (argc > 1)
+        count = strtoul (argv[1], NULL, 10);
+
+    if (! count) {
+        fprintf (stderr, "Usage: %s [entries]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    make_strings (count);
+
+    printf ("entries      : %lu\n", (unsigned long)count);
+    printf ("pool+sort    : %10.3f ms\n", bench_pool_sort (count) / 1e6);
+    printf ("append+sort  : %10.3f ms\n", bench_sort (count) / 1e6);
+    printf ("sorted insert: %10.3f ms\n", bench_sorted_insert (count) / 1e6);
+
+    for (i = 0; i < count; i++)
+        free (strings[i]);
+
+    free (strings);
+
+    return EXIT_SUCCESS;
+}
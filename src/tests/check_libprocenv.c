@@ -0,0 +1,220 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2015-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ * Description: check(*) tests for the in-process library interface.
+ *
+ * (*) - check unit test program (see http://check.sourceforge.net/).
+ *--------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <dirent.h>
+
+#include <libprocenv.h>
+#include <check.h>
+
+#define THREADS 4
+
+#if defined (__linux__)
+/* The library only exports its public API, so a program may define
+ * symbols with the same names as the procenv internals.
+ */
+int output = -1;
+void init (void) { }
+#endif
+
+/********************************************************************/
+
+static int
+count_fds (void)
+{
+    DIR            *dir;
+    struct dirent  *ent;
+    int             count = 0;
+
+    dir = opendir ("/proc/self/fd");
+    if (! dir)
+        return -1;
+
+    while ((ent = readdir (dir)))
+        count++;
+
+    closedir (dir);
+
+    return count;
+}
+
+static void *
+collect_and_render (void *arg)
+{
+    const char   *sections[] = { "meta", "limits", "uname", NULL };
+    procenv_ctx  *ctx;
+    char         *buf = NULL;
+    long          ok = 0;
+
+    (void)arg;
+
+    ctx = procenv_ctx_new ();
+    if (! ctx)
+        return (void *)ok;
+
+    if (! procenv_collect (ctx, sections)
+            && ! procenv_render (ctx, "json", &buf)
+            && strstr (buf, "\"format-type\" : \"json\"")
+            && strstr (buf, "\"RLIMIT_NOFILE\""))
+        ok = 1;
+
+    free (buf);
+    procenv_ctx_free (ctx);
+
+    return (void *)ok;
+}
+
+/********************************************************************/
+
+START_TEST(test_procenv_render_formats)
+{
+    const char   *sections[] = { "meta", NULL };
+    procenv_ctx  *ctx;
+    char         *buf = NULL;
+
+    ctx = procenv_ctx_new ();
+    ck_assert (ctx != NULL);
+
+    ck_assert_int_eq (procenv_collect (ctx, sections), 0);
+
+    /* The same collection may be rendered in multiple formats */
+    ck_assert_int_eq (procenv_render (ctx, "text", &buf), 0);
+    ck_assert (strstr (buf, "format-type: text") != NULL);
+    free (buf);
+
+    ck_assert_int_eq (procenv_render (ctx, "xml", &buf), 0);
+    ck_assert (strstr (buf, "<entry name=\"format-type\">xml</entry>") != NULL);
+    free (buf);
+
+    procenv_ctx_free (ctx);
+}
+END_TEST
+
+START_TEST(test_procenv_errors)
+{
+    const char   *sections[] = { "meta", "no such section", NULL };
+    procenv_ctx  *ctx;
+    char         *buf = NULL;
+
+    ctx = procenv_ctx_new ();
+    ck_assert (ctx != NULL);
+
+    /* Nothing collected yet */
+    ck_assert_int_eq (procenv_render (ctx, "json", &buf), -1);
+    ck_assert (buf == NULL);
+
+    /* Errors are returned rather than terminating the process */
+    ck_assert_int_eq (procenv_collect (ctx, sections), -1);
+    ck_assert (strstr (procenv_ctx_error (ctx), "no such section") != NULL);
+
+    sections[1] = NULL;
+    ck_assert_int_eq (procenv_collect (ctx, sections), 0);
+
+    ck_assert_int_eq (procenv_render (ctx, "no such format", &buf), -1);
+    ck_assert (buf == NULL);
+
+    procenv_ctx_free (ctx);
+}
+END_TEST
+
+START_TEST(test_procenv_resources)
+{
+    const char   *sections[] = { "file descriptors", "mounts", "network", "no such section", NULL };
+    procenv_ctx  *ctx;
+    int           fds;
+
+    ctx = procenv_ctx_new ();
+    ck_assert (ctx != NULL);
+
+    fds = count_fds ();
+
+    /* All sections */
+    ck_assert_int_eq (procenv_collect (ctx, NULL), 0);
+    ck_assert_int_eq (count_fds (), fds);
+
+    ck_assert_int_eq (procenv_collect (ctx, sections), -1);
+    ck_assert_int_eq (count_fds (), fds);
+
+#if defined (__linux__)
+    /* The program's own symbols are unaffected */
+    ck_assert_int_eq (output, -1);
+#endif
+
+    procenv_ctx_free (ctx);
+}
+END_TEST
+
+START_TEST(test_procenv_threads)
+{
+    pthread_t  threads[THREADS];
+    void      *ok;
+    int        i;
+
+    for (i = 0; i < THREADS; i++)
+        ck_assert_int_eq (pthread_create (&threads[i], NULL,
+                    collect_and_render, NULL), 0);
+
+    for (i = 0; i < THREADS; i++) {
+        ck_assert_int_eq (pthread_join (threads[i], &ok), 0);
+        ck_assert (ok != NULL);
+    }
+}
+END_TEST
+
+/********************************************************************/
+
+Suite *
+libprocenv_suite (void)
+{
+    Suite  *s;
+    TCase  *tc_core;
+
+    s = suite_create ("libprocenv");
+
+    tc_core = tcase_create ("core");
+
+    /*******************************/
+    /* Add each test */
+
+    tcase_add_test (tc_core, test_procenv_render_formats);
+    tcase_add_test (tc_core, test_procenv_errors);
+    tcase_add_test (tc_core, test_procenv_resources);
+    tcase_add_test (tc_core, test_procenv_threads);
+
+    /*******************************/
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+/********************************************************************/
+
+int
+main (int argc, char *argv[])
+{
+    Suite    *s;
+    SRunner  *sr;
+    int       number_failed;
+
+    s = libprocenv_suite ();
+    sr = srunner_create (s);
+
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (! number_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1353,6 +1353,293 @@ END_TEST
 
 /********************************************************************/
 
+/* Compare entries by the first character of their data only */
+static int
+pr_list_cmp_first_char (PRList *la, PRList *lb)
+{
+    return *(const char *)la->data - *(const char *)lb->data;
+}
+
+/* Check that the next and prev pointers of @list are consistent and
+ * that the list holds @expected_count entries.
+ */
+static void
+check_list_links (PRList *list, size_t expected_count)
+{
+    PRList *p;
+    size_t  n = 0;
+
+    for (p = list->next; p != list; p = p->next) {
+        ck_assert_ptr_eq (p->next->prev, p);
+        ck_assert_ptr_eq (p->prev->next, p);
+        n++;
+    }
+
+    ck_assert_ptr_eq (list->next->prev, list);
+    ck_assert_ptr_eq (list->prev->next, list);
+    ck_assert_uint_eq (n, expected_count);
+}
+
+START_TEST(test_pr_list_sort)
+{
+    PRList      *list;
+    PRList      *entry;
+    const char  *values[] = { "d", "b", "e", "a", "c" };
+    size_t       i;
+
+    list = pr_list_new (NULL);
+    ck_assert_ptr_ne (list, NULL);
+
+    /**********************************/
+    /* sorting an empty list is a no-op */
+    pr_list_sort_str (list);
+    ck_assert_ptr_eq (list->next, list);
+    ck_assert_ptr_eq (list->prev, list);
+
+    /**********************************/
+    /* single entry */
+    entry = pr_list_prepend_str (list, "a");
+    ck_assert_ptr_ne (entry, NULL);
+
+    pr_list_sort_str (list);
+    ck_assert_ptr_eq (list->next, entry);
+    ck_assert_ptr_eq (list->prev, entry);
+    ck_assert_ptr_eq (entry->next, list);
+    ck_assert_ptr_eq (entry->prev, list);
+
+    pr_list_remove (entry);
+    free ((char *)entry->data);
+    free (entry);
+
+    /**********************************/
+    /* multiple entries */
+    for (i = 0; i < sizeof (values) / sizeof (values[0]); i++) {
+        entry = pr_list_prepend_str (list, values[i]);
+        ck_assert_ptr_ne (entry, NULL);
+    }
+
+    pr_list_sort_str (list);
+    check_list_links (list, 5);
+
+    memset (buffer, '\0', sizeof(buffer));
+    count = 0;
+    pr_list_foreach_visit (list, pr_list_visit_save_data);
+    ck_assert_str_eq (buffer, "abcde");
+
+    memset (buffer, '\0', sizeof(buffer));
+    count = 0;
+    pr_list_foreach_rev_visit (list, pr_list_visit_save_data);
+    ck_assert_str_eq (buffer, "edcba");
+
+    /**********************************/
+    /* sorting a sorted list is a no-op */
+    pr_list_sort_str (list);
+    check_list_links (list, 5);
+
+    memset (buffer, '\0', sizeof(buffer));
+    count = 0;
+    pr_list_foreach_visit (list, pr_list_visit_save_data);
+    ck_assert_str_eq (buffer, "abcde");
+
+    PR_LIST_FOREACH_SAFE (list, iter) {
+        pr_list_remove (iter);
+        free ((char *)iter->data);
+        free (iter);
+    }
+
+    free (list);
+}
+END_TEST
+
+START_TEST(test_pr_list_sort_stable)
+{
+    PRList      *list;
+    PRList      *entry;
+    const char  *values[] = { "b1", "a1", "b2", "c1", "a2", "b3", "a3" };
+    const char  *expected[] = { "a1", "a2", "a3", "b1", "b2", "b3", "c1" };
+    size_t       i;
+
+    list = pr_list_new (NULL);
+    ck_assert_ptr_ne (list, NULL);
+
+    for (i = 0; i < sizeof (values) / sizeof (values[0]); i++) {
+        entry = pr_list_prepend_str (list, values[i]);
+        ck_assert_ptr_ne (entry, NULL);
+    }
+
+    /* entries comparing equal must retain their relative order */
+    pr_list_sort (list, pr_list_cmp_first_char);
+    check_list_links (list, 7);
+
+    i = 0;
+    PR_LIST_FOREACH (list, iter) {
+        ck_assert_str_eq ((char *)iter->data, expected[i]);
+        i++;
+    }
+
+    PR_LIST_FOREACH_SAFE (list, iter) {
+        pr_list_remove (iter);
+        free ((char *)iter->data);
+        free (iter);
+    }
+
+    free (list);
+}
+END_TEST
+
+START_TEST(test_pr_list_sort_matches_sorted_insert)
+{
+    PRList  *sorted;
+    PRList  *list;
+    PRList  *entry;
+    PRList  *p;
+    char     str[16];
+    size_t   i;
+    size_t   n;
+
+    /* Compare the result of pr_list_sort_str() against
+     * pr_list_prepend_str_sorted() for lists of every length up to
+     * (and spanning a few merge levels beyond) a power of two.
+     */
+    for (n = 0; n <= 70; n++) {
+        sorted = pr_list_new (NULL);
+        ck_assert_ptr_ne (sorted, NULL);
+
+        list = pr_list_new (NULL);
+        ck_assert_ptr_ne (list, NULL);
+
+        for (i = 0; i < n; i++) {
+            sprintf (str, "%04lu", (unsigned long)((i * 37) % 23));
+
+            entry = pr_list_new (strdup (str));
+            ck_assert_ptr_ne (entry, NULL);
+            pr_list_prepend_str_sorted (sorted, entry);
+
+            entry = pr_list_prepend_str (list, str);
+            ck_assert_ptr_ne (entry, NULL);
+        }
+
+        pr_list_sort_str (list);
+        check_list_links (list, n);
+
+        for (p = sorted->next, entry = list->next;
+                p != sorted;
+                p = p->next, entry = entry->next) {
+            ck_assert_ptr_ne (entry, list);
+            ck_assert_str_eq ((char *)entry->data, (char *)p->data);
+        }
+        ck_assert_ptr_eq (entry, list);
+
+        PR_LIST_FOREACH_SAFE (sorted, iter) {
+            pr_list_remove (iter);
+            free ((char *)iter->data);
+            free (iter);
+        }
+
+        PR_LIST_FOREACH_SAFE (list, iter) {
+            pr_list_remove (iter);
+            free ((char *)iter->data);
+            free (iter);
+        }
+
+        free (sorted);
+        free (list);
+    }
+}
+END_TEST
+
+/********************************************************************/
+
+START_TEST(test_pr_list_pool)
+{
+    PRListPool  *pool;
+    PRList      *list;
+    PRList      *entry;
+    char        *big;
+    char         str[16];
+    size_t       i;
+
+    /**********************************/
+    /* freeing NULL is a no-op */
+    pr_list_pool_free (NULL);
+
+    pool = pr_list_pool_new ();
+    ck_assert_ptr_ne (pool, NULL);
+    ck_assert_ptr_eq (pool->chunks, NULL);
+
+    list = pr_list_pool_new_entry (pool, NULL);
+    ck_assert_ptr_ne (list, NULL);
+    ck_assert_ptr_eq (list->data, NULL);
+    ck_assert_ptr_eq (list->next, list);
+    ck_assert_ptr_eq (list->prev, list);
+
+    /**********************************/
+    /* entries are added before the list head, so in order */
+    entry = pr_list_pool_prepend_str (pool, list, "b");
+    ck_assert_ptr_ne (entry, NULL);
+    ck_assert_str_eq ((char *)entry->data, "b");
+
+    entry = pr_list_pool_prependn_str (pool, list, "cde", 1);
+    ck_assert_ptr_ne (entry, NULL);
+    ck_assert_str_eq ((char *)entry->data, "c");
+
+    entry = pr_list_pool_prepend_str (pool, list, "a");
+    ck_assert_ptr_ne (entry, NULL);
+
+    memset (buffer, '\0', sizeof(buffer));
+    count = 0;
+    pr_list_foreach_visit (list, pr_list_visit_save_data);
+    ck_assert_str_eq (buffer, "bca");
+
+    pr_list_sort_str (list);
+    check_list_links (list, 3);
+
+    memset (buffer, '\0', sizeof(buffer));
+    count = 0;
+    pr_list_foreach_visit (list, pr_list_visit_save_data);
+    ck_assert_str_eq (buffer, "abc");
+
+    /**********************************/
+    /* enough entries to require multiple chunks */
+    for (i = 0; i < (PR_LIST_POOL_CHUNK_SIZE / sizeof (PRList)) * 3; i++) {
+        sprintf (str, "%lu", (unsigned long)i);
+        entry = pr_list_pool_prepend_str (pool, list, str);
+        ck_assert_ptr_ne (entry, NULL);
+        ck_assert_uint_eq ((size_t)entry % sizeof (void *), 0);
+        ck_assert_str_eq ((char *)entry->data, str);
+    }
+
+    ck_assert_ptr_ne (pool->chunks, NULL);
+    ck_assert_ptr_ne (pool->chunks->next, NULL);
+
+    /**********************************/
+    /* a string larger than a chunk */
+    big = malloc (PR_LIST_POOL_CHUNK_SIZE * 2);
+    ck_assert_ptr_ne (big, NULL);
+    memset (big, 'z', (PR_LIST_POOL_CHUNK_SIZE * 2) - 1);
+    big[(PR_LIST_POOL_CHUNK_SIZE * 2) - 1] = '\0';
+
+    entry = pr_list_pool_prepend_str (pool, list, big);
+    ck_assert_ptr_ne (entry, NULL);
+    ck_assert_str_eq ((char *)entry->data, big);
+    ck_assert_ptr_eq (list->prev, entry);
+
+    /* subsequent small allocations still succeed */
+    entry = pr_list_pool_prepend_str (pool, list, "end");
+    ck_assert_ptr_ne (entry, NULL);
+    ck_assert_str_eq ((char *)entry->data, "end");
+
+    free (big);
+
+    pr_list_sort_str (list);
+    check_list_links (list, 3 + ((PR_LIST_POOL_CHUNK_SIZE / sizeof (PRList)) * 3) + 2);
+
+    pr_list_pool_free (pool);
+}
+END_TEST
+
+/********************************************************************/
+
 Suite *
 pr_list_suite (void)
 {
@@ -1378,6 +1665,12 @@ pr_list_suite (void)
     tcase_add_test (tc_core, test_pr_list_prepend_str_sorted);
     tcase_add_test (tc_core, test_pr_list_append_str_sorted);
 
+    tcase_add_test (tc_core, test_pr_list_sort);
+    tcase_add_test (tc_core, test_pr_list_sort_stable);
+    tcase_add_test (tc_core, test_pr_list_sort_matches_sorted_insert);
+
+    tcase_add_test (tc_core, test_pr_list_pool);
+
     /*******************************/
 
     suite_add_tcase(s, tc_core);
@@ -0,0 +1,351 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2015-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ * Description: check(*) tests for the /proc field parsing routines.
+ *
+ * (*) - check unit test program (see http://check.sourceforge.net/).
+ *--------------------------------------------------------------------
+ */
+
+#include "procenv.h"
+
+#include <check.h>
+
+#define FIELDS 64
+
+/********************************************************************/
+
+/* Replaces the library implementation: within the tests, every
+ * die() and bug() call is a failure.
+ */
+void
+procenv_lib_fail (const char *prefix, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "%s: ", prefix);
+
+    va_start (ap, fmt);
+    vfprintf (stderr, fmt, ap);
+    va_end (ap);
+
+    fputc ('\n', stderr);
+
+    abort ();
+}
+
+/********************************************************************/
+
+/* Return true if @field refers to the string @expected */
+static bool
+field_eq (const struct procenv_field *field, const char *expected)
+{
+    return field->ptr
+        && field->len == strlen (expected)
+        && ! memcmp (field->ptr, expected, field->len);
+}
+
+/********************************************************************/
+
+START_TEST(test_split_fields)
+{
+    struct procenv_field  fields[FIELDS];
+    const char           *str;
+
+    /**********************************/
+    /* empty */
+    ck_assert_uint_eq (split_fields ("", ' ', true, fields, FIELDS), 0);
+    ck_assert_uint_eq (split_fields ("   ", ' ', true, fields, FIELDS), 0);
+    ck_assert_uint_eq (split_fields ("\n", ' ', true, fields, FIELDS), 0);
+
+    /**********************************/
+    /* compressed */
+    str = "  foo bar   baz\n";
+    ck_assert_uint_eq (split_fields (str, ' ', true, fields, FIELDS), 3);
+    ck_assert (field_eq (&fields[0], "foo"));
+    ck_assert (field_eq (&fields[1], "bar"));
+    ck_assert (field_eq (&fields[2], "baz"));
+
+    /* views refer to the original string */
+    ck_assert (fields[0].ptr == str + 2);
+
+    /**********************************/
+    /* uncompressed: repeated delimiters denote empty fields */
+    str = ":a::b:";
+    ck_assert_uint_eq (split_fields (str, ':', false, fields, FIELDS), 5);
+    ck_assert (field_eq (&fields[0], ""));
+    ck_assert (field_eq (&fields[1], "a"));
+    ck_assert (field_eq (&fields[2], ""));
+    ck_assert (field_eq (&fields[3], "b"));
+    ck_assert (field_eq (&fields[4], ""));
+
+    /**********************************/
+    /* more fields than space */
+    ck_assert_uint_eq (split_fields ("a b c d", ' ', true, fields, 2), 4);
+    ck_assert (field_eq (&fields[0], "a"));
+    ck_assert (field_eq (&fields[1], "b"));
+
+    ck_assert_uint_eq (split_fields ("a b c d", ' ', true, NULL, 0), 4);
+}
+END_TEST
+
+START_TEST(test_split_proc_stat)
+{
+    struct procenv_field  fields[FIELDS];
+    char                  buffer[PROCENV_BUFFER];
+    unsigned long         value;
+    size_t                count;
+
+    /**********************************/
+    /* command names containing spaces and parentheses */
+    count = split_proc_stat ("1234 (a) (b c) S 1 2\n", fields, FIELDS);
+    ck_assert_uint_eq (count, 5);
+    ck_assert (field_eq (&fields[0], "1234"));
+    ck_assert (field_eq (&fields[1], "a) (b c"));
+    ck_assert (field_eq (&fields[2], "S"));
+    ck_assert (field_eq (&fields[3], "1"));
+    ck_assert (field_eq (&fields[4], "2"));
+
+    count = split_proc_stat ("1 () R", fields, FIELDS);
+    ck_assert_uint_eq (count, 3);
+    ck_assert (field_eq (&fields[1], ""));
+
+    /* only the pid and command name requested */
+    count = split_proc_stat ("1 (init) S 0", fields, 2);
+    ck_assert_uint_eq (count, 4);
+    ck_assert (field_eq (&fields[0], "1"));
+    ck_assert (field_eq (&fields[1], "init"));
+
+    /**********************************/
+    /* invalid */
+    ck_assert_uint_eq (split_proc_stat ("", fields, FIELDS), 0);
+    ck_assert_uint_eq (split_proc_stat ("1 init S", fields, FIELDS), 0);
+    ck_assert_uint_eq (split_proc_stat ("(init) S", fields, FIELDS), 0);
+    ck_assert_uint_eq (split_proc_stat ("1 )init( S", fields, FIELDS), 0);
+
+#if defined (PROCENV_PLATFORM_LINUX)
+    /**********************************/
+    /* real file */
+    ck_assert (read_file ("/proc/self/stat", buffer, sizeof (buffer)) > 0);
+
+    count = split_proc_stat (buffer, fields, FIELDS);
+    ck_assert (count >= PROCENV_STAT_FIELD_PROCESSOR);
+
+    ck_assert (field_to_ulong (&fields[0], &value));
+    ck_assert_uint_eq (value, (unsigned long)getpid ());
+
+    ck_assert (field_to_ulong (&fields[PROCENV_STAT_FIELD_PROCESSOR-1], &value));
+#endif
+}
+END_TEST
+
+START_TEST(test_field_to_ulong)
+{
+    struct procenv_field  field;
+    unsigned long         value;
+    char                  str[64];
+
+    field.ptr = "12345 kB";
+    field.len = strlen (field.ptr);
+    ck_assert (field_to_ulong (&field, &value));
+    ck_assert_uint_eq (value, 12345);
+
+    /* only the view is considered */
+    field.len = 3;
+    ck_assert (field_to_ulong (&field, &value));
+    ck_assert_uint_eq (value, 123);
+
+    field.ptr = "kB";
+    field.len = strlen (field.ptr);
+    ck_assert (! field_to_ulong (&field, &value));
+
+    field.ptr = NULL;
+    field.len = 0;
+    ck_assert (! field_to_ulong (&field, &value));
+
+    sprintf (str, "%lu", ULONG_MAX);
+    field.ptr = str;
+    field.len = strlen (str);
+    ck_assert (field_to_ulong (&field, &value));
+    ck_assert (value == ULONG_MAX);
+
+    /* overflow */
+    strcat (str, "0");
+    field.len = strlen (str);
+    ck_assert (! field_to_ulong (&field, &value));
+}
+END_TEST
+
+START_TEST(test_kv_table)
+{
+    struct procenv_kv_table  table;
+    char                     key[32];
+    size_t                   i;
+
+    /**********************************/
+    /* empty table */
+    kv_table_init (&table);
+    kv_table_build (&table);
+    ck_assert_int_eq (kv_table_lookup (&table, "foo", 3), -1);
+
+    /**********************************/
+    /* maximum number of keys */
+    kv_table_init (&table);
+
+    for (i = 0; i < PROCENV_KV_MAX_KEYS; i++) {
+        sprintf (key, "key%lu.", (unsigned long)i);
+        ck_assert_uint_eq (kv_table_add (&table, strdup (key)), i);
+    }
+
+    kv_table_build (&table);
+
+    for (i = 0; i < PROCENV_KV_MAX_KEYS; i++) {
+        sprintf (key, "key%lu.", (unsigned long)i);
+        ck_assert_int_eq (kv_table_lookup (&table, key, strlen (key)), (int)i);
+
+        /* prefixes do not match */
+        ck_assert_int_eq (kv_table_lookup (&table, key, strlen (key) - 1), -1);
+    }
+
+    ck_assert_int_eq (kv_table_lookup (&table, "key", 3), -1);
+    ck_assert_int_eq (kv_table_lookup (&table, "", 0), -1);
+
+    for (i = 0; i < table.count; i++)
+        free ((char *)table.keys[i]);
+}
+END_TEST
+
+START_TEST(test_kv_parse)
+{
+    struct procenv_kv_table  table;
+    struct procenv_field     values[4];
+    char                     buffer[PROCENV_PROC_FILE_BUFFER];
+    const char              *str;
+    unsigned long            value;
+    size_t                   name;
+    size_t                   vmrss;
+    size_t                   empty;
+    size_t                   missing;
+
+    kv_table_init (&table);
+    name = kv_table_add (&table, "Name");
+    vmrss = kv_table_add (&table, "VmRSS");
+    empty = kv_table_add (&table, "Empty");
+    missing = kv_table_add (&table, "Missing");
+    kv_table_build (&table);
+
+    str = "Name:\tfoo bar \n"
+        "Umask:\t0022\n"
+        "no separator\n"
+        "VmRSS:\t    1234 kB\n"
+        "Name:\tsecond\n"
+        "Empty:\n"
+        "VmRSSx:\t1\n";
+
+    ck_assert_uint_eq (kv_parse (&table, str, ':', values), 3);
+
+    ck_assert (field_eq (&values[name], "foo bar"));
+    ck_assert (field_eq (&values[vmrss], "1234 kB"));
+    ck_assert (field_eq (&values[empty], ""));
+    ck_assert (values[missing].ptr == NULL);
+
+    ck_assert (field_to_ulong (&values[vmrss], &value));
+    ck_assert_uint_eq (value, 1234);
+
+    /* no trailing newline */
+    ck_assert_uint_eq (kv_parse (&table, "VmRSS: 1", ':', values), 1);
+    ck_assert (field_eq (&values[vmrss], "1"));
+    ck_assert (values[name].ptr == NULL);
+
+#if defined (PROCENV_PLATFORM_LINUX)
+    /**********************************/
+    /* real file (the name is truncated by the kernel) */
+    ck_assert (read_file ("/proc/self/status", buffer, sizeof (buffer)) > 0);
+
+    ck_assert (kv_parse (&table, buffer, ':', values) >= 2);
+    ck_assert (values[name].len >= strlen ("check_proc"));
+    ck_assert (! memcmp (values[name].ptr, "check_proc", strlen ("check_proc")));
+#endif
+}
+END_TEST
+
+START_TEST(test_read_file)
+{
+    char  buffer[PROCENV_PROC_FILE_BUFFER];
+    char  small[8];
+    char  exact[7];
+
+#if defined (PROCENV_PLATFORM_LINUX)
+    /**********************************/
+    /* fits */
+    ck_assert (read_file ("/proc/self/status", buffer, sizeof (buffer)) > 0);
+    ck_assert (strstr (buffer, "Name:"));
+
+    /**********************************/
+    /* truncated */
+    errno = 0;
+    ck_assert_int_eq (read_file ("/proc/self/status", small, sizeof (small)), -1);
+    ck_assert_int_eq (errno, EFBIG);
+
+    /**********************************/
+    /* exact fit */
+    ck_assert_int_eq (read_file ("/proc/sys/kernel/ostype", exact, sizeof (exact)), 6);
+    ck_assert_str_eq (exact, "Linux\n");
+#endif
+
+    /**********************************/
+    /* missing */
+    ck_assert_int_eq (read_file ("/this/does/not/exist", buffer, sizeof (buffer)), -1);
+}
+END_TEST
+
+/********************************************************************/
+
+Suite *
+proc_fields_suite (void)
+{
+    Suite  *s;
+    TCase  *tc_core;
+
+    s = suite_create ("procenv proc fields");
+
+    tc_core = tcase_create ("core");
+
+    /*******************************/
+    /* Add each test */
+
+    tcase_add_test (tc_core, test_split_fields);
+    tcase_add_test (tc_core, test_split_proc_stat);
+    tcase_add_test (tc_core, test_field_to_ulong);
+
+    tcase_add_test (tc_core, test_kv_table);
+    tcase_add_test (tc_core, test_kv_parse);
+    tcase_add_test (tc_core, test_read_file);
+
+    /*******************************/
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+/********************************************************************/
+
+int
+main (int argc, char *argv[])
+{
+    Suite    *s;
+    SRunner  *sr;
+    int       number_failed;
+
+    s = proc_fields_suite ();
+    sr = srunner_create (s);
+
+    srunner_run_all (sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    return (! number_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,676 @@
+/*--------------------------------------------------------------------
+ * Copyright (c) 2015-2021 James O. D. Hunt <jamesodhunt@gmail.com>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *--------------------------------------------------------------------
+ * Description: In-process fuzzing harness for the output layer.
+ *
+ * Each input is decoded into a sequence of section, container, object
+ * and entry calls with arbitrary names and values. The sequence is
+ * recorded once and then rendered in every output format. JSON and
+ * XML output is checked for well-formedness. Any failure calls
+ * abort(3) so that it is detected by the fuzzing engine.
+ *
+ * Usage:
+ *
+ * - libFuzzer: build with '-D PROCENV_FUZZ_LIBFUZZER -fsanitize=fuzzer'
+ *   (plus the normal compiler and linker flags) to omit main().
+ *
+ * - AFL: run 'fuzz_output @@' or 'fuzz_output -' (to read the input
+ *   from standard input). Persistent mode is used if available.
+ *
+ * - Otherwise, with no arguments a fixed number of pseudo-random
+ *   inputs are run (as used by 'make check').
+ *--------------------------------------------------------------------
+ */
+
+#include "procenv.h"
+
+/* Maximum number of bytes in a name or value */
+#define FUZZ_MAX_STRING 64
+
+/* Maximum nesting of sections, containers and objects */
+#define FUZZ_MAX_DEPTH 32
+
+/* Maximum number of calls generated from a single input */
+#define FUZZ_MAX_OPS 512
+
+/* Number of pseudo-random inputs to run when no files are specified */
+#define FUZZ_SELF_TEST_RUNS 2000
+
+/* Maximum size of input to generate or read */
+#define FUZZ_MAX_INPUT 4096
+
+enum fuzz_op {
+    FUZZ_OP_SECTION,
+    FUZZ_OP_CONTAINER,
+    FUZZ_OP_OBJECT,
+    FUZZ_OP_CLOSE,
+    FUZZ_OP_ENTRY,
+
+    FUZZ_OP_COUNT
+};
+
+struct fuzz_input {
+    const unsigned char  *data;
+    size_t                size;
+};
+
+static const OutputFormat fuzz_formats[] = {
+    OUTPUT_FORMAT_CRUMB,
+    OUTPUT_FORMAT_JSON,
+    OUTPUT_FORMAT_OPENMETRICS,
+    OUTPUT_FORMAT_TEXT,
+    OUTPUT_FORMAT_XML,
+};
+
+#define FUZZ_FORMAT_COUNT (sizeof (fuzz_formats) / sizeof (fuzz_formats[0]))
+
+/* Defined by the library; required to display XML headers */
+extern const char *program_name;
+
+/********************************************************************/
+
+/* Replaces the library implementation: within the harness, every
+ * die() and bug() call is a failure.
+ */
+void
+procenv_lib_fail (const char *prefix, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "%s: ", prefix);
+
+    va_start (ap, fmt);
+    vfprintf (stderr, fmt, ap);
+    va_end (ap);
+
+    fputc ('\n', stderr);
+
+    abort ();
+}
+
+static void
+fuzz_fail (const char *format, const wchar_t *doc_buf, const wchar_t *pos,
+        const char *msg)
+{
+    fprintf (stderr, "ERROR: invalid %s output at offset %lu: %s\n",
+            format, (unsigned long)(pos - doc_buf), msg);
+    fprintf (stderr, "%ls\n", doc_buf);
+
+    abort ();
+}
+
+/********************************************************************/
+/* JSON well-formedness */
+
+static const wchar_t *json_value (const wchar_t *start, const wchar_t *p, int depth);
+
+static const wchar_t *
+skip_ws (const wchar_t *p)
+{
+    while (*p == L' ' || *p == L'\t' || *p == L'\n' || *p == L'\r')
+        p++;
+
+    return p;
+}
+
+static const wchar_t *
+json_string (const wchar_t *start, const wchar_t *p)
+{
+    int i;
+
+    if (*p != L'"')
+        fuzz_fail ("json", start, p, "expected string");
+
+    for (p++; *p != L'"'; p++) {
+        if (! *p || (unsigned long)*p < 0x20)
+            fuzz_fail ("json", start, p, "invalid character in string");
+
+        if (*p != L'\\')
+            continue;
+
+        p++;
+
+        if (wcschr (L"\"\\/bfnrt", *p) && *p) {
+            continue;
+        } else if (*p == L'u') {
+            for (i = 0; i < 4; i++) {
+                if (! iswxdigit (p[1]))
+                    fuzz_fail ("json", start, p, "invalid unicode escape");
+                p++;
+            }
+        } else {
+            fuzz_fail ("json", start, p, "invalid escape");
+        }
+    }
+
+    return p + 1;
+}
+
+static const wchar_t *
+json_members (const wchar_t *start, const wchar_t *p, wchar_t close,
+        int depth)
+{
+    p = skip_ws (p);
+
+    if (*p == close)
+        return p + 1;
+
+    while (true) {
+        if (close == L'}') {
+            p = json_string (start, skip_ws (p));
+            p = skip_ws (p);
+            if (*p != L':')
+                fuzz_fail ("json", start, p, "expected ':'");
+            p++;
+        }
+
+        p = skip_ws (json_value (start, p, depth + 1));
+
+        if (*p == close)
+            return p + 1;
+
+        if (*p != L',')
+            fuzz_fail ("json", start, p, "expected ',' or end of object");
+        p++;
+    }
+}
+
+static const wchar_t *
+json_value (const wchar_t *start, const wchar_t *p, int depth)
+{
+    if (depth > FUZZ_MAX_DEPTH + 2)
+        fuzz_fail ("json", start, p, "nesting too deep");
+
+    p = skip_ws (p);
+
+    switch (*p) {
+    case L'{':
+        return json_members (start, p + 1, L'}', depth);
+
+    case L'[':
+        return json_members (start, p + 1, L']', depth);
+
+    case L'"':
+        return json_string (start, p);
+
+    default:
+        fuzz_fail ("json", start, p, "expected value");
+        break;
+    }
+
+    return NULL;
+}
+
+static void
+check_json (const pstring *pstr)
+{
+    const wchar_t *p;
+
+    p = skip_ws (json_value (pstr->buf, pstr->buf, 0));
+
+    if (*p)
+        fuzz_fail ("json", pstr->buf, p, "trailing data");
+}
+
+/********************************************************************/
+/* XML well-formedness */
+
+static bool
+xml_valid_char (wchar_t c)
+{
+    unsigned long value = (unsigned long)c;
+
+    return value >= 0x20 || c == L'\t' || c == L'\n' || c == L'\r';
+}
+
+static const wchar_t *
+xml_name (const wchar_t *start, const wchar_t *p)
+{
+    if (! iswalpha (*p) && *p != L'_')
+        fuzz_fail ("xml", start, p, "expected name");
+
+    while (iswalnum (*p) || *p == L'_' || *p == L'-' || *p == L'.')
+        p++;
+
+    return p;
+}
+
+static const wchar_t *
+xml_reference (const wchar_t *start, const wchar_t *p)
+{
+    const wchar_t  *names[] = { L"amp;", L"apos;", L"gt;", L"lt;", L"quot;", NULL };
+    const wchar_t **name;
+    const wchar_t  *digits;
+
+    assert (*p == L'&');
+    p++;
+
+    if (*p == L'#') {
+        p++;
+
+        if (*p == L'x') {
+            for (digits = ++p; iswxdigit (*p); p++)
+                ;
+        } else {
+            for (digits = p; iswdigit (*p); p++)
+                ;
+        }
+
+        if (p == digits || *p != L';')
+            fuzz_fail ("xml", start, p, "invalid character reference");
+
+        return p + 1;
+    }
+
+    for (name = names; *name; name++) {
+        if (! wcsncmp (p, *name, wcslen (*name)))
+            return p + wcslen (*name);
+    }
+
+    fuzz_fail ("xml", start, p, "invalid entity reference");
+
+    return NULL;
+}
+
+static const wchar_t *
+xml_attributes (const wchar_t *start, const wchar_t *p)
+{
+    while (true) {
+        p = skip_ws (p);
+
+        if (*p == L'>' || *p == L'?' || *p == L'/')
+            return p;
+
+        p = skip_ws (xml_name (start, p));
+
+        if (*p++ != L'=')
+            fuzz_fail ("xml", start, p, "expected '='");
+
+        if (*p++ != L'"')
+            fuzz_fail ("xml", start, p, "expected '\"'");
+
+        while (*p != L'"') {
+            if (! *p || *p == L'<' || ! xml_valid_char (*p))
+                fuzz_fail ("xml", start, p, "invalid attribute value");
+
+            if (*p == L'&')
+                p = xml_reference (start, p);
+            else
+                p++;
+        }
+
+        p++;
+    }
+}
+
+static void
+check_xml (const pstring *pstr)
+{
+    const wchar_t  *start = pstr->buf;
+    const wchar_t  *p = start;
+    const wchar_t  *name;
+    const wchar_t  *stack[FUZZ_MAX_DEPTH + 2];
+    size_t          lens[FUZZ_MAX_DEPTH + 2];
+    size_t          len;
+    int             depth = 0;
+    bool            root_seen = false;
+
+    if (wcsncmp (p, L"<?xml ", 6))
+        fuzz_fail ("xml", start, p, "missing declaration");
+
+    p = xml_attributes (start, p + 6);
+
+    if (wcsncmp (p, L"?>", 2))
+        fuzz_fail ("xml", start, p, "unterminated declaration");
+
+    p += 2;
+
+    while (*p) {
+        if (*p == L'<' && p[1] == L'/') {
+            name = p + 2;
+            p = xml_name (start, name);
+            len = p - name;
+
+            if (! depth || lens[depth-1] != len
+                    || wcsncmp (stack[depth-1], name, len))
+                fuzz_fail ("xml", start, name, "mismatched end tag");
+
+            if (*p++ != L'>')
+                fuzz_fail ("xml", start, p, "unterminated end tag");
+
+            depth--;
+        } else if (*p == L'<') {
+            if (! depth && root_seen)
+                fuzz_fail ("xml", start, p, "multiple root elements");
+
+            if (depth == FUZZ_MAX_DEPTH + 2)
+                fuzz_fail ("xml", start, p, "nesting too deep");
+
+            name = p + 1;
+            p = xml_attributes (start, xml_name (start, name));
+
+            if (*p == L'/') {
+                p++;
+            } else {
+                stack[depth] = name;
+                lens[depth] = wcscspn (name, L" \t\n>/");
+                depth++;
+            }
+
+            if (*p++ != L'>')
+                fuzz_fail ("xml", start, p, "unterminated start tag");
+
+            root_seen = true;
+        } else if (*p == L'&') {
+            if (! depth)
+                fuzz_fail ("xml", start, p, "reference outside root element");
+
+            p = xml_reference (start, p);
+        } else {
+            if (! xml_valid_char (*p))
+                fuzz_fail ("xml", start, p, "invalid character");
+
+            if (! depth && ! iswspace (*p))
+                fuzz_fail ("xml", start, p, "text outside root element");
+
+            p++;
+        }
+    }
+
+    if (depth || ! root_seen)
+        fuzz_fail ("xml", start, p, "unterminated document");
+}
+
+/********************************************************************/
+
+static int
+next_byte (struct fuzz_input *input)
+{
+    int byte;
+
+    if (! input->size)
+        return -1;
+
+    byte = *input->data;
+
+    input->data++;
+    input->size--;
+
+    return byte;
+}
+
+/* Returns a string of up to FUZZ_MAX_STRING arbitrary bytes (which
+ * will be truncated at the first nul byte).
+ */
+static void
+next_string (struct fuzz_input *input, char *buf)
+{
+    size_t  len;
+    size_t  i;
+    int     byte;
+
+    byte = next_byte (input);
+
+    len = byte < 0 ? 0 : (size_t)byte % (FUZZ_MAX_STRING + 1);
+
+    for (i = 0; i < len; i++) {
+        byte = next_byte (input);
+        if (byte < 0)
+            break;
+
+        buf[i] = (char)byte;
+    }
+
+    buf[i] = '\0';
+}
+
+static void
+close_element (ElementType type)
+{
+    switch (type) {
+    case ELEMENT_TYPE_SECTION_OPEN:
+        section_close ();
+        break;
+
+    case ELEMENT_TYPE_CONTAINER_OPEN:
+        container_close ();
+        break;
+
+    case ELEMENT_TYPE_OBJECT_OPEN:
+        object_close (false);
+        break;
+
+    default:
+        abort ();
+        break;
+    }
+}
+
+/* Make the calls described by @input, following the same rules as the
+ * collectors: the top level only contains sections and containers only
+ * contain objects.
+ */
+static void
+generate (struct fuzz_input *input)
+{
+    ElementType  stack[FUZZ_MAX_DEPTH];
+    char         name[FUZZ_MAX_STRING + 1];
+    char         value[FUZZ_MAX_STRING + 1];
+    size_t       depth = 0;
+    size_t       ops;
+    int          byte;
+    int          op;
+
+    for (ops = 0; ops < FUZZ_MAX_OPS; ops++) {
+        byte = next_byte (input);
+        if (byte < 0)
+            break;
+
+        op = byte % FUZZ_OP_COUNT;
+
+        if (op == FUZZ_OP_CLOSE) {
+            if (depth)
+                close_element (stack[--depth]);
+            continue;
+        }
+
+        if (! depth) {
+            op = FUZZ_OP_SECTION;
+        } else if (stack[depth-1] == ELEMENT_TYPE_CONTAINER_OPEN) {
+            op = FUZZ_OP_OBJECT;
+        } else if (op == FUZZ_OP_OBJECT) {
+            op = FUZZ_OP_ENTRY;
+        }
+
+        if (op != FUZZ_OP_ENTRY && depth == FUZZ_MAX_DEPTH)
+            continue;
+
+        switch (op) {
+        case FUZZ_OP_SECTION:
+            next_string (input, name);
+            section_open (name);
+            stack[depth++] = ELEMENT_TYPE_SECTION_OPEN;
+            break;
+
+        case FUZZ_OP_CONTAINER:
+            next_string (input, name);
+            container_open (name);
+            stack[depth++] = ELEMENT_TYPE_CONTAINER_OPEN;
+            break;
+
+        case FUZZ_OP_OBJECT:
+            object_open (false);
+            stack[depth++] = ELEMENT_TYPE_OBJECT_OPEN;
+            break;
+
+        case FUZZ_OP_ENTRY:
+            next_string (input, name);
+            next_string (input, value);
+            entry (name, "%s", value);
+            break;
+
+        default:
+            abort ();
+            break;
+        }
+    }
+
+    while (depth)
+        close_element (stack[--depth]);
+}
+
+static void
+fuzz_init (void)
+{
+    static bool initialised = false;
+
+    if (initialised)
+        return;
+
+    /* Exercise multi-byte handling where possible */
+    if (! setlocale (LC_ALL, "C.UTF-8"))
+        (void)setlocale (LC_ALL, "");
+
+    doc = pstring_new ();
+    if (! doc)
+        abort ();
+
+    program_name = "fuzz_output";
+
+    handle_indent_char ();
+
+    initialised = true;
+}
+
+int
+LLVMFuzzerTestOneInput (const unsigned char *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput (const unsigned char *data, size_t size)
+{
+    struct fuzz_input     input = { data, size };
+    struct procenv_node  *tree;
+    pstring              *rendered;
+    size_t                i;
+
+    fuzz_init ();
+
+    record_start ();
+
+    generate (&input);
+
+    tree = record_stop ();
+
+    for (i = 0; i < FUZZ_FORMAT_COUNT; i++) {
+        output_format = fuzz_formats[i];
+
+        render_tree (tree, &rendered);
+
+        if (output_format == OUTPUT_FORMAT_JSON)
+            check_json (rendered);
+        else if (output_format == OUTPUT_FORMAT_XML)
+            check_xml (rendered);
+
+        pstring_free (rendered);
+    }
+
+    free_tree (tree);
+
+    return 0;
+}
+
+/********************************************************************/
+
+#if ! defined (PROCENV_FUZZ_LIBFUZZER)
+
+static size_t
+read_input (FILE *file, unsigned char *buf)
+{
+    size_t size;
+
+    size = fread (buf, 1, FUZZ_MAX_INPUT, file);
+
+    if (ferror (file)) {
+        perror ("fuzz_output: failed to read input");
+        exit (EXIT_FAILURE);
+    }
+
+    return size;
+}
+
+static void
+run_self_test (void)
+{
+    unsigned char  buf[FUZZ_MAX_INPUT];
+    unsigned long  state = 0x9E3779B9UL;
+    size_t         size;
+    size_t         i;
+    int            run;
+
+    for (run = 0; run < FUZZ_SELF_TEST_RUNS; run++) {
+        /* xorshift: deterministic so failures are reproducible */
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        state &= 0xFFFFFFFFUL;
+
+        size = state % FUZZ_MAX_INPUT;
+
+        for (i = 0; i < size; i++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            state &= 0xFFFFFFFFUL;
+
+            buf[i] = (unsigned char)state;
+        }
+
+        (void)LLVMFuzzerTestOneInput (buf, size);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+    unsigned char  buf[FUZZ_MAX_INPUT];
+    FILE          *file;
+    size_t         size;
+    int            i;
+
+    if (argc < 2) {
+        run_self_test ();
+        return EXIT_SUCCESS;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (! strcmp (argv[i], "-")) {
+#if defined (__AFL_LOOP)
+            while (__AFL_LOOP (10000)) {
+                size = read_input (stdin, buf);
+                (void)LLVMFuzzerTestOneInput (buf, size);
+            }
+#else
+            size = read_input (stdin, buf);
+            (void)LLVMFuzzerTestOneInput (buf, size);
+#endif
+            continue;
+        }
+
+        file = fopen (argv[i], "rb");
+        if (! file) {
+            perror (argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        size = read_input (file, buf);
+        fclose (file);
+
+        (void)LLVMFuzzerTestOneInput (buf, size);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif /* ! PROCENV_FUZZ_LIBFUZZER */
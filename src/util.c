@@ -21,6 +21,37 @@ struct baud_speed
 	speed_t  speed;
 };
 
+/**
+ * PROCENV_MAX_TRACKED:
+ *
+ * Maximum number of resources that may be tracked at once.
+ **/
+#define PROCENV_MAX_TRACKED 32
+
+/**
+ * struct procenv_tracked:
+ *
+ * @ptr: resource, or NULL if @fd is set,
+ * @fd: file descriptor,
+ * @release: function to release @ptr.
+ *
+ * Resource held by a collector that must be released should
+ * die() or bug() be called before the collector releases it.
+ **/
+struct procenv_tracked {
+	void   *ptr;
+	int     fd;
+	void  (*release) (void *ptr);
+};
+
+/**
+ * tracked:
+ *
+ * Resources currently held, in the order they were acquired.
+ **/
+static struct procenv_tracked tracked[PROCENV_MAX_TRACKED];
+static size_t tracked_count = 0;
+
 /**
  * fd_valid:
  * @fd: file descriptor.
@@ -282,3 +313,304 @@ get_speed (speed_t speed)
     return NULL;
 }
 
+
+/**
+ * read_file:
+ *
+ * @path: full path to file,
+ * @buffer: buffer to write file contents to,
+ * @size: size of @buffer.
+ *
+ * Read @path into @buffer and nul-terminate it. Unlike stdio, no
+ * memory is allocated.
+ *
+ * Returns: number of bytes read, or -1 on error. If @path does not
+ * fit in @size-1 bytes, -1 is returned with errno set to EFBIG
+ * rather than handing back a silently truncated file.
+ **/
+ssize_t
+read_file (const char *path, char *buffer, size_t size)
+{
+	int      fd;
+	ssize_t  ret;
+	size_t   total = 0;
+	char     extra;
+
+	assert (path);
+	assert (buffer);
+	assert (size);
+
+	fd = open (path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	while (true) {
+		/* Once the buffer is full, read one more byte to
+		 * determine whether the file was truncated.
+		 */
+		if (total < size - 1)
+			ret = read (fd, buffer + total, size - 1 - total);
+		else
+			ret = read (fd, &extra, 1);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0)
+			goto error;
+
+		if (! ret)
+			break;
+
+		if (total == size - 1) {
+			errno = EFBIG;
+			goto error;
+		}
+
+		total += (size_t)ret;
+	}
+
+	close (fd);
+
+	buffer[total] = '\0';
+
+	return (ssize_t)total;
+
+error:
+	ret = errno;
+	close (fd);
+	errno = (int)ret;
+
+	return -1;
+}
+
+static void
+release_file (void *ptr)
+{
+	(void)fclose (ptr);
+}
+
+static void
+release_dir (void *ptr)
+{
+	(void)closedir (ptr);
+}
+
+static void
+track (void *ptr, int fd, void (*release) (void *ptr))
+{
+	if (tracked_count == PROCENV_MAX_TRACKED) {
+		if (ptr)
+			release (ptr);
+		else
+			(void)close (fd);
+
+		bug ("too many tracked resources");
+	}
+
+	tracked[tracked_count].ptr = ptr;
+	tracked[tracked_count].fd = fd;
+	tracked[tracked_count].release = release;
+
+	tracked_count++;
+}
+
+static void
+untrack (const void *ptr, int fd)
+{
+	size_t  i;
+
+	for (i = tracked_count; i > 0; i--) {
+		struct procenv_tracked *t = &tracked[i-1];
+
+		if (ptr ? t->ptr == ptr : (! t->ptr && t->fd == fd)) {
+			memmove (t, t + 1, (tracked_count - i) * sizeof (*t));
+			tracked_count--;
+			return;
+		}
+	}
+}
+
+/**
+ * fopen_tracked:
+ *
+ * @path: path to open,
+ * @mode: fopen(3) mode.
+ *
+ * As fopen(3), but the stream is closed by release_tracked() unless
+ * first closed with fclose_tracked().
+ *
+ * Returns: stream, or NULL on error.
+ **/
+FILE *
+fopen_tracked (const char *path, const char *mode)
+{
+	FILE *f;
+
+	assert (path);
+	assert (mode);
+
+	f = fopen (path, mode);
+	if (f)
+		track (f, -1, release_file);
+
+	return f;
+}
+
+/**
+ * fclose_tracked:
+ *
+ * @f: stream returned by fopen_tracked().
+ *
+ * Returns: as fclose(3).
+ **/
+int
+fclose_tracked (FILE *f)
+{
+	assert (f);
+
+	untrack (f, -1);
+
+	return fclose (f);
+}
+
+/**
+ * opendir_tracked:
+ *
+ * @path: directory to open.
+ *
+ * As opendir(3), but the directory is closed by release_tracked()
+ * unless first closed with closedir_tracked().
+ *
+ * Returns: directory stream, or NULL on error.
+ **/
+DIR *
+opendir_tracked (const char *path)
+{
+	DIR *dir;
+
+	assert (path);
+
+	dir = opendir (path);
+	if (dir)
+		track (dir, -1, release_dir);
+
+	return dir;
+}
+
+/**
+ * closedir_tracked:
+ *
+ * @dir: directory stream returned by opendir_tracked().
+ *
+ * Returns: as closedir(3).
+ **/
+int
+closedir_tracked (DIR *dir)
+{
+	assert (dir);
+
+	untrack (dir, -1);
+
+	return closedir (dir);
+}
+
+/**
+ * track_fd:
+ *
+ * @fd: file descriptor, or -1.
+ *
+ * Arrange for @fd to be closed by release_tracked() unless first
+ * closed with close_tracked().
+ *
+ * Returns: @fd.
+ **/
+int
+track_fd (int fd)
+{
+	if (fd >= 0)
+		track (NULL, fd, NULL);
+
+	return fd;
+}
+
+/**
+ * close_tracked:
+ *
+ * @fd: file descriptor passed to track_fd().
+ *
+ * Returns: as close(2).
+ **/
+int
+close_tracked (int fd)
+{
+	untrack (NULL, fd);
+
+	return close (fd);
+}
+
+/**
+ * track_memory:
+ *
+ * @ptr: allocated memory, or NULL,
+ * @release: function to free @ptr.
+ *
+ * Arrange for @release to be called for @ptr by release_tracked()
+ * unless @ptr is first freed with free_tracked().
+ **/
+void
+track_memory (void *ptr, void (*release) (void *ptr))
+{
+	assert (release);
+
+	if (ptr)
+		track (ptr, -1, release);
+}
+
+/**
+ * free_tracked:
+ *
+ * @ptr: memory passed to track_memory(), or NULL.
+ *
+ * Free @ptr using the function specified when it was tracked.
+ **/
+void
+free_tracked (void *ptr)
+{
+	size_t  i;
+
+	if (! ptr)
+		return;
+
+	for (i = tracked_count; i > 0; i--) {
+		if (tracked[i-1].ptr == ptr) {
+			void (*release) (void *ptr) = tracked[i-1].release;
+
+			untrack (ptr, -1);
+			release (ptr);
+			return;
+		}
+	}
+
+	bug ("untracked memory");
+}
+
+/**
+ * release_tracked:
+ *
+ * Release all tracked resources, most recently acquired first. Called
+ * when a collector has failed, since die() and bug() do not return to
+ * it when procenv is built as a library.
+ **/
+void
+release_tracked (void)
+{
+	while (tracked_count) {
+		struct procenv_tracked *t = &tracked[--tracked_count];
+
+		if (t->ptr)
+			t->release (t->ptr);
+		else
+			(void)close (t->fd);
+	}
+}
@@ -9,7 +9,9 @@
 #define _PROCENV_UTIL_H
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <dirent.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <stdbool.h>
@@ -38,6 +40,17 @@ bool uid_match (uid_t uid);
 const char *container_type (void);
 const char *get_speed (speed_t speed);
 int fd_valid (int fd);
+ssize_t read_file (const char *path, char *buffer, size_t size);
+
+FILE *fopen_tracked (const char *path, const char *mode);
+int fclose_tracked (FILE *f);
+DIR *opendir_tracked (const char *path);
+int closedir_tracked (DIR *dir);
+int track_fd (int fd);
+int close_tracked (int fd);
+void track_memory (void *ptr, void (*release) (void *ptr));
+void free_tracked (void *ptr);
+void release_tracked (void);
 
 #if !defined (PROCENV_PLATFORM_HURD) && \
     !defined (PROCENV_PLATFORM_MINIX) && \